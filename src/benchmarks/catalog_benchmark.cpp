@@ -0,0 +1,70 @@
+// Measures how long selectors of dashboard queries take to resolve to series
+// ids. Series are like in the TSBS devops data set: every host has 10 cpu
+// fields and hosts are spread over regions and datacenters.
+//
+// usage: tskv-catalog-benchmark [hosts_num] [iterations]
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "catalog/series_catalog.h"
+
+namespace {
+
+constexpr size_t kFieldsNum = 10;
+constexpr size_t kRegionsNum = 10;
+constexpr size_t kDatacentersNum = 3;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t hosts_num = argc > 1 ? std::stoull(argv[1]) : 100000;
+  size_t iterations = argc > 2 ? std::stoull(argv[2]) : 1000;
+
+  tskv::SeriesCatalog catalog;
+  auto start = std::chrono::steady_clock::now();
+  tskv::MetricId id = 0;
+  for (size_t host = 0; host < hosts_num; ++host) {
+    auto region = "region_" + std::to_string(host % kRegionsNum);
+    auto datacenter =
+        region + "_" + std::to_string(host / kRegionsNum % kDatacentersNum);
+    for (size_t field = 0; field < kFieldsNum; ++field) {
+      catalog.Add({{std::string(tskv::kMetricNameLabel),
+                    "cpu.usage_" + std::to_string(field)},
+                   {"hostname", "host_" + std::to_string(host)},
+                   {"region", region},
+                   {"datacenter", datacenter}},
+                  id++);
+    }
+  }
+  auto add_seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  std::cout << "series: " << catalog.GetSeriesNum() << ", added in "
+            << add_seconds << "s\n\n";
+
+  std::cout << "selector\tseries\tus per select\n";
+  for (auto selector : {
+           "cpu.usage_0{hostname=host_42}",
+           "cpu.usage_0{hostname=~host_[0-7]}",
+           "cpu.usage_0{hostname=~\"host_1|host_2|host_3\"}",
+           "cpu.usage_0{region=region_1,datacenter=region_1_0}",
+           "cpu.usage_0{hostname=~host_1234.*}",
+           "cpu.usage_0{region!~region_[1-9]}",
+       }) {
+    auto matchers = tskv::ParseSelector(selector);
+    size_t series_num = 0;
+    auto select_start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      series_num = catalog.Select(matchers).size();
+    }
+    auto select_us = std::chrono::duration<double, std::micro>(
+                         std::chrono::steady_clock::now() - select_start)
+                         .count();
+    std::cout << selector << "\t" << series_num << "\t"
+              << select_us / iterations << std::endl;
+  }
+}
@@ -0,0 +1,90 @@
+// Measures memory taken by a series in Storage: right after its metric is
+// initialized and after a write to its memtable. Heap usage is taken from
+// malloc statistics, so it includes allocator overhead.
+//
+// usage: tskv-footprint-benchmark [series_num]
+
+#include <malloc.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "executor/executor.h"
+#include "model/model.h"
+#include "persistent-storage/segment_storage.h"
+#include "storage/storage.h"
+
+namespace {
+
+size_t GetHeapBytes() {
+  return mallinfo2().uordblks;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t series_num = argc > 1 ? std::stoull(argv[1]) : 1'000'000;
+
+  auto path = std::filesystem::temp_directory_path() /
+              ("tskv-footprint-benchmark-" + std::to_string(::getpid()));
+  // flushes schedule merges of levels, so they mustn't share an executor
+  auto compaction_executor =
+      std::make_shared<tskv::Executor>(tskv::Executor::Options{});
+  auto flush_executor =
+      std::make_shared<tskv::Executor>(tskv::Executor::Options{});
+  tskv::MetricStorage::Options options{
+      .metric_options = {{
+          tskv::StoredAggregationType::kSum,
+          tskv::StoredAggregationType::kCount,
+          tskv::StoredAggregationType::kMin,
+          tskv::StoredAggregationType::kMax,
+          tskv::StoredAggregationType::kLast,
+      }},
+      .memtable_options = {.bucket_interval = tskv::Duration::Seconds(10),
+                           .max_age = tskv::Duration::Hours(1)},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = tskv::Duration::Seconds(10),
+                          .level_duration = tskv::Duration::Hours(6)},
+                         {.bucket_interval = tskv::Duration::Minutes(1),
+                          .level_duration = tskv::Duration::Weeks(2)}},
+              .storage = std::make_shared<tskv::SegmentStorage>(
+                  tskv::SegmentStorage::Options{.path = path.string()}),
+              .executor = compaction_executor,
+          },
+      .flush_executor = flush_executor,
+  };
+
+  {
+    tskv::Storage storage;
+    auto start_bytes = GetHeapBytes();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < series_num; ++i) {
+      storage.InitMetric(options);
+    }
+    auto init_seconds = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    auto idle_bytes = GetHeapBytes();
+
+    for (tskv::MetricId id = 0; id < series_num; ++id) {
+      storage.Write(id, {{0, 1}});
+    }
+    auto written_bytes = GetHeapBytes();
+
+    std::cout << "series: " << series_num << ", initialized in "
+              << init_seconds << "s\n";
+    std::cout << "bytes per idle series: "
+              << static_cast<double>(idle_bytes - start_bytes) / series_num
+              << "\n";
+    std::cout << "bytes per series with one record: "
+              << static_cast<double>(written_bytes - start_bytes) / series_num
+              << std::endl;
+  }
+  std::filesystem::remove_all(path);
+}
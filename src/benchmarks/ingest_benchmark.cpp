@@ -0,0 +1,87 @@
+// Measures memtable ingest with small write batches, like many clients with
+// few points each send them. Every write is followed by NeedFlush, as in
+// MetricStorage, and full memtables are replaced with empty ones. With reads,
+// every write is also followed by a read of the last minute, that is kept
+// until the next one, like dashboards polling fresh data do.
+//
+// usage: tskv-ingest-benchmark [records_num]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "memtable/memtable.h"
+#include "metric-storage/metric_storage.h"
+#include "model/model.h"
+
+namespace {
+
+// a second
+constexpr tskv::TimePoint kStep = 1'000'000;
+
+double MeasureNsPerRecord(size_t records_num, size_t batch_size,
+                          bool store_raw, bool reads) {
+  tskv::MetricOptions metric_options{{
+      tskv::StoredAggregationType::kSum,
+      tskv::StoredAggregationType::kCount,
+      tskv::StoredAggregationType::kMin,
+      tskv::StoredAggregationType::kMax,
+      tskv::StoredAggregationType::kLast,
+  }};
+  tskv::Memtable::Options options{
+      .bucket_interval = tskv::Duration::Seconds(10),
+      .max_bytes_size = 1024 * 1024,
+      .max_age = tskv::Duration::Hours(1),
+      .store_raw = store_raw,
+  };
+
+  auto memtable = std::make_unique<tskv::Memtable>(options, metric_options);
+  size_t flushes_num = 0;
+  tskv::InputTimeSeries batch(batch_size);
+  tskv::Memtable::ReadResult last_read;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < records_num; i += batch_size) {
+    for (size_t j = 0; j < batch_size; ++j) {
+      batch[j] = {(i + j) * kStep, static_cast<tskv::Value>(j)};
+    }
+    memtable->Write(batch);
+    if (reads) {
+      auto end = (i + batch_size) * kStep;
+      last_read = memtable->Read({end - std::min(end, 60 * kStep), end},
+                                 tskv::StoredAggregationType::kSum);
+    }
+    if (memtable->NeedFlush()) {
+      memtable = std::make_unique<tskv::Memtable>(options, metric_options);
+      ++flushes_num;
+    }
+  }
+  auto ns = std::chrono::duration<double, std::nano>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+  // so that the loop isn't optimized away
+  if (flushes_num == 0) {
+    std::cerr << "memtable was never full" << std::endl;
+  }
+  return ns / records_num;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t records_num = argc > 1 ? std::stoull(argv[1]) : 20'000'000;
+
+  std::cout << "batch size\tns per record\tns per record with raw\t"
+               "ns per record with reads\n";
+  for (size_t batch_size : {1, 4, 16, 64}) {
+    auto aggregates_ns =
+        MeasureNsPerRecord(records_num, batch_size, false, false);
+    auto raw_ns = MeasureNsPerRecord(records_num, batch_size, true, false);
+    auto reads_ns = MeasureNsPerRecord(records_num, batch_size, false, true);
+    std::cout << batch_size << "\t" << aggregates_ns << "\t" << raw_ns << "\t"
+              << reads_ns << std::endl;
+  }
+}
@@ -0,0 +1,163 @@
+// Compares aggregate kernels with the loops, that were used in ScaleBuckets
+// and Merge before them.
+//
+// usage: tskv-kernels-benchmark [buckets_num] [iterations]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "model/kernels.h"
+
+namespace {
+
+// ScaleBuckets before kernels: window boundary is found by a division per
+// bucket
+template <typename Combine>
+void OldScale(const std::vector<double>& buckets, uint64_t start_time,
+              uint64_t bucket_interval, uint64_t new_interval, double identity,
+              Combine combine, double* out) {
+  double acc = identity;
+  bool updated = false;
+  size_t pos = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    acc = combine(acc, buckets[i]);
+    updated = true;
+    if ((start_time + bucket_interval * i) / new_interval !=
+        (start_time + bucket_interval * (i + 1)) / new_interval) {
+      out[pos++] = acc;
+      acc = identity;
+      updated = false;
+    }
+  }
+  if (updated) {
+    out[pos++] = acc;
+  }
+}
+
+template <typename Combine>
+void OldMerge(double* dst, const double* src, size_t size, Combine combine) {
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = combine(dst[i], src[i]);
+  }
+}
+
+template <typename F>
+double MeasureNs(size_t iterations, F&& f) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; ++i) {
+    f();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+double sink = 0;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t buckets_num = argc > 1 ? std::stoull(argv[1]) : 8640;
+  size_t iterations = argc > 2 ? std::stoull(argv[2]) : 2000;
+
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> dist(0, 100);
+  std::vector<double> buckets(buckets_num);
+  for (auto& bucket : buckets) {
+    bucket = dist(gen);
+  }
+  auto other = buckets;
+  std::vector<double> out(buckets_num + 1);
+
+  // 10s buckets to 5m windows, like queries in main.cpp
+  const uint64_t interval = 10'000'000;
+  const uint64_t new_interval = 300'000'000;
+  const uint64_t start_time = 1'000'000'000 * interval + 7 * interval;
+  const size_t stride = new_interval / interval;
+  const size_t head = stride - (start_time % new_interval) / interval;
+
+  auto sum = [](double lhs, double rhs) { return lhs + rhs; };
+  auto min = [](double lhs, double rhs) { return std::min(lhs, rhs); };
+  auto max = [](double lhs, double rhs) { return std::max(lhs, rhs); };
+  auto last = [](double, double rhs) { return rhs; };
+
+  struct Case {
+    std::string name;
+    tskv::ReduceKind kind;
+    double identity;
+  };
+  std::vector<Case> cases{
+      {"sum", tskv::ReduceKind::kSum, 0},
+      {"min", tskv::ReduceKind::kMin, std::numeric_limits<double>::max()},
+      {"max", tskv::ReduceKind::kMax, std::numeric_limits<double>::lowest()},
+      {"last", tskv::ReduceKind::kLast, 0},
+  };
+
+  std::cout << "buckets: " << buckets_num << ", iterations: " << iterations
+            << "\n\n";
+  std::cout << "op\tscale old\tscale scalar\tscale simd\tmerge old\t"
+               "merge scalar\tmerge simd (ns/call)\n";
+  for (const auto& c : cases) {
+    auto old_scale = [&](auto combine) {
+      return MeasureNs(iterations, [&] {
+        OldScale(buckets, start_time, interval, new_interval, c.identity,
+                 combine, out.data());
+        sink += out[0];
+      });
+    };
+    auto old_merge = [&](auto combine) {
+      return MeasureNs(iterations, [&] {
+        OldMerge(out.data(), other.data(), other.size(), combine);
+        sink += out[0];
+      });
+    };
+    double scale_old = 0;
+    double merge_old = 0;
+    switch (c.kind) {
+      case tskv::ReduceKind::kSum:
+        scale_old = old_scale(sum);
+        merge_old = old_merge(sum);
+        break;
+      case tskv::ReduceKind::kMin:
+        scale_old = old_scale(min);
+        merge_old = old_merge(min);
+        break;
+      case tskv::ReduceKind::kMax:
+        scale_old = old_scale(max);
+        merge_old = old_merge(max);
+        break;
+      case tskv::ReduceKind::kLast:
+        scale_old = old_scale(last);
+        merge_old = old_merge(last);
+        break;
+    }
+    auto scale_scalar = MeasureNs(iterations, [&] {
+      tskv::ReduceStridedScalar(c.kind, buckets, head, stride, out.data());
+      sink += out[0];
+    });
+    auto scale_simd = MeasureNs(iterations, [&] {
+      tskv::ReduceStrided(c.kind, buckets, head, stride, out.data());
+      sink += out[0];
+    });
+    auto merge_scalar = MeasureNs(iterations, [&] {
+      tskv::CombineIntoScalar(c.kind, out.data(), other);
+      sink += out[0];
+    });
+    auto merge_simd = MeasureNs(iterations, [&] {
+      tskv::CombineInto(c.kind, out.data(), other);
+      sink += out[0];
+    });
+    std::cout << c.name << "\t" << scale_old << "\t" << scale_scalar << "\t"
+              << scale_simd << "\t" << merge_old << "\t" << merge_scalar
+              << "\t" << merge_simd << "\n";
+  }
+  // keeps the compiler from throwing the loops away
+  return sink == 42 ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+// Measures how ingest and query throughput of Storage scale with the number
+// of threads. Every thread writes (and then reads) its own part of metrics,
+// like independent clients would do.
+//
+// usage: tskv-storage-benchmark [metrics_num] [hours] [max_threads]
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "executor/executor.h"
+#include "model/model.h"
+#include "persistent-storage/segment_storage.h"
+#include "storage/storage.h"
+
+namespace {
+
+constexpr tskv::TimePoint kStep = 1'000'000;
+constexpr size_t kBatchSize = 1000;
+constexpr size_t kQueriesPerThread = 20000;
+
+struct Result {
+  double records_per_second;
+  double queries_per_second;
+};
+
+tskv::MetricStorage::Options MakeMetricOptions(
+    std::shared_ptr<tskv::IPersistentStorage> pages,
+    std::shared_ptr<tskv::Executor> compaction_executor,
+    std::shared_ptr<tskv::Executor> flush_executor) {
+  return {
+      .metric_options = {{
+          tskv::StoredAggregationType::kSum,
+          tskv::StoredAggregationType::kCount,
+          tskv::StoredAggregationType::kMin,
+          tskv::StoredAggregationType::kMax,
+      }},
+      .memtable_options = {.bucket_interval = tskv::Duration::Seconds(10),
+                           .max_age = tskv::Duration::Hours(1)},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = tskv::Duration::Seconds(10),
+                          .level_duration = tskv::Duration::Hours(6)},
+                         {.bucket_interval = tskv::Duration::Minutes(1),
+                          .level_duration = tskv::Duration::Weeks(2)}},
+              .storage = std::move(pages),
+              .executor = std::move(compaction_executor),
+          },
+      .flush_executor = std::move(flush_executor),
+  };
+}
+
+// runs f(thread_idx) in threads_num threads, returns seconds
+template <typename F>
+double RunThreads(size_t threads_num, F&& f) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < threads_num; ++i) {
+    threads.emplace_back([&, i] { f(i); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+Result Run(size_t threads_num, size_t metrics_num, size_t hours,
+           const std::filesystem::path& path) {
+  std::filesystem::remove_all(path);
+  auto pages = std::make_shared<tskv::SegmentStorage>(
+      tskv::SegmentStorage::Options{.path = path.string(),
+                                    .mmap_reads = true});
+  auto compaction_executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = threads_num});
+  auto flush_executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = threads_num});
+  tskv::Storage storage(
+      tskv::Storage::Options{.page_cache = tskv::PageCache::Options{}});
+  auto metric_options =
+      MakeMetricOptions(pages, compaction_executor, flush_executor);
+
+  std::vector<std::vector<tskv::MetricId>> thread_metrics(threads_num);
+  const size_t records_num = hours * 3600;
+  auto write_seconds = RunThreads(threads_num, [&](size_t thread_idx) {
+    auto& metric_ids = thread_metrics[thread_idx];
+    for (size_t i = thread_idx; i < metrics_num; i += threads_num) {
+      metric_ids.push_back(storage.InitMetric(metric_options));
+    }
+    std::mt19937 gen(thread_idx);
+    std::uniform_real_distribution<double> dist(0, 100);
+    tskv::InputTimeSeries batch;
+    for (size_t begin = 0; begin < records_num; begin += kBatchSize) {
+      auto end = std::min(records_num, begin + kBatchSize);
+      for (auto metric_id : metric_ids) {
+        batch.clear();
+        for (size_t i = begin; i < end; ++i) {
+          batch.push_back({i * kStep, dist(gen)});
+        }
+        storage.Write(metric_id, batch);
+      }
+    }
+  });
+  storage.Flush();
+
+  auto read_seconds = RunThreads(threads_num, [&](size_t thread_idx) {
+    const auto& metric_ids = thread_metrics[thread_idx];
+    if (metric_ids.empty()) {
+      return;
+    }
+    std::mt19937 gen(thread_idx);
+    const tskv::TimePoint range = tskv::Duration::Hours(1);
+    const tskv::TimePoint max_start = records_num * kStep - range;
+    std::uniform_int_distribution<tskv::TimePoint> start_dist(0, max_start);
+    std::uniform_int_distribution<size_t> metric_dist(0,
+                                                      metric_ids.size() - 1);
+    size_t found = 0;
+    for (size_t i = 0; i < kQueriesPerThread; ++i) {
+      auto start = start_dist(gen);
+      auto column = storage.Read(metric_ids[metric_dist(gen)],
+                                 {start, start + range},
+                                 tskv::AggregationType::kMax);
+      found += column != nullptr;
+    }
+    if (found == 0) {
+      std::cerr << "no data found" << std::endl;
+    }
+  });
+
+  return {metrics_num * records_num / write_seconds,
+          threads_num * kQueriesPerThread / read_seconds};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t metrics_num = argc > 1 ? std::stoull(argv[1]) : 64;
+  size_t hours = argc > 2 ? std::stoull(argv[2]) : 12;
+  size_t max_threads =
+      argc > 3 ? std::stoull(argv[3])
+               : std::max<size_t>(1, std::thread::hardware_concurrency());
+  auto path = std::filesystem::temp_directory_path() /
+              ("tskv-storage-benchmark-" + std::to_string(::getpid()));
+
+  std::cout << "metrics: " << metrics_num << ", hours: " << hours
+            << ", 1s records\n\n";
+  std::cout << "threads\tingest (records/s)\tquery 1h max (queries/s)\n";
+  // powers of two and the core count
+  std::vector<size_t> threads_nums;
+  for (size_t threads_num = 1; threads_num < max_threads; threads_num *= 2) {
+    threads_nums.push_back(threads_num);
+  }
+  threads_nums.push_back(max_threads);
+  for (auto threads_num : threads_nums) {
+    auto result = Run(threads_num, metrics_num, hours, path);
+    std::filesystem::remove_all(path);
+    std::cout << threads_num << "\t"
+              << static_cast<uint64_t>(result.records_per_second) << "\t"
+              << static_cast<uint64_t>(result.queries_per_second) << std::endl;
+  }
+}
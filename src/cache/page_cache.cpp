@@ -0,0 +1,102 @@
+#include "page_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace tskv {
+
+PageCache::PageCache(const Options& options)
+    : shard_max_bytes_size_(options.max_bytes_size /
+                            std::max<size_t>(options.shards_num, 1)),
+      shards_(std::max<size_t>(options.shards_num, 1)) {}
+
+Column PageCache::Get(const IPersistentStorage* storage,
+                      const PageId& page_id) {
+  Key key{storage, page_id};
+  auto& shard = GetShard(key);
+  std::lock_guard lock(shard.mutex);
+  auto it = shard.index.find(key);
+  if (it == shard.index.end()) {
+    ++shard.misses;
+    return nullptr;
+  }
+  ++shard.hits;
+  shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+  return it->second->column;
+}
+
+void PageCache::Put(const IPersistentStorage* storage, const PageId& page_id,
+                    Column column, size_t bytes_size) {
+  if (bytes_size > shard_max_bytes_size_) {
+    return;
+  }
+  Key key{storage, page_id};
+  auto& shard = GetShard(key);
+  std::lock_guard lock(shard.mutex);
+  if (auto it = shard.index.find(key); it != shard.index.end()) {
+    // concurrent readers of the same page put the same column
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return;
+  }
+  shard.entries.push_front({key, std::move(column), bytes_size});
+  shard.index.emplace(std::move(key), shard.entries.begin());
+  shard.bytes_size += bytes_size;
+  Evict(shard);
+}
+
+void PageCache::Erase(const IPersistentStorage* storage,
+                      std::span<const PageId> page_ids) {
+  for (const auto& page_id : page_ids) {
+    Key key{storage, page_id};
+    auto& shard = GetShard(key);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+      continue;
+    }
+    shard.bytes_size -= it->second->bytes_size;
+    shard.entries.erase(it->second);
+    shard.index.erase(it);
+  }
+}
+
+PageCache::Stats PageCache::GetStats() const {
+  Stats stats;
+  for (const auto& shard : shards_) {
+    std::lock_guard lock(shard.mutex);
+    stats.hits += shard.hits;
+    stats.misses += shard.misses;
+  }
+  return stats;
+}
+
+size_t PageCache::GetBytesSize() const {
+  size_t bytes_size = 0;
+  for (const auto& shard : shards_) {
+    std::lock_guard lock(shard.mutex);
+    bytes_size += shard.bytes_size;
+  }
+  return bytes_size;
+}
+
+size_t PageCache::KeyHash::operator()(const Key& key) const {
+  auto hash = std::hash<PageId>{}(key.page_id);
+  return hash ^ (std::hash<const void*>{}(key.storage) + 0x9e3779b9 +
+                 (hash << 6) + (hash >> 2));
+}
+
+PageCache::Shard& PageCache::GetShard(const Key& key) {
+  return shards_[KeyHash{}(key) % shards_.size()];
+}
+
+void PageCache::Evict(Shard& shard) {
+  while (shard.bytes_size > shard_max_bytes_size_) {
+    auto& entry = shard.entries.back();
+    shard.bytes_size -= entry.bytes_size;
+    shard.index.erase(entry.key);
+    shard.entries.pop_back();
+  }
+}
+
+}  // namespace tskv
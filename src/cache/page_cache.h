@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "../model/column.h"
+#include "../persistent-storage/persistent_storage.h"
+
+namespace tskv {
+
+// Cache of decoded pages with a byte budget, so that pages read by recent
+// queries aren't read and decoded again. It's split into shards with their
+// own LRU lists and locks, so concurrent readers rarely wait for each other.
+//
+// Pages are keyed by their storage and id, so one cache can be shared by
+// metrics with different storages. Cached columns are shared with readers and
+// must not be changed, columns copy their data on write anyway.
+class PageCache {
+ public:
+  struct Options {
+    size_t max_bytes_size{256 * 1024 * 1024};
+    size_t shards_num{16};
+  };
+
+  struct Stats {
+    uint64_t hits{0};
+    uint64_t misses{0};
+  };
+
+ public:
+  explicit PageCache(const Options& options);
+  PageCache(const PageCache&) = delete;
+  PageCache& operator=(const PageCache&) = delete;
+
+  // returns nullptr if the page isn't cached
+  Column Get(const IPersistentStorage* storage, const PageId& page_id);
+  // bytes_size is charged against the budget, pages bigger than a shard
+  // budget aren't cached
+  void Put(const IPersistentStorage* storage, const PageId& page_id,
+           Column column, size_t bytes_size);
+  // must be called when the page is deleted, as its id can be reused
+  void Erase(const IPersistentStorage* storage,
+             std::span<const PageId> page_ids);
+
+  Stats GetStats() const;
+  size_t GetBytesSize() const;
+
+ private:
+  struct Key {
+    const IPersistentStorage* storage;
+    PageId page_id;
+
+    bool operator==(const Key& other) const = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const;
+  };
+
+  struct Entry {
+    Key key;
+    Column column;
+    size_t bytes_size;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    // from the most recently used
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    size_t bytes_size{0};
+    uint64_t hits{0};
+    uint64_t misses{0};
+  };
+
+ private:
+  Shard& GetShard(const Key& key);
+  // evicts least recently used pages until the shard fits its budget
+  void Evict(Shard& shard);
+
+ private:
+  size_t shard_max_bytes_size_;
+  std::vector<Shard> shards_;
+};
+
+}  // namespace tskv
@@ -0,0 +1,391 @@
+#include "series_catalog.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <regex>
+#include <stdexcept>
+#include <utility>
+
+namespace tskv {
+
+namespace {
+
+// if a list is that much shorter, its ids are searched in the other one
+// instead of merging them
+constexpr size_t kSearchRatio = 16;
+constexpr size_t kMaxExpandedValues = 256;
+constexpr std::string_view kSpaces = " \t\r\n";
+
+std::string_view Trim(std::string_view str) {
+  auto begin = str.find_first_not_of(kSpaces);
+  if (begin == std::string_view::npos) {
+    return {};
+  }
+  return str.substr(begin, str.find_last_not_of(kSpaces) - begin + 1);
+}
+
+void SortLabels(Labels& labels) {
+  std::ranges::sort(labels);
+  auto it = std::ranges::adjacent_find(
+      labels, [](const Label& lhs, const Label& rhs) {
+        return lhs.name == rhs.name;
+      });
+  if (it != labels.end()) {
+    throw std::runtime_error("Label " + it->name + " is set twice");
+  }
+}
+
+bool IsNegative(const LabelMatcher& matcher) {
+  return matcher.type == LabelMatcher::Type::kNotEqual ||
+         matcher.type == LabelMatcher::Type::kNotRegex;
+}
+
+// all values matching the regex start with it. Alternations can have
+// different prefixes, and the last char is optional before some quantifiers
+std::string GetLiteralPrefix(std::string_view regex) {
+  if (regex.find('|') != std::string_view::npos) {
+    return {};
+  }
+  std::string prefix;
+  for (char c : regex) {
+    if (std::string_view(".[]()*+?{}^$\\").find(c) != std::string_view::npos) {
+      if (!prefix.empty() && (c == '*' || c == '?' || c == '{')) {
+        prefix.pop_back();
+      }
+      break;
+    }
+    prefix += c;
+  }
+  return prefix;
+}
+
+// regexes of literals, char classes and alternations, like host_[0-7] or
+// a|b, match few values, so they are looked up instead of scanning values
+std::optional<std::vector<std::string>> ExpandRegex(std::string_view regex) {
+  if (regex.find_first_of("()") != std::string_view::npos) {
+    return std::nullopt;
+  }
+  std::vector<std::string> values;
+  size_t begin = 0;
+  while (begin <= regex.size()) {
+    auto end = std::min(regex.find('|', begin), regex.size());
+    std::vector<std::string> alternatives{""};
+    for (size_t i = begin; i < end; ++i) {
+      std::string chars;
+      if (regex[i] == '[') {
+        auto close = regex.find(']', i + 1);
+        if (close == std::string_view::npos || close >= end ||
+            regex[i + 1] == '^' || close == i + 1) {
+          return std::nullopt;
+        }
+        for (size_t j = i + 1; j < close; ++j) {
+          if (regex[j] == '\\' || regex[j] == '[') {
+            return std::nullopt;
+          }
+          if (j + 2 < close && regex[j + 1] == '-') {
+            if (regex[j] > regex[j + 2]) {
+              return std::nullopt;
+            }
+            for (int c = regex[j]; c <= regex[j + 2]; ++c) {
+              chars += static_cast<char>(c);
+            }
+            j += 2;
+          } else {
+            chars += regex[j];
+          }
+        }
+        i = close;
+      } else if (regex[i] == '\\' && i + 1 < end &&
+                 std::ispunct(static_cast<unsigned char>(regex[i + 1]))) {
+        chars += regex[++i];
+      } else if (std::string_view(".*+?{}^$\\]").find(regex[i]) ==
+                 std::string_view::npos) {
+        chars += regex[i];
+      } else {
+        return std::nullopt;
+      }
+      if (alternatives.size() * chars.size() > kMaxExpandedValues) {
+        return std::nullopt;
+      }
+      std::vector<std::string> next;
+      for (const auto& alternative : alternatives) {
+        for (char c : chars) {
+          next.push_back(alternative + c);
+        }
+      }
+      alternatives = std::move(next);
+    }
+    values.insert(values.end(), alternatives.begin(), alternatives.end());
+    if (values.size() > kMaxExpandedValues) {
+      return std::nullopt;
+    }
+    begin = end + 1;
+  }
+  // classes like [aa] or alternations like a|a give the same value twice
+  std::ranges::sort(values);
+  auto [first, last] = std::ranges::unique(values);
+  values.erase(first, last);
+  return values;
+}
+
+void Insert(std::vector<MetricId>& list, MetricId id) {
+  // ids are mostly added in ascending order, so it's an append
+  list.insert(std::ranges::upper_bound(list, id), id);
+}
+
+// lists of values of one label don't intersect, as a series has one value
+std::vector<MetricId> Union(std::span<const std::span<const MetricId>> lists) {
+  std::vector<MetricId> result;
+  for (auto list : lists) {
+    result.insert(result.end(), list.begin(), list.end());
+  }
+  std::ranges::sort(result);
+  return result;
+}
+
+// lhs isn't longer than rhs
+std::vector<MetricId> Intersect(std::span<const MetricId> lhs,
+                                std::span<const MetricId> rhs) {
+  std::vector<MetricId> result;
+  if (lhs.size() * kSearchRatio < rhs.size()) {
+    auto it = rhs.begin();
+    for (auto id : lhs) {
+      it = std::lower_bound(it, rhs.end(), id);
+      if (it == rhs.end()) {
+        break;
+      }
+      if (*it == id) {
+        result.push_back(id);
+      }
+    }
+    return result;
+  }
+  std::ranges::set_intersection(lhs, rhs, std::back_inserter(result));
+  return result;
+}
+
+std::vector<MetricId> Subtract(std::span<const MetricId> lhs,
+                               std::span<const MetricId> rhs) {
+  std::vector<MetricId> result;
+  if (lhs.size() * kSearchRatio < rhs.size()) {
+    auto it = rhs.begin();
+    for (auto id : lhs) {
+      it = std::lower_bound(it, rhs.end(), id);
+      if (it == rhs.end() || *it != id) {
+        result.push_back(id);
+      }
+    }
+    return result;
+  }
+  std::ranges::set_difference(lhs, rhs, std::back_inserter(result));
+  return result;
+}
+
+}  // namespace
+
+std::vector<LabelMatcher> ParseSelector(std::string_view selector) {
+  auto error = [&] {
+    return std::runtime_error("Invalid selector " + std::string(selector));
+  };
+  std::vector<LabelMatcher> matchers;
+  auto trimmed = Trim(selector);
+  auto brace = trimmed.find('{');
+  auto name = Trim(trimmed.substr(0, brace));
+  if (!name.empty()) {
+    matchers.push_back({std::string(kMetricNameLabel),
+                        LabelMatcher::Type::kEqual, std::string(name)});
+  }
+  if (brace == std::string_view::npos) {
+    if (matchers.empty()) {
+      throw error();
+    }
+    return matchers;
+  }
+  if (trimmed.back() != '}') {
+    throw error();
+  }
+
+  auto body = trimmed.substr(brace + 1, trimmed.size() - brace - 2);
+  size_t pos = 0;
+  while (pos < body.size()) {
+    auto op_pos = body.find_first_of("=!", pos);
+    if (op_pos == std::string_view::npos) {
+      throw error();
+    }
+    LabelMatcher matcher;
+    matcher.name = Trim(body.substr(pos, op_pos - pos));
+    auto op = body.substr(op_pos, 2);
+    if (op == "=~") {
+      matcher.type = LabelMatcher::Type::kRegex;
+    } else if (op == "!~") {
+      matcher.type = LabelMatcher::Type::kNotRegex;
+    } else if (op == "!=") {
+      matcher.type = LabelMatcher::Type::kNotEqual;
+    } else if (op.starts_with('=')) {
+      matcher.type = LabelMatcher::Type::kEqual;
+    } else {
+      throw error();
+    }
+    if (matcher.name.empty()) {
+      throw error();
+    }
+    pos = op_pos + (matcher.type == LabelMatcher::Type::kEqual ? 1 : 2);
+
+    auto end = body.find(',', pos);
+    if (end == std::string_view::npos) {
+      end = body.size();
+    }
+    auto quote = body.find_first_not_of(kSpaces, pos);
+    if (quote != std::string_view::npos && body[quote] == '"') {
+      auto closing = body.find('"', quote + 1);
+      if (closing == std::string_view::npos) {
+        throw error();
+      }
+      matcher.value = body.substr(quote + 1, closing - quote - 1);
+      end = body.find_first_not_of(kSpaces, closing + 1);
+      if (end != std::string_view::npos && body[end] != ',') {
+        throw error();
+      }
+      end = std::min(end, body.size());
+    } else {
+      matcher.value = Trim(body.substr(pos, end - pos));
+    }
+    matchers.push_back(std::move(matcher));
+    pos = end + 1;
+  }
+  if (matchers.empty()) {
+    throw error();
+  }
+  return matchers;
+}
+
+bool SeriesCatalog::Add(Labels labels, MetricId id) {
+  SortLabels(labels);
+  std::unique_lock lock(mutex_);
+  auto [it, inserted] = series_.try_emplace(std::move(labels), id);
+  if (!inserted) {
+    return false;
+  }
+  labels_.emplace(id, &it->first);
+  for (const auto& label : it->first) {
+    Insert(index_[label.name][label.value], id);
+  }
+  Insert(all_ids_, id);
+  return true;
+}
+
+std::optional<MetricId> SeriesCatalog::Find(Labels labels) const {
+  SortLabels(labels);
+  std::shared_lock lock(mutex_);
+  auto it = series_.find(labels);
+  if (it == series_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+Labels SeriesCatalog::GetLabels(MetricId id) const {
+  std::shared_lock lock(mutex_);
+  auto it = labels_.find(id);
+  if (it == labels_.end()) {
+    return {};
+  }
+  return *it->second;
+}
+
+std::vector<MetricId> SeriesCatalog::Select(
+    std::span<const LabelMatcher> matchers) const {
+  std::shared_lock lock(mutex_);
+  // owns merged lists of positive regex matchers, the others are views of
+  // the index
+  std::vector<std::vector<MetricId>> unions;
+  unions.reserve(matchers.size());
+  std::vector<std::span<const MetricId>> included;
+  // aren't merged, as they are subtracted one by one anyway
+  std::vector<std::span<const MetricId>> excluded;
+  for (const auto& matcher : matchers) {
+    auto lists = Match(matcher);
+    if (IsNegative(matcher)) {
+      excluded.insert(excluded.end(), lists.begin(), lists.end());
+    } else if (lists.empty()) {
+      return {};
+    } else if (lists.size() == 1) {
+      included.push_back(lists.front());
+    } else {
+      included.push_back(unions.emplace_back(Union(lists)));
+    }
+  }
+
+  // the shortest list bounds the result, so it's intersected first
+  std::ranges::sort(included, {}, [](auto ids) { return ids.size(); });
+  std::span<const MetricId> first = all_ids_;
+  if (!included.empty()) {
+    first = included.front();
+  }
+  std::vector<MetricId> result(first.begin(), first.end());
+  for (size_t i = 1; i < included.size() && !result.empty(); ++i) {
+    result = Intersect(result, included[i]);
+  }
+  for (size_t i = 0; i < excluded.size() && !result.empty(); ++i) {
+    result = Subtract(result, excluded[i]);
+  }
+  return result;
+}
+
+size_t SeriesCatalog::GetSeriesNum() const {
+  std::shared_lock lock(mutex_);
+  return series_.size();
+}
+
+size_t SeriesCatalog::LabelsHash::operator()(const Labels& labels) const {
+  size_t hash = 0;
+  auto combine = [&](const std::string& str) {
+    hash ^= std::hash<std::string>{}(str) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+  };
+  for (const auto& label : labels) {
+    combine(label.name);
+    combine(label.value);
+  }
+  return hash;
+}
+
+std::vector<std::span<const MetricId>> SeriesCatalog::Match(
+    const LabelMatcher& matcher) const {
+  std::vector<std::span<const MetricId>> lists;
+  auto label_it = index_.find(matcher.name);
+  if (label_it == index_.end()) {
+    return lists;
+  }
+  const auto& values = label_it->second;
+  if (matcher.type == LabelMatcher::Type::kEqual ||
+      matcher.type == LabelMatcher::Type::kNotEqual) {
+    if (auto it = values.find(matcher.value); it != values.end()) {
+      lists.emplace_back(it->second);
+    }
+    return lists;
+  }
+
+  if (auto expanded = ExpandRegex(matcher.value)) {
+    for (const auto& value : *expanded) {
+      if (auto it = values.find(value); it != values.end()) {
+        lists.emplace_back(it->second);
+      }
+    }
+    return lists;
+  }
+  std::regex regex(matcher.value);
+  auto prefix = GetLiteralPrefix(matcher.value);
+  for (auto it = values.lower_bound(prefix);
+       it != values.end() && it->first.starts_with(prefix); ++it) {
+    if (std::regex_match(it->first, regex)) {
+      lists.emplace_back(it->second);
+    }
+  }
+  return lists;
+}
+
+}  // namespace tskv
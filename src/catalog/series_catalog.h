@@ -0,0 +1,91 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../model/model.h"
+
+namespace tskv {
+
+struct Label {
+  std::string name;
+  std::string value;
+
+  auto operator<=>(const Label& other) const = default;
+};
+
+// label set of a series, the metric name is the value of kMetricNameLabel
+using Labels = std::vector<Label>;
+
+inline constexpr std::string_view kMetricNameLabel = "__name__";
+
+struct LabelMatcher {
+  enum class Type {
+    kEqual,
+    kNotEqual,
+    // regexes must match the whole value, like in Prometheus
+    kRegex,
+    kNotRegex,
+  };
+
+  std::string name;
+  Type type;
+  std::string value;
+};
+
+// parses selectors like cpu.usage_user{hostname=~host_[0-7],region!="eu"},
+// values with commas or braces must be quoted, quotes can't be escaped
+std::vector<LabelMatcher> ParseSelector(std::string_view selector);
+
+// Maps label sets of series to their metric ids. Every label value has a
+// sorted posting list with ids of its series, so selectors are resolved by
+// intersecting a few posting lists instead of checking all series.
+//
+// Thread safe: series can be added and selected concurrently.
+class SeriesCatalog {
+ public:
+  // returns false if the series already has an id, throws if labels have
+  // duplicate names
+  bool Add(Labels labels, MetricId id);
+  std::optional<MetricId> Find(Labels labels) const;
+  // empty if there is no such series
+  Labels GetLabels(MetricId id) const;
+  // ids of series matching all matchers in ascending order. Series without
+  // the label of a matcher match only negative ones
+  std::vector<MetricId> Select(std::span<const LabelMatcher> matchers) const;
+  size_t GetSeriesNum() const;
+
+ private:
+  using PostingList = std::vector<MetricId>;
+  // sorted, so that regexes with a literal prefix check only values with it
+  using LabelValues = std::map<std::string, PostingList, std::less<>>;
+
+  struct LabelsHash {
+    size_t operator()(const Labels& labels) const;
+  };
+
+ private:
+  // posting lists of values of the label, that match the matcher
+  std::vector<std::span<const MetricId>> Match(
+      const LabelMatcher& matcher) const;
+
+ private:
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<Labels, MetricId, LabelsHash> series_;
+  // keys of series_, they aren't moved by rehashing
+  std::unordered_map<MetricId, const Labels*> labels_;
+  std::unordered_map<std::string, LabelValues> index_;
+  // for selectors without positive matchers
+  PostingList all_ids_;
+};
+
+}  // namespace tskv
@@ -0,0 +1,73 @@
+#include "background_task.h"
+
+#include <utility>
+
+namespace tskv {
+
+BackgroundTask::BackgroundTask(std::shared_ptr<Executor> executor,
+                               std::function<void()> task)
+    : executor_(std::move(executor)), task_(std::move(task)) {}
+
+BackgroundTask::~BackgroundTask() {
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return !scheduled_; });
+}
+
+void BackgroundTask::Schedule() {
+  if (!executor_) {
+    task_();
+    return;
+  }
+  {
+    std::lock_guard lock(mutex_);
+    if (scheduled_) {
+      rerun_ = true;
+      return;
+    }
+    scheduled_ = true;
+  }
+  // at most one run of a task is queued, so the queue stays bounded by the
+  // number of tasks. Schedule is called from tasks of the same executor, so it
+  // mustn't wait for the queue
+  executor_->SubmitNoWait([this] { Run(); });
+}
+
+void BackgroundTask::Wait() {
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return !scheduled_; });
+  if (error_) {
+    std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+}
+
+void BackgroundTask::RethrowError() {
+  std::lock_guard lock(mutex_);
+  if (error_) {
+    std::rethrow_exception(std::exchange(error_, nullptr));
+  }
+}
+
+void BackgroundTask::Run() {
+  while (true) {
+    std::exception_ptr error;
+    try {
+      task_();
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard lock(mutex_);
+    if (error) {
+      error_ = error;
+    }
+    if (rerun_) {
+      rerun_ = false;
+      continue;
+    }
+    scheduled_ = false;
+    done_.notify_all();
+    return;
+  }
+}
+
+}  // namespace tskv
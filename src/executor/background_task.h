@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "executor.h"
+
+namespace tskv {
+
+// Task, that is run in background on demand. At most one run is queued or
+// running at a time, if the task is scheduled during its run, it's run once
+// more after that, so no request is lost
+class BackgroundTask {
+ public:
+  // task is run inline by Schedule, if there's no executor
+  BackgroundTask(std::shared_ptr<Executor> executor,
+                 std::function<void()> task);
+  BackgroundTask(const BackgroundTask&) = delete;
+  BackgroundTask& operator=(const BackgroundTask&) = delete;
+  // waits for the scheduled run, as it points to this
+  ~BackgroundTask();
+
+  void Schedule();
+  // waits until scheduled runs are done and rethrows error of the failed one
+  void Wait();
+  void RethrowError();
+
+ private:
+  void Run();
+
+ private:
+  std::shared_ptr<Executor> executor_;
+  std::function<void()> task_;
+
+  std::mutex mutex_;
+  std::condition_variable done_;
+  bool scheduled_{false};
+  bool rerun_{false};
+  std::exception_ptr error_;
+};
+
+}  // namespace tskv
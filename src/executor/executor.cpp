@@ -0,0 +1,65 @@
+#include "executor.h"
+
+#include <cassert>
+#include <utility>
+
+namespace tskv {
+
+Executor::Executor(const Options& options) : options_(options) {
+  assert(options_.threads_num > 0 && options_.max_queue_size > 0);
+  for (size_t i = 0; i < options_.threads_num; ++i) {
+    threads_.emplace_back([this] { Work(); });
+  }
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard lock(mutex_);
+    stopped_ = true;
+  }
+  not_empty_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void Executor::Submit(std::function<void()> task) {
+  {
+    std::unique_lock lock(mutex_);
+    not_full_.wait(lock,
+                   [this] { return tasks_.size() < options_.max_queue_size; });
+    tasks_.push_back(std::move(task));
+  }
+  not_empty_.notify_one();
+}
+
+void Executor::SubmitNoWait(std::function<void()> task) {
+  {
+    std::lock_guard lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  not_empty_.notify_one();
+}
+
+size_t Executor::GetThreadsNum() const {
+  return options_.threads_num;
+}
+
+void Executor::Work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock(mutex_);
+      not_empty_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    not_full_.notify_one();
+    task();
+  }
+}
+
+}  // namespace tskv
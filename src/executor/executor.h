@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tskv {
+
+// Thread pool with bounded queue of tasks. Submit blocks while the queue is
+// full, so producers are slowed down if tasks can't keep up. Background tasks
+// are submitted with SubmitNoWait, as they are often submitted by other tasks
+// of the same executor, and workers blocked in Submit would never free the
+// queue
+class Executor {
+ public:
+  struct Options {
+    size_t threads_num{1};
+    size_t max_queue_size{1024};
+  };
+
+ public:
+  explicit Executor(const Options& options);
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+  // runs all submitted tasks before returning
+  ~Executor();
+
+  void Submit(std::function<void()> task);
+  // ignores max_queue_size, so callers must bound the number of their tasks
+  // themselves
+  void SubmitNoWait(std::function<void()> task);
+  size_t GetThreadsNum() const;
+
+ private:
+  void Work();
+
+ private:
+  Options options_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  bool stopped_{false};
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace tskv
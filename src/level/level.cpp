@@ -2,129 +2,378 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <utility>
 
+#include "manifest/manifest.h"
 #include "model/column.h"
 #include "persistent-storage/persistent_storage.h"
 
 namespace tskv {
 
 Level::Level(const Options& options,
-             std::shared_ptr<IPersistentStorage> storage)
-    : options_(options), storage_(std::move(storage)) {}
+             std::shared_ptr<IPersistentStorage> storage,
+             std::shared_ptr<PageCache> page_cache)
+    : options_(options),
+      storage_(std::move(storage)),
+      page_cache_(std::move(page_cache)) {}
 
 Column Level::Read(const TimeRange& time_range,
                    StoredAggregationType aggregation_type) const {
-  if (page_ids_.empty()) {
-    return {};
-  }
-  auto column_type = ToColumnType(aggregation_type);
-  if (column_type == ColumnType::kRawRead) {
-    return ReadRawValues(time_range);
-  }
-  auto it = std::ranges::find(page_ids_, column_type,
-                              &std::pair<ColumnType, PageId>::first);
-  assert(it != page_ids_.end());
+  return Read(time_range, std::vector{aggregation_type}).front();
+}
 
-  auto bytes = storage_->Read(it->second);
-  auto column =
-      std::static_pointer_cast<IReadColumn>(FromBytes(bytes, column_type));
+Columns Level::Read(
+    const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types) const {
+  auto plan = PlanRead(time_range, aggregation_types);
+  if (plan.page_ids.empty()) {
+    return Columns(aggregation_types.size());
+  }
+  auto pages = LoadPages(*storage_, page_cache_.get(), plan.page_ids,
+                         plan.page_types);
+  return FinishRead(plan, pages);
+}
 
-  return column->Read(time_range);
+Level::PlannedRead Level::PlanRead(
+    const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types) const {
+  PlannedRead plan{.time_range = time_range, .pages_offsets = {0}};
+  for (auto aggregation_type : aggregation_types) {
+    auto column_type = ToColumnType(aggregation_type);
+    plan.column_types.push_back(column_type);
+    if (column_type == ColumnType::kRawRead) {
+      auto ts_it = segments_.find(ColumnType::kRawTimestamps);
+      auto vals_it = segments_.find(ColumnType::kRawValues);
+      if (ts_it != segments_.end() && vals_it != segments_.end()) {
+        const auto& ts_segments = ts_it->second;
+        const auto& vals_segments = vals_it->second;
+        assert(ts_segments.size() == vals_segments.size());
+        auto [begin, end] = FindSegments(ts_segments, time_range);
+        for (size_t i = begin; i < end; ++i) {
+          plan.page_ids.push_back(ts_segments[i].page_id);
+          plan.page_types.push_back(ColumnType::kRawTimestamps);
+          plan.page_ids.push_back(vals_segments[i].page_id);
+          plan.page_types.push_back(ColumnType::kRawValues);
+        }
+      }
+    } else if (auto it = segments_.find(column_type); it != segments_.end()) {
+      auto [begin, end] = FindSegments(it->second, time_range);
+      for (size_t i = begin; i < end; ++i) {
+        plan.page_ids.push_back(it->second[i].page_id);
+        plan.page_types.push_back(column_type);
+      }
+    }
+    plan.pages_offsets.push_back(plan.page_ids.size());
+  }
+  return plan;
 }
 
-Column Level::ReadRawValues(const TimeRange& time_range) const {
-  auto ts_it = std::ranges::find(page_ids_, ColumnType::kRawTimestamps,
-                                 &std::pair<ColumnType, PageId>::first);
-  if (ts_it == page_ids_.end()) {
-    return {};
+Columns Level::LoadPages(IPersistentStorage& storage, PageCache* page_cache,
+                         std::span<const PageId> page_ids,
+                         std::span<const ColumnType> page_types) {
+  Columns pages(page_ids.size());
+  std::vector<size_t> missed;
+  std::vector<PageId> missed_ids;
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    if (page_cache) {
+      pages[i] = page_cache->Get(&storage, page_ids[i]);
+    }
+    if (!pages[i]) {
+      missed.push_back(i);
+      missed_ids.push_back(page_ids[i]);
+    }
+  }
+  if (missed.empty()) {
+    return pages;
+  }
+  auto bytes = storage.ReadMany(missed_ids);
+  for (size_t i = 0; i < missed.size(); ++i) {
+    auto idx = missed[i];
+    // cached columns would keep a whole mapped segment alive, even after it's
+    // collected
+    bool copy = page_cache && bytes[i].shared_owner;
+    pages[idx] = FromBytes(bytes[i].bytes, page_types[idx],
+                           copy ? nullptr : bytes[i].owner);
+    if (page_cache) {
+      // decoded raw pages take several times more memory than encoded ones
+      page_cache->Put(&storage, page_ids[idx], pages[idx],
+                      pages[idx]->GetBytesSize());
+    }
   }
-  auto vals_it = std::ranges::find(page_ids_, ColumnType::kRawValues,
-                                   &std::pair<ColumnType, PageId>::first);
-  assert(vals_it != page_ids_.end());
-  auto ts_column = std::static_pointer_cast<RawTimestampsColumn>(
-      FromBytes(storage_->Read(ts_it->second), ColumnType::kRawTimestamps));
-  auto vals_column = std::static_pointer_cast<RawValuesColumn>(
-      FromBytes(storage_->Read(vals_it->second), ColumnType::kRawValues));
-  auto read_column = std::make_shared<ReadRawColumn>(ts_column, vals_column);
+  return pages;
+}
 
-  return read_column->Read(time_range);
+Columns Level::FinishRead(const PlannedRead& plan,
+                          std::span<const Column> pages) {
+  assert(pages.size() == plan.page_ids.size());
+  Columns result(plan.column_types.size());
+  for (size_t i = 0; i < plan.column_types.size(); ++i) {
+    auto column_type = plan.column_types[i];
+    auto begin = plan.pages_offsets[i];
+    auto end = plan.pages_offsets[i + 1];
+    if (column_type == ColumnType::kRawRead) {
+      for (size_t j = begin; j < end; j += 2) {
+        auto read_column = std::make_shared<ReadRawColumn>(
+            std::static_pointer_cast<RawTimestampsColumn>(pages[j]),
+            std::static_pointer_cast<RawValuesColumn>(pages[j + 1]));
+        MergeInto(result[i], read_column->Read(plan.time_range));
+      }
+      continue;
+    }
+    for (size_t j = begin; j < end; ++j) {
+      auto column = std::static_pointer_cast<IReadColumn>(pages[j]);
+      MergeInto(result[i], column->Read(plan.time_range));
+    }
+  }
+  return result;
 }
 
 void Level::Write(const SerializableColumn& column) {
-  if (!options_.store_raw &&
-      (column->GetType() == ColumnType::kRawValues ||
-       column->GetType() == ColumnType::kRawTimestamps)) {
-    return;
-  }
-  if (auto read_col = std::dynamic_pointer_cast<IReadColumn>(column)) {
-    auto time_range = read_col->GetTimeRange();
-    time_range_ = time_range_.Merge(time_range);
-  }
-  auto column_type = column->GetType();
-  auto it = std::ranges::find(page_ids_, column_type,
-                              &std::pair<ColumnType, PageId>::first);
-  if (it == page_ids_.end()) {
-    PageId page_id = storage_->CreatePage();
-    page_ids_.emplace_back(column_type, page_id);
-    storage_->Write(page_id, column->ToBytes());
-    return;
+  CommitWrite(PrepareWrite({column}));
+}
+
+Level::PreparedWrite Level::PrepareWrite(
+    const SerializableColumns& columns) const {
+  PageWrites writes;
+  auto prepared = PrepareWrite(columns, writes);
+  // pages of all columns are written with one batch
+  storage_->WriteMany(writes.page_ids, writes.pages);
+  return prepared;
+}
+
+Level::PreparedWrite Level::PrepareWrite(const SerializableColumns& columns,
+                                         PageWrites& writes) const {
+  PreparedWrite prepared;
+  for (const auto& column : columns) {
+    if (auto segment = CreateSegment(column, writes)) {
+      prepared.segments[column->GetType()].push_back(std::move(*segment));
+    }
   }
+  return prepared;
+}
 
-  PageId& page_id = it->second;
-  auto read_column = std::dynamic_pointer_cast<ISerializableColumn>(
-      FromBytes(storage_->Read(page_id), column_type));
-  read_column->Merge(column);
-  storage_->DeletePage(page_id);
-  page_id = storage_->CreatePage();
-  storage_->Write(page_id, read_column->ToBytes());
+void Level::CommitWrite(const PreparedWrite& prepared) {
+  for (const auto& [column_type, segments] : prepared.segments) {
+    for (const auto& segment : segments) {
+      AddSegment(column_type, segment);
+    }
+  }
 }
 
 void Level::MovePagesFrom(Level& other) {
-  if (options_.bucket_interval == other.options_.bucket_interval &&
-      options_.store_raw == other.options_.store_raw) {
-    page_ids_.insert(page_ids_.end(), other.page_ids_.begin(),
-                     other.page_ids_.end());
-  } else {
-    for (auto& [column_type, page_id] : other.page_ids_) {
-      auto it = std::ranges::find(page_ids_, column_type,
-                                  &std::pair<ColumnType, PageId>::first);
-      if (it == page_ids_.end()) {
-        if ((column_type == ColumnType::kRawTimestamps ||
-             column_type == ColumnType::kRawValues) &&
-            !options_.store_raw) {
-          storage_->DeletePage(page_id);
-        } else {
-          page_ids_.emplace_back(column_type, page_id);
-        }
-        continue;
-      }
+  auto compaction = StartCompaction(other);
+  BuildCompaction(compaction);
+  FinishCompaction(other, compaction);
+  DeleteCompactedPages(compaction);
+}
 
-      auto bytes = other.storage_->Read(page_id);
-      auto column = std::dynamic_pointer_cast<ISerializableColumn>(
-          FromBytes(bytes, column_type));
-      if (column_type == ColumnType::kRawTimestamps ||
-          column_type == ColumnType::kRawValues) {
-        Write(column);
-      } else {
-        auto aggreagte_column =
-            std::dynamic_pointer_cast<IAggregateColumn>(column);
-        aggreagte_column->ScaleBuckets(options_.bucket_interval);
-        Write(aggreagte_column);
+Level::Compaction Level::StartCompaction(const Level& other) const {
+  return {.source_storage = other.storage_,
+          .source_page_cache = other.page_cache_,
+          .source = other.segments_};
+}
+
+void Level::BuildCompaction(Compaction& compaction) const {
+  auto need_type = [&](ColumnType column_type) {
+    bool is_raw = column_type == ColumnType::kRawTimestamps ||
+                  column_type == ColumnType::kRawValues;
+    return !is_raw || options_.store_raw;
+  };
+  std::vector<PageId> page_ids;
+  for (const auto& [column_type, segments] : compaction.source) {
+    if (need_type(column_type)) {
+      for (const auto& segment : segments) {
+        page_ids.push_back(segment.page_id);
       }
-      other.storage_->DeletePage(page_id);
     }
   }
+  // read past the page cache, as merged columns are changed in place
+  auto pages = compaction.source_storage->ReadMany(page_ids);
 
-  time_range_ = time_range_.Merge(other.time_range_);
+  // all segments of the same type are merged into one
+  PageWrites writes;
+  size_t page_idx = 0;
+  for (const auto& [column_type, segments] : compaction.source) {
+    if (!need_type(column_type)) {
+      continue;
+    }
+    Column merged;
+    for (size_t i = 0; i < segments.size(); ++i, ++page_idx) {
+      MergeInto(merged, FromBytes(pages[page_idx].bytes, column_type,
+                                  pages[page_idx].owner));
+    }
+    auto column = std::dynamic_pointer_cast<ISerializableColumn>(merged);
+    if (column_type != ColumnType::kRawTimestamps &&
+        column_type != ColumnType::kRawValues) {
+      auto aggregate_column =
+          std::dynamic_pointer_cast<IAggregateColumn>(column);
+      aggregate_column->ScaleBuckets(options_.bucket_interval);
+    }
+    if (auto segment = CreateSegment(column, writes)) {
+      compaction.result.segments[column_type].push_back(std::move(*segment));
+    }
+  }
+  storage_->WriteMany(writes.page_ids, writes.pages);
+}
 
-  other.page_ids_.clear();
+void Level::FinishCompaction(Level& other, const Compaction& compaction) {
+  // other level could get new segments after the snapshot, they are kept
+  for (const auto& [column_type, segments] : compaction.source) {
+    auto& other_segments = other.segments_[column_type];
+    assert(other_segments.size() >= segments.size());
+    other_segments.erase(other_segments.begin(),
+                         other_segments.begin() + segments.size());
+    if (other_segments.empty()) {
+      other.segments_.erase(column_type);
+    }
+  }
   other.time_range_ = {};
+  for (const auto& [_, segments] : other.segments_) {
+    for (const auto& segment : segments) {
+      if (!segment.time_range.Empty()) {
+        other.time_range_ = other.time_range_.Merge(segment.time_range);
+      }
+    }
+  }
+
+  CommitWrite(compaction.result);
+}
+
+void Level::DeleteCompactedPages(const Compaction& compaction) {
+  std::vector<PageId> page_ids;
+  for (const auto& [_, segments] : compaction.source) {
+    for (const auto& segment : segments) {
+      page_ids.push_back(segment.page_id);
+    }
+  }
+  // erased first, so that a reused page id never gets the cached page
+  if (compaction.source_page_cache) {
+    compaction.source_page_cache->Erase(compaction.source_storage.get(),
+                                        page_ids);
+  }
+  compaction.source_storage->DeleteMany(page_ids);
+}
+
+std::optional<Level::Segment> Level::CreateSegment(
+    const SerializableColumn& column, PageWrites& writes) const {
+  auto column_type = column->GetType();
+  bool is_raw = column_type == ColumnType::kRawValues ||
+                column_type == ColumnType::kRawTimestamps;
+  if (!options_.store_raw && is_raw) {
+    return std::nullopt;
+  }
+  TimeRange time_range{};
+  if (auto read_col = std::dynamic_pointer_cast<IReadColumn>(column)) {
+    time_range = read_col->GetTimeRange();
+    if (time_range.Empty()) {
+      return std::nullopt;
+    }
+  } else if (auto ts_col =
+                 std::dynamic_pointer_cast<RawTimestampsColumn>(column)) {
+    if (ts_col->TimestampsNum() == 0) {
+      return std::nullopt;
+    }
+    time_range = ts_col->GetTimeRange();
+  } else if (auto vals_col =
+                 std::dynamic_pointer_cast<RawValuesColumn>(column)) {
+    if (vals_col->ValuesNum() == 0) {
+      return std::nullopt;
+    }
+  }
+  PageId page_id = storage_->CreatePage();
+  writes.page_ids.push_back(page_id);
+  writes.pages.push_back(column->ToBytes());
+  return Segment{time_range, std::move(page_id)};
+}
+
+void Level::AddSegment(ColumnType column_type, Segment segment) {
+  // segments are never rewritten, they are merged only during compaction
+  if (!segment.time_range.Empty()) {
+    time_range_ = time_range_.Merge(segment.time_range);
+  }
+  segments_[column_type].push_back(std::move(segment));
 }
 
 bool Level::NeedMerge() const {
   return time_range_.GetDuration() >= options_.level_duration;
 }
 
+TimeRange Level::GetTimeRange() const {
+  return time_range_;
+}
+
+Duration Level::GetBucketInterval() const {
+  return options_.bucket_interval;
+}
+
+CompressedBytes Level::ToBytes() const {
+  // the size is known in advance, so the bytes are copied into one buffer
+  // instead of growing it by every value
+  size_t bytes_size = sizeof(uint64_t);
+  for (const auto& [_, segments] : segments_) {
+    bytes_size += sizeof(ColumnType) + sizeof(uint64_t);
+    for (const auto& segment : segments) {
+      bytes_size +=
+          sizeof(TimeRange) + sizeof(uint64_t) + segment.page_id.size();
+    }
+  }
+  CompressedBytes bytes(bytes_size);
+  auto* out = bytes.data();
+  auto write = [&out](const void* value, size_t size) {
+    std::memcpy(out, value, size);
+    out += size;
+  };
+  auto types_num = static_cast<uint64_t>(segments_.size());
+  write(&types_num, sizeof(types_num));
+  for (const auto& [column_type, segments] : segments_) {
+    auto segments_num = static_cast<uint64_t>(segments.size());
+    write(&column_type, sizeof(column_type));
+    write(&segments_num, sizeof(segments_num));
+    for (const auto& segment : segments) {
+      auto page_id_size = static_cast<uint64_t>(segment.page_id.size());
+      write(&segment.time_range, sizeof(segment.time_range));
+      write(&page_id_size, sizeof(page_id_size));
+      write(segment.page_id.data(), segment.page_id.size());
+    }
+  }
+  return bytes;
+}
+
+void Level::RestoreFromBytes(CompressedBytesReader& reader) {
+  segments_.clear();
+  time_range_ = {};
+  auto types_num = reader.Read<uint64_t>();
+  for (size_t i = 0; i < types_num; ++i) {
+    auto column_type = reader.Read<ColumnType>();
+    auto segments_num = reader.Read<uint64_t>();
+    for (size_t j = 0; j < segments_num; ++j) {
+      auto time_range = reader.Read<TimeRange>();
+      AddSegment(column_type, {time_range, ReadString(reader)});
+    }
+  }
+}
+
+std::pair<size_t, size_t> Level::FindSegments(const Segments& segments,
+                                              const TimeRange& time_range) {
+  // segments are written in time order, so both starts and ends are sorted
+  auto begin = std::ranges::partition_point(segments, [&](const auto& segment) {
+    return segment.time_range.end <= time_range.start;
+  });
+  auto end = std::ranges::partition_point(
+      begin, segments.end(), [&](const auto& segment) {
+        return segment.time_range.start < time_range.end;
+      });
+  return {begin - segments.begin(), end - segments.begin()};
+}
+
+void Level::MergeInto(Column& result, Column column) {
+  if (!result) {
+    result = std::move(column);
+  } else {
+    result->Merge(std::move(column));
+  }
+}
+
 }  // namespace tskv
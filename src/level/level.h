@@ -1,5 +1,13 @@
 #pragma once
 
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "../cache/page_cache.h"
 #include "../model/column.h"
 #include "../model/model.h"
 #include "../persistent-storage/persistent_storage.h"
@@ -12,23 +20,119 @@ class Level {
     Duration bucket_interval;
     Duration level_duration;
     bool store_raw{false};
+
+    bool operator==(const Options& other) const = default;
   };
 
  public:
-  Level(const Options& options, std::shared_ptr<IPersistentStorage> storage);
+  // decoded pages are cached in page_cache, if set
+  Level(const Options& options, std::shared_ptr<IPersistentStorage> storage,
+        std::shared_ptr<PageCache> page_cache = nullptr);
   Column Read(const TimeRange& time_range,
               StoredAggregationType aggregation_type) const;
+  // reads several aggregations at once, result[i] is for aggregation_types[i]
+  Columns Read(const TimeRange& time_range,
+               const std::vector<StoredAggregationType>& aggregation_types)
+      const;
   void Write(const SerializableColumn& column);
+
+  // Read split into phases, so that pages of several levels are read with one
+  // batch: Plan lists pages to read, Load reads and decodes them, Finish
+  // builds columns from them
+  struct PlannedRead {
+    TimeRange time_range;
+    std::vector<ColumnType> column_types;
+    std::vector<PageId> page_ids;
+    // page_types[i] is the column type of page_ids[i]
+    std::vector<ColumnType> page_types;
+    // pages of column_types[i] are [pages_offsets[i], pages_offsets[i + 1]),
+    // raw timestamps and values pages go in pairs
+    std::vector<size_t> pages_offsets;
+  };
+  PlannedRead PlanRead(
+      const TimeRange& time_range,
+      const std::vector<StoredAggregationType>& aggregation_types) const;
+  // reads with one batch only pages, that aren't in page_cache (if set), and
+  // caches them after decoding
+  static Columns LoadPages(IPersistentStorage& storage, PageCache* page_cache,
+                           std::span<const PageId> page_ids,
+                           std::span<const ColumnType> page_types);
+  // pages[i] is the decoded page of plan.page_ids[i]
+  static Columns FinishRead(const PlannedRead& plan,
+                            std::span<const Column> pages);
+
+  // moves all pages of level to this one, merging them into one segment per
+  // column type
   void MovePagesFrom(Level& level);
   bool NeedMerge() const;
+  // time range of all stored pages, empty if there are no pages
+  TimeRange GetTimeRange() const;
+  Duration GetBucketInterval() const;
+  // segments of the level for the manifest, pages aren't included
+  CompressedBytes ToBytes() const;
+  void RestoreFromBytes(CompressedBytesReader& reader);
+
+  // immutable part of the level, merged with others only during compaction
+  struct Segment {
+    TimeRange time_range;
+    PageId page_id;
+  };
+  using Segments = std::vector<Segment>;
+
+  // Write split into phases: Prepare writes pages without changing the level,
+  // Commit appends their segments
+  struct PreparedWrite {
+    std::map<ColumnType, Segments> segments;
+  };
+  PreparedWrite PrepareWrite(const SerializableColumns& columns) const;
+  // pages written with one batch, can be of levels of different metrics, that
+  // share the storage
+  struct PageWrites {
+    std::vector<PageId> page_ids;
+    std::vector<CompressedBytes> pages;
+  };
+  // only adds pages to writes, the caller writes them before Commit
+  PreparedWrite PrepareWrite(const SerializableColumns& columns,
+                             PageWrites& writes) const;
+  void CommitWrite(const PreparedWrite& prepared);
+
+  // MovePagesFrom split into phases, so that the slow one (Build) can run
+  // without exclusive access to levels:
+  //  Start - takes snapshot of other level segments
+  //  Build - merges them into new pages of this level
+  //  Finish - replaces snapshotted segments with built ones
+  //  DeleteCompactedPages - deletes pages of snapshotted segments, after
+  //  nobody can read them
+  struct Compaction {
+    std::shared_ptr<IPersistentStorage> source_storage;
+    std::shared_ptr<PageCache> source_page_cache;
+    std::map<ColumnType, Segments> source;
+    PreparedWrite result;
+  };
+  Compaction StartCompaction(const Level& other) const;
+  void BuildCompaction(Compaction& compaction) const;
+  void FinishCompaction(Level& other, const Compaction& compaction);
+  static void DeleteCompactedPages(const Compaction& compaction);
 
  private:
-  Column ReadRawValues(const TimeRange& time_range) const;
+  // returns [begin, end) indices of segments, that overlap time_range
+  static std::pair<size_t, size_t> FindSegments(const Segments& segments,
+                                                const TimeRange& time_range);
+  // creates page for column and adds it to writes, returns nullopt if nothing
+  // has to be written
+  std::optional<Segment> CreateSegment(const SerializableColumn& column,
+                                       PageWrites& writes) const;
+  void AddSegment(ColumnType column_type, Segment segment);
+  // merges columns ordered by time
+  static void MergeInto(Column& result, Column column);
 
  private:
   Options options_;
   std::shared_ptr<IPersistentStorage> storage_;
-  std::vector<std::pair<ColumnType, PageId>> page_ids_;
+  std::shared_ptr<PageCache> page_cache_;
+  // segments of each column type ordered by time. Raw values segments are
+  // paired with raw timestamps ones by index and have empty time ranges
+  std::map<ColumnType, Segments> segments_;
   TimeRange time_range_{};
 };
 
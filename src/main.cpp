@@ -1,13 +1,17 @@
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <ostream>
 #include <random>
+#include <span>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "model/column.h"
 #include "model/model.h"
-#include "persistent-storage/disk_storage.h"
+#include "persistent-storage/segment_storage.h"
 #include "storage/storage.h"
 
 std::vector<std::string> Split(const std::string& s,
@@ -26,6 +30,17 @@ std::vector<std::string> Split(const std::string& s,
   return res;
 }
 
+// tags line is like tags,hostname=host_0,region=eu-west-1
+tskv::Labels ParseTags(const std::string& line) {
+  tskv::Labels labels;
+  auto tags = Split(line, ",");
+  for (size_t i = 1; i < tags.size(); ++i) {
+    auto pos = tags[i].find('=');
+    labels.push_back({tags[i].substr(0, pos), tags[i].substr(pos + 1)});
+  }
+  return labels;
+}
+
 struct WriteResult {
   tskv::TimeRange time_range;
   std::vector<tskv::MetricId> metrid_ids;
@@ -48,7 +63,12 @@ WriteResult Write(tskv::Storage& storage) {
   }
   constexpr uint64_t kMb = 1024 * 1024;
   constexpr uint64_t kBufferSize = 1 * kMb;
-  std::unordered_map<size_t, std::vector<tskv::InputTimeSeries>> time_series;
+  struct Series {
+    tskv::Labels labels;
+    std::vector<tskv::InputTimeSeries> batches;
+  };
+  // keyed by tags, measurement and field
+  std::unordered_map<std::string, Series> time_series;
   std::optional<tskv::TimePoint> min;
   std::optional<tskv::TimePoint> max;
   while (getline(input, line)) {
@@ -73,18 +93,22 @@ WriteResult Write(tskv::Storage& storage) {
       max = std::max(*max, timestamp);
     }
     for (int i = 2; i < metrics.size(); ++i) {
-      auto hash = std::hash<std::string>{}(tags + ',' + metric_type + ',' +
-                                           cur_metric_names[i - 2]);
+      const auto& field = cur_metric_names[i - 2];
       tskv::Value metric_value = std::strtod(metrics[i].c_str(), nullptr);
-      if (time_series.find(hash) == time_series.end()) {
-        time_series[hash] = std::vector<tskv::InputTimeSeries>();
+      auto [it, inserted] =
+          time_series.try_emplace(tags + ',' + metric_type + ',' + field);
+      auto& series = it->second;
+      if (inserted) {
+        series.labels = ParseTags(tags);
+        series.labels.push_back({std::string(tskv::kMetricNameLabel),
+                                 metric_type + '.' + field});
       }
-      if (time_series[hash].empty() ||
-          time_series[hash].back().size() * sizeof(tskv::Record) >=
+      if (series.batches.empty() ||
+          series.batches.back().size() * sizeof(tskv::Record) >=
               kBufferSize) {
-        time_series[hash].emplace_back();
+        series.batches.emplace_back();
       }
-      time_series[hash].back().emplace_back(timestamp, metric_value);
+      series.batches.back().emplace_back(timestamp, metric_value);
     }
   }
   input.close();
@@ -115,28 +139,36 @@ WriteResult Write(tskv::Storage& storage) {
                          .bucket_interval = tskv::Duration::Seconds(30),
                          .level_duration = tskv::Duration::Weeks(2),
                      }},
-          .storage =
-              std::make_unique<tskv::DiskStorage>(tskv::DiskStorage::Options{
+          .storage = std::make_shared<tskv::SegmentStorage>(
+              tskv::SegmentStorage::Options{
                   .path = "./tmp/tskv",
+                  .mmap_reads = true,
+                  .io_uring = true,
+                  .executor = std::make_shared<tskv::Executor>(
+                      tskv::Executor::Options{}),
               }),
+          .executor = std::make_shared<tskv::Executor>(
+              tskv::Executor::Options{}),
       },
+      std::make_shared<tskv::Executor>(tskv::Executor::Options{}),
   };
 
-  std::unordered_map<size_t, tskv::MetricId> metric_ids;
-  for (const auto& [hash, _] : time_series) {
-    metric_ids[hash] = storage.InitMetric(default_options);
+  std::unordered_map<std::string, tskv::MetricId> metric_ids;
+  for (const auto& [key, series] : time_series) {
+    metric_ids[key] = storage.InitMetric(series.labels, default_options);
   }
+  storage.ReplayWal();
 
   int idx = 0;
   while (true) {
     bool wrote = false;
 
-    for (auto& [hash, series] : time_series) {
-      if (idx >= series.size()) {
+    for (auto& [key, series] : time_series) {
+      if (idx >= series.batches.size()) {
         continue;
       }
-      auto& cur_time_series = series[idx];
-      storage.Write(metric_ids[hash], cur_time_series);
+      auto& cur_time_series = series.batches[idx];
+      storage.Write(metric_ids[key], cur_time_series);
       wrote = true;
     }
     ++idx;
@@ -179,17 +211,6 @@ struct SingleGroupByParams {
   }
 };
 
-tskv::Column MergeColumns(const std::vector<tskv::Column>& columns) {
-  if (columns.empty()) {
-    return {};
-  }
-  auto result = columns[0];
-  for (size_t i = 1; i < columns.size(); ++i) {
-    result->Merge(columns[i]);
-  }
-  return result;
-}
-
 // returns requsts per second
 double SingleGroupBy(tskv::Storage& storage, const tskv::TimeRange& time_range,
                      const std::vector<tskv::MetricId>& metric_ids,
@@ -214,25 +235,13 @@ double SingleGroupBy(tskv::Storage& storage, const tskv::TimeRange& time_range,
   }
 
   tskv::Column temp_result;
-  std::vector<tskv::Column> buffer;
   auto start = std::chrono::steady_clock::now();
   for (const auto& query : queries) {
-
-    for (const auto& metric_id : query.metric_ids) {
-      auto result =
-          storage.Read(metric_id, query.time_range, query.aggregation_type);
-      auto max_column = std::dynamic_pointer_cast<tskv::MaxColumn>(result);
-      max_column->ScaleBuckets(params.aggregation_window);
-      buffer.push_back(std::move(result));
-    }
-
+    std::span<const tskv::MetricId> query_ids = query.metric_ids;
     for (int i = 0; i < params.metric_count; ++i) {
-      std::vector<tskv::Column> to_merge;
-      for (int j = 0; j < params.host_count; ++j) {
-        to_merge.push_back(std::move(buffer.back()));
-        buffer.pop_back();
-      }
-      temp_result = MergeColumns(to_merge);
+      temp_result = storage.ReadGroup(
+          query_ids.subspan(i * params.host_count, params.host_count),
+          query.time_range, query.aggregation_type, params.aggregation_window);
     }
   }
   auto end = std::chrono::steady_clock::now();
@@ -244,7 +253,18 @@ double SingleGroupBy(tskv::Storage& storage, const tskv::TimeRange& time_range,
 }
 
 int main() {
-  tskv::Storage storage;
+  tskv::Storage storage(tskv::Storage::Options{
+      .wal =
+          tskv::Wal::Options{
+              .path = "./tmp/tskv-wal",
+              .sync_policy = tskv::Wal::SyncPolicy::kPeriodic,
+          },
+      .executor = std::make_shared<tskv::Executor>(tskv::Executor::Options{
+          .threads_num = std::max(1u, std::thread::hardware_concurrency())}),
+      .page_cache = tskv::PageCache::Options{},
+      // memtables of all series take at most 1 GB
+      .max_memtables_bytes_size = size_t{1} << 30,
+  });
   auto [time_range, metric_ids, write_time] = Write(storage);
   std::cout << metric_ids.size() << std::endl;
   std::cout << "write time: " << write_time << "ms" << std::endl;
@@ -263,12 +283,25 @@ int main() {
     read_rps.push_back(SingleGroupBy(storage, time_range, metric_ids, param));
   }
 
+  constexpr std::string_view kSelector = "cpu.usage_user{hostname=~host_[0-7]}";
+  auto select_start = std::chrono::steady_clock::now();
+  auto selected = storage.SelectMetrics(kSelector);
+  auto select_time = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - select_start)
+                         .count();
+
   std::ofstream output("performance.txt");
   output << "write time: " << write_time << "ms" << std::endl;
   for (size_t i = 0; i < params.size(); ++i) {
     output << params[i] << " read rps: " << read_rps[i] << std::endl;
   }
+  output << "select " << kSelector << ": " << selected.size()
+         << " series in " << select_time << "us" << std::endl;
+  auto cache_stats = storage.GetPageCacheStats();
+  output << "page cache hits: " << cache_stats.hits
+         << ", misses: " << cache_stats.misses << std::endl;
   output.close();
 
   std::filesystem::remove_all("./tmp/tskv");
+  std::filesystem::remove_all("./tmp/tskv-wal");
 }
@@ -0,0 +1,256 @@
+#include "manifest.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+namespace tskv {
+
+namespace {
+
+// file is [magic][format version][crc32 of payload][payload]
+constexpr uint64_t kManifestMagic = 0x7473'6b76'6d61'6e66ull;
+constexpr uint32_t kManifestFormatVersion = 1;
+constexpr size_t kManifestHeaderSize =
+    sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+void SyncPath(const std::filesystem::path& path, int flags) {
+  int fd = ::open(path.c_str(), flags | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("can't open " + path.string() + ": " +
+                             std::strerror(errno));
+  }
+  int res = ::fsync(fd);
+  ::close(fd);
+  if (res != 0) {
+    throw std::runtime_error("can't sync " + path.string() + ": " +
+                             std::strerror(errno));
+  }
+}
+
+// journal record is [payload size][crc32 of payload][payload]
+constexpr size_t kJournalHeaderSize = 2 * sizeof(uint32_t);
+
+// reads the whole opened file at once
+CompressedBytes ReadFile(std::ifstream& in, const std::filesystem::path& path) {
+  CompressedBytes bytes(std::filesystem::file_size(path));
+  in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+  bytes.resize(in.gcount());
+  return bytes;
+}
+
+}  // namespace
+
+void WriteManifest(const std::filesystem::path& path,
+                   const CompressedBytes& payload) {
+  CompressedBytes bytes;
+  bytes.reserve(kManifestHeaderSize + payload.size());
+  Append(bytes, kManifestMagic);
+  Append(bytes, kManifestFormatVersion);
+  Append(bytes, Crc32(payload));
+  bytes.insert(bytes.end(), payload.begin(), payload.end());
+
+  auto tmp_path = path;
+  tmp_path += ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+    if (!out) {
+      throw std::runtime_error("can't write " + tmp_path.string());
+    }
+  }
+  SyncPath(tmp_path, O_RDONLY);
+  std::filesystem::rename(tmp_path, path);
+  SyncDirectory(path.parent_path());
+}
+
+std::optional<CompressedBytes> ReadManifest(
+    const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return std::nullopt;
+  }
+  auto bytes = ReadFile(in, path);
+  if (bytes.size() < kManifestHeaderSize) {
+    throw std::runtime_error("manifest " + path.string() + " is corrupted");
+  }
+  CompressedBytesReader reader(bytes);
+  if (reader.Read<uint64_t>() != kManifestMagic) {
+    throw std::runtime_error(path.string() + " isn't a manifest");
+  }
+  if (reader.Read<uint32_t>() != kManifestFormatVersion) {
+    throw std::runtime_error("manifest " + path.string() +
+                             " has unsupported version");
+  }
+  auto crc = reader.Read<uint32_t>();
+  CompressedBytes payload(bytes.begin() + kManifestHeaderSize, bytes.end());
+  if (Crc32(payload) != crc) {
+    throw std::runtime_error("manifest " + path.string() + " is corrupted");
+  }
+  return payload;
+}
+
+void SyncDirectory(const std::filesystem::path& path) {
+  SyncPath(path.empty() ? "." : path, O_RDONLY | O_DIRECTORY);
+}
+
+Journal::Journal(std::filesystem::path path) : path_(std::move(path)) {}
+
+Journal::~Journal() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+std::vector<CompressedBytes> Journal::Recover() {
+  std::lock_guard lock(mutex_);
+  if (fd_ >= 0) {
+    throw std::runtime_error("journal " + path_.string() +
+                             " is already recovered");
+  }
+  std::vector<CompressedBytes> records;
+  std::ifstream in(path_, std::ios::binary);
+  if (in) {
+    auto bytes = ReadFile(in, path_);
+    size_t offset = 0;
+    while (bytes.size() - offset >= kJournalHeaderSize) {
+      uint32_t payload_size;
+      uint32_t crc;
+      std::memcpy(&payload_size, bytes.data() + offset, sizeof(uint32_t));
+      std::memcpy(&crc, bytes.data() + offset + sizeof(uint32_t),
+                  sizeof(uint32_t));
+      auto payload = std::span(bytes).subspan(offset + kJournalHeaderSize);
+      if (payload.size() < payload_size ||
+          Crc32(payload.first(payload_size)) != crc) {
+        break;
+      }
+      records.emplace_back(payload.begin(), payload.begin() + payload_size);
+      offset += kJournalHeaderSize + payload_size;
+    }
+    if (offset < bytes.size()) {
+      // torn append of the crashed run, cut so that new records follow valid
+      // ones
+      std::filesystem::resize_file(path_, offset);
+    }
+    size_ = offset;
+  }
+
+  fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("can't open " + path_.string() + ": " +
+                             std::strerror(errno));
+  }
+  if (!in) {
+    SyncDirectory(path_.parent_path());
+  }
+  return records;
+}
+
+void Journal::Append(const CompressedBytes& record) {
+  CompressedBytes bytes;
+  bytes.reserve(kJournalHeaderSize + record.size());
+  // the member hides free Append
+  tskv::Append(bytes, static_cast<uint32_t>(record.size()));
+  tskv::Append(bytes, Crc32(record));
+  bytes.insert(bytes.end(), record.begin(), record.end());
+
+  std::lock_guard lock(mutex_);
+  if (fd_ < 0) {
+    throw std::runtime_error("journal " + path_.string() +
+                             " must be recovered before appends");
+  }
+  if (failed_) {
+    throw std::runtime_error("journal " + path_.string() + " has failed");
+  }
+  // records are small, so the write is short and doesn't block others long
+  size_t offset = 0;
+  while (offset < bytes.size()) {
+    auto written = ::write(fd_, bytes.data() + offset, bytes.size() - offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // a partial record would hide the next ones from Recover
+      failed_ = true;
+      throw std::runtime_error("can't write " + path_.string() + ": " +
+                               std::strerror(errno));
+    }
+    offset += written;
+  }
+  size_ += bytes.size();
+  ++appended_;
+}
+
+void Journal::Sync() {
+  std::unique_lock lock(mutex_);
+  auto appended = appended_;
+  while (true) {
+    if (failed_) {
+      throw std::runtime_error("journal " + path_.string() + " has failed");
+    }
+    if (synced_num_ >= appended) {
+      return;
+    }
+    if (syncing_) {
+      synced_.wait(lock);
+      continue;
+    }
+
+    // syncs records of all waiting callers
+    syncing_ = true;
+    auto syncing_num = appended_;
+    lock.unlock();
+    int res = ::fdatasync(fd_);
+    lock.lock();
+    syncing_ = false;
+    if (res != 0) {
+      // records can be lost without an error of the next fsync
+      failed_ = true;
+      synced_.notify_all();
+      throw std::runtime_error("can't sync " + path_.string() + ": " +
+                               std::strerror(errno));
+    }
+    synced_num_ = syncing_num;
+    synced_.notify_all();
+  }
+}
+
+void Journal::Reset() {
+  std::lock_guard lock(mutex_);
+  if (failed_) {
+    throw std::runtime_error("journal " + path_.string() + " has failed");
+  }
+  if (::ftruncate(fd_, 0) != 0 || ::fdatasync(fd_) != 0) {
+    failed_ = true;
+    throw std::runtime_error("can't reset " + path_.string() + ": " +
+                             std::strerror(errno));
+  }
+  size_ = 0;
+}
+
+size_t Journal::GetSize() {
+  std::lock_guard lock(mutex_);
+  return size_;
+}
+
+void AppendString(CompressedBytes& bytes, const std::string& value) {
+  Append(bytes, static_cast<uint64_t>(value.size()));
+  Append(bytes, value.data(), value.size());
+}
+
+std::string ReadString(CompressedBytesReader& reader) {
+  auto size = reader.Read<uint64_t>();
+  std::string value(size, '\0');
+  for (auto& c : value) {
+    c = reader.Read<char>();
+  }
+  return value;
+}
+
+}  // namespace tskv
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "../model/column.h"
+#include "../model/compression.h"
+
+namespace tskv {
+
+// Manifests are small files with metadata, that are rewritten as a whole on
+// every change. The new version is written to a temporary file, synced and
+// renamed over the old one, so a crash leaves either the old or the new one.
+void WriteManifest(const std::filesystem::path& path,
+                   const CompressedBytes& payload);
+// returns nullopt if there is no manifest, throws if it's corrupted
+std::optional<CompressedBytes> ReadManifest(const std::filesystem::path& path);
+// files created, renamed or removed in the directory survive a crash only
+// after it's synced. Empty path is the current directory
+void SyncDirectory(const std::filesystem::path& path);
+
+// Append-only file of records, for metadata, that only grows, so that adding
+// an item writes only that item instead of rewriting the whole manifest.
+// Records are framed like WAL records, torn tail of a crashed run is cut by
+// Recover. Appends aren't synced, concurrent Sync calls share one fsync (group
+// commit), so callers sync outside of their locks.
+class Journal {
+ public:
+  explicit Journal(std::filesystem::path path);
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+  ~Journal();
+
+  // reads records of previous runs, must be called once before appends
+  std::vector<CompressedBytes> Recover();
+  // the record is durable after the next Sync
+  void Append(const CompressedBytes& record);
+  // returns after all appended records are synced
+  void Sync();
+  // deletes all records, after the caller has saved their state elsewhere
+  void Reset();
+  // bytes of records
+  size_t GetSize();
+
+ private:
+  std::filesystem::path path_;
+  int fd_{-1};
+  std::mutex mutex_;
+  std::condition_variable synced_;
+  size_t size_{0};
+  uint64_t appended_{0};
+  uint64_t synced_num_{0};
+  bool syncing_{false};
+  bool failed_{false};
+};
+
+void AppendString(CompressedBytes& bytes, const std::string& value);
+std::string ReadString(CompressedBytesReader& reader);
+
+}  // namespace tskv
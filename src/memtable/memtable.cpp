@@ -13,24 +13,42 @@
 
 namespace tskv {
 
-Memtable::Memtable(const Options& options, const MetricOptions& metric_options)
-    : options_(options) {
+namespace {
+
+std::vector<ColumnType> GetAggregateColumnTypes(
+    const MetricOptions& metric_options) {
+  std::vector<ColumnType> column_types;
   for (auto aggregation_type : metric_options.aggregation_types) {
-    auto column_type = ToColumnType(aggregation_type);
-    columns_.push_back(
-        CreateAggregatedColumn(column_type, options.bucket_interval));
-    assert(columns_.back()->GetType() == column_type);
+    column_types.push_back(ToColumnType(aggregation_type));
   }
+  return column_types;
+}
+
+}  // namespace
+
+Memtable::Memtable(const Options& options, const MetricOptions& metric_options)
+    : aggregates_(GetAggregateColumnTypes(metric_options),
+                  options.bucket_interval),
+      options_(options) {
   if (options.store_raw) {
-    columns_.push_back(CreateRawColumn(ColumnType::kRawTimestamps));
-    columns_.push_back(CreateRawColumn(ColumnType::kRawValues));
+    raw_columns_.push_back(CreateRawColumn(ColumnType::kRawTimestamps));
+    raw_columns_.push_back(CreateRawColumn(ColumnType::kRawValues));
   }
 }
 
 void Memtable::Write(const InputTimeSeries& time_series) {
-  for (auto& column : columns_) {
+  aggregates_.Write(time_series);
+  if (raw_columns_.empty() || time_series.empty()) {
+    return;
+  }
+  for (auto& column : raw_columns_) {
     column->Write(time_series);
   }
+  if (raw_bytes_size_ == 0) {
+    raw_time_range_.start = time_series.front().timestamp;
+  }
+  raw_time_range_.end = time_series.back().timestamp + 1;
+  raw_bytes_size_ += time_series.size() * (sizeof(TimePoint) + sizeof(Value));
 }
 
 Memtable::ReadResult Memtable::Read(
@@ -39,14 +57,8 @@ Memtable::ReadResult Memtable::Read(
   if (column_type == ColumnType::kRawRead) {
     return ReadRawValues(time_range);
   }
-  auto it = std::find_if(columns_.begin(), columns_.end(),
-                         [column_type](const auto& column) {
-                           return column->GetType() == column_type;
-                         });
-  assert(it != columns_.end());
-
-  auto column = std::static_pointer_cast<IReadColumn>(*it);
-  auto column_res = column->Read(time_range);
+  // the memtable keeps changing, so results don't share data with it
+  auto column_res = aggregates_.ReadCopy(column_type, time_range);
 
   if (!column_res) {
     return {.not_found = time_range};
@@ -60,11 +72,43 @@ Memtable::ReadResult Memtable::Read(
   return {.found = column_res, .not_found = not_found};
 }
 
+std::vector<Memtable::ReadResult> Memtable::Read(
+    const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types) const {
+  std::vector<ReadResult> result;
+  result.reserve(aggregation_types.size());
+  for (auto aggregation_type : aggregation_types) {
+    result.push_back(Read(time_range, aggregation_type));
+  }
+  return result;
+}
+
 Columns Memtable::ExtractColumns() {
-  Columns res;
-  for (auto& column : columns_) {
+  auto res = aggregates_.ExtractColumns();
+  for (auto& column : raw_columns_) {
     res.push_back(column->Extract());
   }
+  raw_bytes_size_ = 0;
+  raw_time_range_ = {};
+  return res;
+}
+
+Columns Memtable::GetColumns() const {
+  auto res = aggregates_.GetColumns();
+  for (const auto& column : raw_columns_) {
+    switch (column->GetType()) {
+      case ColumnType::kRawTimestamps:
+        res.push_back(std::make_shared<RawTimestampsColumn>(
+            *std::static_pointer_cast<RawTimestampsColumn>(column)));
+        break;
+      case ColumnType::kRawValues:
+        res.push_back(std::make_shared<RawValuesColumn>(
+            *std::static_pointer_cast<RawValuesColumn>(column)));
+        break;
+      default:
+        assert(false);
+    }
+  }
   return res;
 }
 
@@ -72,42 +116,26 @@ bool Memtable::NeedFlush() const {
   if (options_.max_bytes_size && GetBytesSize() > *options_.max_bytes_size) {
     return true;
   }
+  auto time_range = aggregates_.GetColumnsNum() > 0
+                        ? aggregates_.GetTimeRange()
+                        : raw_time_range_;
+  return options_.max_age && time_range.GetDuration() >= *options_.max_age;
+}
 
-  auto ts_it = std::ranges::find_if(columns_, [](const auto& column) {
-    return column->GetType() != ColumnType::kRawValues;
-  });
-  if (ts_it == columns_.end()) {
-    return false;
-  }
-  const auto& ts_column = *ts_it;
-  Duration age;
-  if (ts_column->GetType() == ColumnType::kRawTimestamps) {
-    auto raw_ts_column =
-        std::dynamic_pointer_cast<RawTimestampsColumn>(ts_column);
-    age = raw_ts_column->GetTimeRange().GetDuration();
-  } else {
-    auto ser_ts_column =
-        std::dynamic_pointer_cast<ISerializableColumn>(ts_column);
-    auto agg_ts_column =
-        std::dynamic_pointer_cast<IAggregateColumn>(ser_ts_column);
-    age = agg_ts_column->GetTimeRange().GetDuration();
-  }
-  if (options_.max_age && age >= *options_.max_age) {
-    return true;
-  }
-  return false;
+bool Memtable::Empty() const {
+  return GetBytesSize() == 0;
 }
 
 Memtable::ReadResult Memtable::ReadRawValues(
     const TimeRange& time_range) const {
-  auto ts_it = std::ranges::find(columns_, ColumnType::kRawTimestamps,
+  auto ts_it = std::ranges::find(raw_columns_, ColumnType::kRawTimestamps,
                                  &IColumn::GetType);
-  if (ts_it == columns_.end()) {
+  if (ts_it == raw_columns_.end()) {
     return {.not_found = time_range};
   }
-  auto vals_it =
-      std::ranges::find(columns_, ColumnType::kRawValues, &IColumn::GetType);
-  if (vals_it == columns_.end()) {
+  auto vals_it = std::ranges::find(raw_columns_, ColumnType::kRawValues,
+                                   &IColumn::GetType);
+  if (vals_it == raw_columns_.end()) {
     return {.not_found = time_range};
   }
   Memtable::ReadResult result;
@@ -115,7 +143,7 @@ Memtable::ReadResult Memtable::ReadRawValues(
   auto ts_column = std::static_pointer_cast<RawTimestampsColumn>(*ts_it);
   auto vals_column = std::static_pointer_cast<RawValuesColumn>(*vals_it);
   auto column = std::make_shared<ReadRawColumn>(ts_column, vals_column);
-  auto column_res = column->Read(time_range);
+  auto column_res = column->ReadCopy(time_range);
 
   if (!column_res) {
     return {.not_found = time_range};
@@ -129,44 +157,9 @@ Memtable::ReadResult Memtable::ReadRawValues(
 }
 
 size_t Memtable::GetBytesSize() const {
-  size_t size = 0;
-  for (const auto& column : columns_) {
-    switch (column->GetType()) {
-      case ColumnType::kSum:
-      case ColumnType::kCount:
-      case ColumnType::kMin:
-      case ColumnType::kMax:
-      case ColumnType::kLast: {
-        auto agg_column = std::dynamic_pointer_cast<IAggregateColumn>(column);
-        size_t buckets_num =
-            agg_column->GetTimeRange().GetDuration() / options_.bucket_interval;
-        size += buckets_num * sizeof(Value);
-        break;
-      }
-      case ColumnType::kAvg: {
-        auto avg_column = std::dynamic_pointer_cast<AvgColumn>(column);
-        size_t buckets_num =
-            avg_column->GetTimeRange().GetDuration() / options_.bucket_interval;
-        size += buckets_num * sizeof(Value);
-        break;
-      }
-      case ColumnType::kRawTimestamps: {
-        auto raw_ts_column =
-            std::dynamic_pointer_cast<RawTimestampsColumn>(column);
-        size += raw_ts_column->TimestampsNum() * sizeof(TimePoint);
-        break;
-      }
-      case ColumnType::kRawValues: {
-        auto raw_vals_column =
-            std::dynamic_pointer_cast<RawValuesColumn>(column);
-        size += raw_vals_column->ValuesNum() * sizeof(Value);
-        break;
-      }
-      default:
-        assert(false);
-    }
-  }
-  return size;
+  return aggregates_.GetBucketsNum() * aggregates_.GetColumnsNum() *
+             sizeof(Value) +
+         raw_bytes_size_;
 }
 
 }  // namespace tskv
@@ -22,6 +22,8 @@ class Memtable {
     std::optional<size_t> max_bytes_size;
     std::optional<Duration> max_age;
     bool store_raw{false};
+
+    bool operator==(const Options& other) const = default;
   };
 
   struct ReadResult {
@@ -32,19 +34,32 @@ class Memtable {
 
  public:
   Memtable(const Options& options, const MetricOptions& metric_options);
+  // all aggregates are written in one pass
   void Write(const InputTimeSeries& time_series);
   ReadResult Read(const TimeRange& time_range,
                   StoredAggregationType aggregation_type) const;
+  std::vector<ReadResult> Read(
+      const TimeRange& time_range,
+      const std::vector<StoredAggregationType>& aggregation_types) const;
   Columns ExtractColumns();
+  // same as ExtractColumns, but leaves memtable as is. Columns share data with
+  // it, so it's cheap
+  Columns GetColumns() const;
   bool NeedFlush() const;
+  bool Empty() const;
+  // bytes of stored values and timestamps
+  size_t GetBytesSize() const;
 
  private:
   ReadResult ReadRawValues(const TimeRange& time_range) const;
 
-  size_t GetBytesSize() const;
-
-  Columns columns_;
+  MultiAggregateColumn aggregates_;
+  Columns raw_columns_;
   Options options_;
+  // counted by Write, so that NeedFlush after every write doesn't look into
+  // raw columns
+  size_t raw_bytes_size_{0};
+  TimeRange raw_time_range_{};
 };
 
 }  // namespace tskv
@@ -6,63 +6,330 @@
 #include <cassert>
 #include <iostream>
 #include <ranges>
+#include <utility>
 
 namespace tskv {
 
+namespace {
+
+SerializableColumns GetSerializableColumns(const Memtable& memtable) {
+  SerializableColumns serializable_columns;
+  for (auto& column : memtable.GetColumns()) {
+    auto serializable_column =
+        std::dynamic_pointer_cast<ISerializableColumn>(std::move(column));
+    assert(serializable_column);
+    serializable_columns.emplace_back(std::move(serializable_column));
+  }
+  return serializable_columns;
+}
+
+}  // namespace
+
 MetricStorage::MetricStorage(const Options& options)
-    : memtable_(options.memtable_options, options.metric_options),
-      persistent_storage_manager_(options.persistent_storage_manager_options) {}
+    : MetricStorage(
+          std::make_shared<const Options>(options),
+          options.persistent_storage_manager_options.manifest_path) {}
+
+MetricStorage::MetricStorage(std::shared_ptr<const Options> options,
+                             std::optional<std::string> manifest_path)
+    : options_(std::move(options)),
+      // shares options with the manager
+      persistent_storage_manager_(
+          std::shared_ptr<const PersistentStorageManager::Options>(
+              options_, &options_->persistent_storage_manager_options),
+          std::move(manifest_path)),
+      flush_task_(options_->flush_executor,
+                  [this] { FlushImmutableMemtables(); }) {}
+
+const MetricStorage::Options& MetricStorage::GetOptions() const {
+  return *options_;
+}
 
 Column MetricStorage::Read(const TimeRange& time_range,
                            AggregationType aggregation_type) const {
   if (aggregation_type == AggregationType::kAvg) {
-    auto read1 = Read(time_range, AggregationType::kSum);
-    auto read2 = Read(time_range, AggregationType::kCount);
-    if (!read1 || !read2) {
+    auto columns = Read(time_range, {StoredAggregationType::kSum,
+                                     StoredAggregationType::kCount});
+    if (!columns[0] || !columns[1]) {
       return {};
     }
-    auto sum_column = std::dynamic_pointer_cast<SumColumn>(read1);
-    auto count_column = std::dynamic_pointer_cast<CountColumn>(read2);
+    auto sum_column = std::dynamic_pointer_cast<SumColumn>(columns[0]);
+    auto count_column = std::dynamic_pointer_cast<CountColumn>(columns[1]);
     return std::make_shared<AvgColumn>(std::move(sum_column),
                                        std::move(count_column));
   }
 
-  auto stored_aggregation = ToStoredAggregationType(aggregation_type);
-  auto [found, not_found] = memtable_.Read(time_range, stored_aggregation);
+  return Read(time_range, {ToStoredAggregationType(aggregation_type)}).front();
+}
+
+Columns MetricStorage::Read(
+    const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types) const {
+  auto plan = PlanRead(time_range, aggregation_types);
+  Columns pages;
+  if (plan.levels && !plan.levels->page_ids.empty()) {
+    pages = Level::LoadPages(*plan.levels->storage, plan.levels->page_cache,
+                             plan.levels->page_ids, plan.levels->page_types);
+  }
+  return FinishRead(std::move(plan), pages);
+}
+
+MetricStorage::PlannedRead MetricStorage::PlanRead(
+    const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types) const {
+  PlannedRead plan{.lock = std::shared_lock(memtables_mutex_),
+                   .columns_num = aggregation_types.size()};
+  // memtables store data suffixes, each one older than the previous, so every
+  // next one is read only for the range, that isn't found yet
+  std::optional<TimeRange> not_found = time_range;
+  auto read_memtable = [&](const Memtable& memtable) {
+    auto memtable_results = memtable.Read(*not_found, aggregation_types);
+    // all not found ranges are the same, unless some aggregation isn't found
+    // at all
+    not_found.reset();
+    for (const auto& memtable_result : memtable_results) {
+      if (memtable_result.not_found) {
+        not_found = not_found ? not_found->Merge(*memtable_result.not_found)
+                              : *memtable_result.not_found;
+      }
+    }
+    plan.memtables_results.push_back(std::move(memtable_results));
+  };
+  {
+    std::shared_lock memtable_lock(memtable_mutex_);
+    if (memtable_) {
+      read_memtable(*memtable_);
+    }
+  }
+  for (const auto& immutable_memtable :
+       std::views::reverse(immutable_memtables_)) {
+    if (!not_found) {
+      break;
+    }
+    read_memtable(*immutable_memtable.memtable);
+  }
 
-  Column column;
   if (not_found) {
-    column = persistent_storage_manager_.Read(*not_found, stored_aggregation);
+    plan.levels =
+        persistent_storage_manager_.PlanRead(*not_found, aggregation_types);
+  }
+  return plan;
+}
+
+Columns MetricStorage::FinishRead(PlannedRead plan,
+                                  std::span<const Column> pages) {
+  Columns result(plan.columns_num);
+  if (plan.levels) {
+    result = PersistentStorageManager::FinishRead(*plan.levels, pages);
   }
 
-  Column result = column;
-  if (!result) {
-    result = found;
-  } else {
-    result->Merge(found);
+  // merged from the oldest
+  for (const auto& memtable_results :
+       std::views::reverse(plan.memtables_results)) {
+    for (size_t i = 0; i < result.size(); ++i) {
+      if (!result[i]) {
+        result[i] = memtable_results[i].found;
+      } else {
+        result[i]->Merge(memtable_results[i].found);
+      }
+    }
   }
   return result;
 }
 
-void MetricStorage::Write(const InputTimeSeries& time_series) {
-  memtable_.Write(time_series);
+void MetricStorage::Write(const InputTimeSeries& time_series, Lsn lsn) {
+  flush_task_.RethrowError();
+  bool need_flush = false;
+  {
+    std::unique_lock lock(memtable_mutex_);
+    if (!memtable_) {
+      memtable_ = std::make_shared<Memtable>(options_->memtable_options,
+                                             options_->metric_options);
+    }
+    auto bytes_size = memtable_->GetBytesSize();
+    memtable_->Write(time_series);
+    if (options_->memtables_bytes_size) {
+      *options_->memtables_bytes_size +=
+          memtable_->GetBytesSize() - bytes_size;
+    }
+    if (lsn != 0) {
+      // unordered, if callers don't keep the order
+      memtable_first_lsn_ =
+          memtable_first_lsn_ ? std::min(*memtable_first_lsn_, lsn) : lsn;
+      memtable_last_lsn_ = std::max(memtable_last_lsn_, lsn);
+    }
+    need_flush = memtable_->NeedFlush();
+  }
 
-  if (memtable_.NeedFlush()) {
-    Flush();
+  if (need_flush) {
+    SealMemtable(true);
   }
 }
 
 void MetricStorage::Flush() {
-  auto columns = memtable_.ExtractColumns();
-  SerializableColumns serializable_columns;
-  serializable_columns.reserve(columns.size());
-  for (auto& column : columns) {
-    auto serializable_column =
-        std::dynamic_pointer_cast<ISerializableColumn>(std::move(column));
-    assert(serializable_column);
-    serializable_columns.emplace_back(std::move(serializable_column));
+  SealMemtable(false);
+  flush_task_.Wait();
+}
+
+void MetricStorage::SealMemtable(bool only_full) {
+  while (true) {
+    {
+      std::unique_lock lock(memtables_mutex_);
+      std::unique_lock memtable_lock(memtable_mutex_);
+      if (!memtable_ || memtable_->Empty() ||
+          (only_full && !memtable_->NeedFlush())) {
+        return;
+      }
+      if (immutable_memtables_.size() < options_->max_immutable_memtables) {
+        PushImmutableMemtable();
+        break;
+      }
+    }
+    // waits until full memtables are flushed, the flush is retried if it has
+    // failed, so that writers don't wait forever
+    flush_task_.Schedule();
+    flush_task_.Wait();
+  }
+  flush_task_.Schedule();
+}
+
+void MetricStorage::PushImmutableMemtable() {
+  auto bytes_size = memtable_->GetBytesSize();
+  immutable_memtables_.push_back({std::move(memtable_),
+                                  std::exchange(memtable_first_lsn_, {}),
+                                  memtable_last_lsn_, bytes_size});
+}
+
+void MetricStorage::PopImmutableMemtables(size_t num) {
+  auto end = immutable_memtables_.begin() + num;
+  for (auto it = immutable_memtables_.begin(); it != end; ++it) {
+    if (options_->memtables_bytes_size) {
+      *options_->memtables_bytes_size -= it->bytes_size;
+    }
+    // kept from a failed save too, it's retried by the next one
+    if (it->first_lsn) {
+      unsaved_first_lsn_ =
+          unsaved_first_lsn_ ? std::min(*unsaved_first_lsn_, *it->first_lsn)
+                             : it->first_lsn;
+    }
+  }
+  immutable_memtables_.erase(immutable_memtables_.begin(), end);
+}
+
+void MetricStorage::SaveFlushes(bool save_manifest) {
+  persistent_storage_manager_.AfterCommit(save_manifest);
+  std::unique_lock lock(memtables_mutex_);
+  unsaved_first_lsn_.reset();
+}
+
+void MetricStorage::FlushImmutableMemtables() {
+  while (true) {
+    std::lock_guard flush_lock(flush_mutex_);
+    ImmutableMemtable immutable_memtable;
+    {
+      std::shared_lock lock(memtables_mutex_);
+      if (immutable_memtables_.empty()) {
+        return;
+      }
+      immutable_memtable = immutable_memtables_.front();
+    }
+
+    // pages are written without the lock, so reads aren't blocked by I/O
+    auto prepared = persistent_storage_manager_.PrepareWrite(
+        GetSerializableColumns(*immutable_memtable.memtable));
+    {
+      std::unique_lock lock(memtables_mutex_);
+      persistent_storage_manager_.CommitWrite(prepared,
+                                              immutable_memtable.last_lsn);
+      PopImmutableMemtables(1);
+    }
+    // readers and writers aren't blocked by the manifest I/O
+    SaveFlushes(true);
+  }
+}
+
+MetricStorage::PreparedFlush MetricStorage::PrepareFlush(
+    Level::PageWrites& writes) {
+  PreparedFlush prepared{.lock = std::unique_lock(flush_mutex_)};
+  std::vector<ImmutableMemtable> immutable_memtables;
+  {
+    std::unique_lock lock(memtables_mutex_);
+    std::unique_lock memtable_lock(memtable_mutex_);
+    // flushed right away, so the limit of immutable memtables isn't waited
+    // for
+    if (memtable_ && !memtable_->Empty()) {
+      PushImmutableMemtable();
+    }
+    immutable_memtables = immutable_memtables_;
+  }
+  for (const auto& immutable_memtable : immutable_memtables) {
+    prepared.writes.push_back(persistent_storage_manager_.PrepareWrite(
+        GetSerializableColumns(*immutable_memtable.memtable), writes));
+    prepared.last_lsns.push_back(immutable_memtable.last_lsn);
+  }
+  return prepared;
+}
+
+void MetricStorage::CommitFlush(PreparedFlush& prepared) {
+  assert(prepared.lock.owns_lock());
+  std::unique_lock lock(memtables_mutex_);
+  for (size_t i = 0; i < prepared.writes.size(); ++i) {
+    persistent_storage_manager_.CommitWrite(prepared.writes[i],
+                                            prepared.last_lsns[i]);
   }
-  persistent_storage_manager_.Write(serializable_columns);
+  // memtables sealed after Prepare stay
+  PopImmutableMemtables(prepared.writes.size());
+}
+
+void MetricStorage::FinishFlush(PreparedFlush prepared, bool manifest_saved) {
+  assert(prepared.lock.owns_lock());
+  // one manifest for all memtables, saved without blocking readers
+  SaveFlushes(!manifest_saved);
+}
+
+CompressedBytes MetricStorage::SnapshotManifest() {
+  return persistent_storage_manager_.SnapshotManifest();
+}
+
+void MetricStorage::RestoreManifest(const CompressedBytes& payload) {
+  persistent_storage_manager_.RestoreManifest(payload);
+}
+
+void MetricStorage::SaveManifest() {
+  persistent_storage_manager_.SaveManifest();
+}
+
+std::optional<Lsn> MetricStorage::GetUnflushedLsn() const {
+  std::shared_lock lock(memtables_mutex_);
+  std::shared_lock memtable_lock(memtable_mutex_);
+  // the oldest memtable has the smallest lsn
+  if (unsaved_first_lsn_) {
+    return unsaved_first_lsn_;
+  }
+  for (const auto& immutable_memtable : immutable_memtables_) {
+    if (immutable_memtable.first_lsn) {
+      return immutable_memtable.first_lsn;
+    }
+  }
+  return memtable_first_lsn_;
+}
+
+Lsn MetricStorage::GetFlushedLsn() const {
+  return persistent_storage_manager_.GetFlushedLsn();
+}
+
+size_t MetricStorage::GetUnflushedBytesSize() const {
+  std::shared_lock lock(memtables_mutex_);
+  std::shared_lock memtable_lock(memtable_mutex_);
+  size_t bytes_size = memtable_ ? memtable_->GetBytesSize() : 0;
+  for (const auto& immutable_memtable : immutable_memtables_) {
+    bytes_size += immutable_memtable.bytes_size;
+  }
+  return bytes_size;
+}
+
+void MetricStorage::WaitForCompaction() {
+  persistent_storage_manager_.WaitForCompaction();
 }
 
 }  // namespace tskv
@@ -1,11 +1,20 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
 #include <vector>
+#include "../executor/background_task.h"
+#include "../executor/executor.h"
 #include "../memtable/memtable.h"
 #include "../model/aggregations.h"
 #include "../model/model.h"
 #include "../persistent-storage/persistent_storage_manager.h"
+#include "../wal/wal.h"
 
 // #include "c_compat.h"
 
@@ -13,8 +22,13 @@ namespace tskv {
 
 struct MetricOptions {
   std::vector<StoredAggregationType> aggregation_types;
+
+  bool operator==(const MetricOptions& other) const = default;
 };
 
+// Thread safe, reads can run concurrently with writes and with each other.
+// Concurrent writes are serialized, callers that log them must keep their lsn
+// order themselves
 class MetricStorage {
  public:
   struct Options {
@@ -22,18 +36,132 @@ class MetricStorage {
     Memtable::Options memtable_options;
 
     PersistentStorageManager::Options persistent_storage_manager_options;
+
+    // full memtables are flushed in background if set, otherwise during Write.
+    // Shouldn't be the same executor, that merges levels
+    std::shared_ptr<Executor> flush_executor;
+    // Write waits, if there are more full memtables waiting for flush
+    size_t max_immutable_memtables{2};
+    // bytes of memtables, that aren't flushed yet, are counted there, if set.
+    // Storage shares it between metrics to keep all memtables within a budget
+    std::shared_ptr<std::atomic<size_t>> memtables_bytes_size;
+
+    bool operator==(const Options& other) const = default;
   };
 
  public:
   explicit MetricStorage(const Options& options);
+  // options can be shared by metrics, so manifest_path of levels is passed
+  // apart from them, see PersistentStorageManager
+  MetricStorage(std::shared_ptr<const Options> options,
+                std::optional<std::string> manifest_path);
+  const Options& GetOptions() const;
   Column Read(const TimeRange& time_range,
               AggregationType aggregation_type) const;
-  void Write(const InputTimeSeries& time_series);
+  // reads several stored aggregations with one pass over memtable and levels,
+  // result[i] is for aggregation_types[i]
+  Columns Read(const TimeRange& time_range,
+               const std::vector<StoredAggregationType>& aggregation_types)
+      const;
+  // Read split into phases, so that pages of many metrics are read with one
+  // batch: Plan reads memtables and plans the read of levels for the rest of
+  // the range, the caller loads plan.levels pages (if set), Finish merges them
+  // with memtables results. Locks of the read are held till Finish
+  struct PlannedRead {
+    std::shared_lock<std::shared_mutex> lock;
+    // from the newest memtable
+    std::vector<std::vector<Memtable::ReadResult>> memtables_results;
+    std::optional<PersistentStorageManager::PlannedRead> levels;
+    size_t columns_num{0};
+  };
+  PlannedRead PlanRead(
+      const TimeRange& time_range,
+      const std::vector<StoredAggregationType>& aggregation_types) const;
+  // pages[i] is the loaded page of plan.levels->page_ids[i]
+  static Columns FinishRead(PlannedRead plan, std::span<const Column> pages);
+  // lsn is the WAL record of time_series, 0 if it isn't logged
+  void Write(const InputTimeSeries& time_series, Lsn lsn = 0);
+  // flushes all memtables and waits for it
   void Flush();
+  void WaitForCompaction();
+  // the first lsn, that is only in memtables, WAL records before it can be
+  // deleted
+  std::optional<Lsn> GetUnflushedLsn() const;
+  // WAL records up to it are already in levels and shouldn't be replayed
+  Lsn GetFlushedLsn() const;
+  // bytes of the current and immutable memtables
+  size_t GetUnflushedBytesSize() const;
+
+  // Flush of all memtables split into phases, so that pages and manifests of
+  // many metrics are written with one batch: Prepare seals the memtable and
+  // adds pages of all memtables to writes, Commit makes them visible to reads
+  // after the caller has written the pages, Finish saves the manifest of
+  // levels, unless the caller has saved SnapshotManifest with manifests of
+  // other metrics. Background flushes of the metric wait in between, the
+  // prepared flush is dropped, if pages aren't written
+  struct PreparedFlush {
+    std::unique_lock<std::mutex> lock;
+    std::vector<Level::PreparedWrite> writes;
+    std::vector<Lsn> last_lsns;
+  };
+  PreparedFlush PrepareFlush(Level::PageWrites& writes);
+  void CommitFlush(PreparedFlush& prepared);
+  void FinishFlush(PreparedFlush prepared, bool manifest_saved);
+  // see PersistentStorageManager
+  CompressedBytes SnapshotManifest();
+  void RestoreManifest(const CompressedBytes& payload);
+  void SaveManifest();
+
+ private:
+  // replaces memtable with an empty one and schedules its flush. Does nothing
+  // if it's empty or, with only_full, if it doesn't need flush anymore (other
+  // writer has already sealed it)
+  void SealMemtable(bool only_full);
+  // moves memtable_ to immutable memtables, must be called under unique
+  // memtables_mutex_ and memtable_mutex_
+  void PushImmutableMemtable();
+  // removes the oldest flushed memtables, must be called under unique
+  // memtables_mutex_. Their lsns stay unflushed until SaveFlushes
+  void PopImmutableMemtables(size_t num);
+  // saves the manifest after flushes are committed, unless the caller has
+  // saved it, so that WAL records of their memtables can be deleted
+  void SaveFlushes(bool save_manifest);
+  // flushes immutable memtables from the oldest
+  void FlushImmutableMemtables();
 
  private:
-  Memtable memtable_;
+  struct ImmutableMemtable {
+    std::shared_ptr<const Memtable> memtable;
+    std::optional<Lsn> first_lsn;
+    Lsn last_lsn{0};
+    size_t bytes_size{0};
+  };
+
+  std::shared_ptr<const Options> options_;
+  // guards the current memtable contents and its lsns, taken after
+  // memtables_mutex_ only for memtable writes and reads, so readers don't
+  // wait for I/O of each other with writers
+  mutable std::shared_mutex memtable_mutex_;
+  // created by the first write after the previous one is sealed, so idle
+  // metrics don't keep empty memtables
+  std::shared_ptr<Memtable> memtable_;
+  std::optional<Lsn> memtable_first_lsn_;
+  Lsn memtable_last_lsn_{0};
+  // full memtables, that aren't flushed yet, from the oldest
+  std::vector<ImmutableMemtable> immutable_memtables_;
+  // the first lsn of flushed memtables, whose pages aren't synced and aren't
+  // in the manifest yet, so a crash would lose them without the WAL
+  std::optional<Lsn> unsaved_first_lsn_;
   PersistentStorageManager persistent_storage_manager_;
+  // readers share it for the whole read, so that flushed memtable is found
+  // either among immutable ones or in levels, but not in both. Sealing
+  // memtable_ needs it too
+  mutable std::shared_mutex memtables_mutex_;
+  // held by a flush from writing pages of immutable memtables till their
+  // commit, so that a memtable isn't flushed twice
+  std::mutex flush_mutex_;
+  // last, so that it's destroyed before everything it uses
+  BackgroundTask flush_task_;
 };
 
 }  // namespace tskv
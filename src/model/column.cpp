@@ -10,12 +10,32 @@
 
 namespace tskv {
 
-AggregateColumn::AggregateColumn(Duration bucket_interval)
+namespace {
+
+template <typename T>
+Column ToColumn(std::shared_ptr<T> column) {
+  auto read_column = std::static_pointer_cast<IReadColumn>(column);
+  return std::static_pointer_cast<IColumn>(read_column);
+}
+
+// reserves at least twice the capacity, as reserving the exact size for every
+// small write reallocates the whole vector each time
+template <typename T>
+void ReserveMore(std::vector<T>& vector, size_t size) {
+  auto needed = vector.size() + size;
+  if (needed > vector.capacity()) {
+    vector.reserve(std::max(needed, 2 * vector.capacity()));
+  }
+}
+
+}  // namespace
+
+AggregatedBuckets::AggregatedBuckets(Duration bucket_interval)
     : bucket_interval_(bucket_interval) {}
 
-AggregateColumn::AggregateColumn(std::vector<double> buckets,
-                                 const TimePoint& start_time,
-                                 Duration bucket_interval)
+AggregatedBuckets::AggregatedBuckets(SharedBuffer<double> buckets,
+                                     const TimePoint& start_time,
+                                     Duration bucket_interval)
     : buckets_(std::move(buckets)),
       start_time_(start_time),
       bucket_interval_(bucket_interval) {
@@ -26,57 +46,25 @@ AggregateColumn::AggregateColumn(std::vector<double> buckets,
   assert(start_time % bucket_interval_ == 0);
 }
 
-ReadColumn AggregateColumn::Read(const TimeRange& time_range,
-                                 ColumnType column_type) const {
-  if (buckets_.empty()) {
-    return std::shared_ptr<SumColumn>(nullptr);
+std::optional<AggregatedBuckets> AggregatedBuckets::Slice(
+    const TimeRange& time_range) const {
+  if (buckets_.empty() || time_range.end <= start_time_) {
+    return std::nullopt;
   }
-  auto start_bucket = *GetBucketIdx(time_range.start);
-  auto end_bucket = *GetBucketIdx(time_range.end);
+  auto start_bucket = GetBucketIdx(time_range.start);
+  auto end_bucket = GetBucketIdx(time_range.end);
   if (end_bucket < buckets_.size() && time_range.end % bucket_interval_ != 0) {
     ++end_bucket;
   }
-  if (start_bucket == end_bucket) {
-    return std::shared_ptr<SumColumn>(nullptr);
-  }
-  auto new_start_time = start_time_;
-  if (time_range.start > start_time_) {
-    new_start_time =
-        time_range.start - (time_range.start - start_time_) % bucket_interval_;
-  }
-  auto data = std::vector<double>(buckets_.begin() + start_bucket,
-                                  buckets_.begin() + end_bucket);
-  switch (column_type) {
-    case ColumnType::kSum: {
-      return std::make_shared<SumColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    case ColumnType::kCount: {
-      return std::make_shared<CountColumn>(std::move(data), new_start_time,
-                                           bucket_interval_);
-    }
-    case ColumnType::kMin: {
-      return std::make_shared<MinColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    case ColumnType::kMax: {
-      return std::make_shared<MaxColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    case ColumnType::kLast: {
-      return std::make_shared<LastColumn>(std::move(data), new_start_time,
-                                          bucket_interval_);
-    }
-    case ColumnType::kAvg: {
-      return std::make_shared<AvgColumn>(std::move(data), new_start_time,
-                                         bucket_interval_);
-    }
-    default:
-      throw std::runtime_error("Unknown column type");
+  if (start_bucket >= end_bucket) {
+    return std::nullopt;
   }
+  return AggregatedBuckets(buckets_.Slice(start_bucket, end_bucket),
+                           start_time_ + start_bucket * bucket_interval_,
+                           bucket_interval_);
 }
 
-CompressedBytes AggregateColumn::ToBytes() const {
+CompressedBytes AggregatedBuckets::ToBytes() const {
   CompressedBytes res;
   Append(res, bucket_interval_);
   Append(res, start_time_);
@@ -84,7 +72,7 @@ CompressedBytes AggregateColumn::ToBytes() const {
   return res;
 }
 
-std::optional<size_t> AggregateColumn::GetBucketIdx(TimePoint timestamp) const {
+size_t AggregatedBuckets::GetBucketIdx(TimePoint timestamp) const {
   if (timestamp < start_time_) {
     return 0;
   }
@@ -97,165 +85,114 @@ std::optional<size_t> AggregateColumn::GetBucketIdx(TimePoint timestamp) const {
   return (timestamp - start_time_) / bucket_interval_;
 }
 
-std::vector<Value> AggregateColumn::GetValues() const {
-  return buckets_;
+std::vector<Value> AggregatedBuckets::GetValues() const {
+  return buckets_.ToVector();
 }
 
-TimeRange AggregateColumn::GetTimeRange() const {
-  return {start_time_, start_time_ + buckets_.size() * bucket_interval_};
+size_t AggregatedBuckets::GetBytesSize() const {
+  return buckets_.size() * sizeof(double);
 }
 
-Column AggregateColumn::Extract(ColumnType column_type) {
-  std::shared_ptr<IAggregateColumn> col;
-  switch (column_type) {
-    case ColumnType::kSum: {
-      col = std::make_shared<SumColumn>(std::move(buckets_), start_time_,
-                                        bucket_interval_);
-      break;
-    }
-    case ColumnType::kCount: {
-      col = std::make_shared<CountColumn>(std::move(buckets_), start_time_,
-                                          bucket_interval_);
-      break;
-    }
-    case ColumnType::kMin: {
-      col = std::make_shared<MinColumn>(std::move(buckets_), start_time_,
-                                        bucket_interval_);
-      break;
-    }
-    case ColumnType::kMax: {
-      col = std::make_shared<MaxColumn>(std::move(buckets_), start_time_,
-                                        bucket_interval_);
-      break;
-    }
-    case ColumnType::kLast: {
-      col = std::make_shared<LastColumn>(std::move(buckets_), start_time_,
-                                         bucket_interval_);
-      break;
-    }
-    default:
-      throw std::runtime_error("Type " +
-                               std::to_string(static_cast<int>(column_type)) +
-                               " is not to extract");
-  }
-  buckets_ = {};
-  start_time_ = 0;
-  auto read_column = std::static_pointer_cast<IReadColumn>(col);
-  return std::static_pointer_cast<IColumn>(read_column);
+TimeRange AggregatedBuckets::GetTimeRange() const {
+  return {start_time_, start_time_ + buckets_.size() * bucket_interval_};
 }
 
-SumColumn::SumColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
+template <typename Op>
+AggregateColumn<Op>::AggregateColumn(Duration bucket_interval)
+    : AggregatedBuckets(bucket_interval) {}
 
-SumColumn::SumColumn(std::vector<double> buckets, const TimePoint& start_time,
-                     Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
+template <typename Op>
+AggregateColumn<Op>::AggregateColumn(SharedBuffer<double> buckets,
+                                     const TimePoint& start_time,
+                                     Duration bucket_interval)
+    : AggregatedBuckets(std::move(buckets), start_time, bucket_interval) {}
+
+template <typename Op>
+AggregateColumn<Op>::AggregateColumn(AggregatedBuckets buckets)
+    : AggregatedBuckets(std::move(buckets)) {}
 
-ColumnType SumColumn::GetType() const {
-  return ColumnType::kSum;
+template <typename Op>
+ColumnType AggregateColumn<Op>::GetType() const {
+  return Op::kType;
 }
 
-void SumColumn::ScaleBuckets(Duration bucket_interval) {
+template <typename Op>
+void AggregateColumn<Op>::ScaleBuckets(Duration bucket_interval) {
   if (bucket_interval == bucket_interval_) {
     return;
   }
   assert(bucket_interval % bucket_interval_ == 0);
   auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double sum = 0;
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    sum += buckets_[i];
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = sum;
-      sum = 0;
-      updated = false;
+  auto new_start_time = start_time_ - start_time_ % bucket_interval;
+  // the first new bucket may be covered only partially
+  auto head = scale - (start_time_ - new_start_time) / bucket_interval_;
+  auto buckets = buckets_.View();
+  size_t new_buckets_sz = 0;
+  if (!buckets.empty()) {
+    new_buckets_sz = 1;
+    if (buckets.size() > head) {
+      new_buckets_sz += (buckets.size() - head + scale - 1) / scale;
     }
   }
 
-  if (updated) {
-    buckets_[pos++] = sum;
-  }
-
-  assert(pos == new_buckets_sz);
+  std::vector<double> scaled(new_buckets_sz);
+  [[maybe_unused]] auto written =
+      ReduceStrided(Op::kReduce, buckets, head, scale, scaled.data());
+  assert(written == new_buckets_sz);
 
-  start_time_ = start_time_ - start_time_ % bucket_interval;
+  start_time_ = new_start_time;
   bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+  buckets_ = std::move(scaled);
 }
 
-void SumColumn::Merge(Column column) {
+template <typename Op>
+void AggregateColumn<Op>::Merge(Column column) {
   if (!column) {
     return;
   }
-  auto sum_column = std::dynamic_pointer_cast<SumColumn>(column);
-  if (!sum_column) {
+  auto other = std::dynamic_pointer_cast<AggregateColumn>(column);
+  if (!other) {
     throw std::runtime_error("Can't merge columns of different types");
   }
-  if (this == sum_column.get()) {
+  if (this == other.get()) {
     return;
   }
-  if (sum_column->bucket_interval_ != bucket_interval_) {
-    if (sum_column->bucket_interval_ < bucket_interval_) {
-      sum_column->ScaleBuckets(bucket_interval_);
+  if (other->bucket_interval_ != bucket_interval_) {
+    if (other->bucket_interval_ < bucket_interval_) {
+      other->ScaleBuckets(bucket_interval_);
     } else {
-      ScaleBuckets(sum_column->bucket_interval_);
+      ScaleBuckets(other->bucket_interval_);
     }
   }
   if (buckets_.empty()) {
-    buckets_ = sum_column->buckets_;
-    start_time_ = sum_column->start_time_;
+    buckets_ = other->buckets_;
+    start_time_ = other->start_time_;
     return;
   }
-  if (sum_column->buckets_.empty()) {
+  if (other->buckets_.empty()) {
     return;
   }
-  if (sum_column->start_time_ < start_time_) {
+  if (other->start_time_ < start_time_) {
     throw std::runtime_error("Wrong merge order");
   }
 
-  auto sum_column_time_range = sum_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(sum_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(sum_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] += sum_column->buckets_[i - intersection_start];
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (sum_column->start_time_ > cur_time_range.end) {
-    auto to_insert_zeroes =
-        (sum_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_zeroes; ++i) {
-      buckets_.push_back(0);
-    }
-  }
-
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(sum_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
+  // buckets after the end of this column and the gap before them are filled
+  // with identity, so they can be combined like the intersecting ones
+  auto offset = (other->start_time_ - start_time_) / bucket_interval_;
+  auto other_buckets = other->buckets_.View();
+  auto& buckets = buckets_.Mutable();
+  if (offset + other_buckets.size() > buckets.size()) {
+    buckets.resize(offset + other_buckets.size(), Op::kIdentity);
   }
+  CombineInto(Op::kReduce, buckets.data() + offset, other_buckets);
 }
 
-void SumColumn::Write(const InputTimeSeries& time_series) {
+template <typename Op>
+void AggregateColumn<Op>::Write(const InputTimeSeries& time_series) {
   assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
+  if (time_series.empty()) {
+    return;
+  }
   if (buckets_.empty()) {
     start_time_ = time_series.front().timestamp -
                   time_series.front().timestamp % bucket_interval_;
@@ -265,649 +202,224 @@ void SumColumn::Write(const InputTimeSeries& time_series) {
   auto needed_size =
       (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
       bucket_interval_;
-  buckets_.resize(needed_size);
+  auto& buckets = buckets_.Mutable();
+  if (needed_size > buckets.size()) {
+    buckets.resize(needed_size, Op::kIdentity);
+  }
   for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] += record.value;
+    auto idx = (record.timestamp - start_time_) / bucket_interval_;
+    buckets[idx] = Op::Update(buckets[idx], record.value);
   }
 }
 
-ReadColumn SumColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kSum);
+template <typename Op>
+ReadColumn AggregateColumn<Op>::Read(const TimeRange& time_range) const {
+  auto buckets = Slice(time_range);
+  if (!buckets) {
+    return std::shared_ptr<AggregateColumn>(nullptr);
+  }
+  return std::make_shared<AggregateColumn>(std::move(*buckets));
 }
 
-std::vector<Value> SumColumn::GetValues() const {
-  return column_.GetValues();
+template <typename Op>
+std::vector<Value> AggregateColumn<Op>::GetValues() const {
+  return AggregatedBuckets::GetValues();
 }
 
-TimeRange SumColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
+template <typename Op>
+size_t AggregateColumn<Op>::GetBytesSize() const {
+  return AggregatedBuckets::GetBytesSize();
 }
 
-Column SumColumn::Extract() {
-  return column_.Extract(ColumnType::kSum);
+template <typename Op>
+TimeRange AggregateColumn<Op>::GetTimeRange() const {
+  return AggregatedBuckets::GetTimeRange();
 }
 
-CompressedBytes SumColumn::ToBytes() const {
-  return column_.ToBytes();
+template <typename Op>
+Column AggregateColumn<Op>::Extract() {
+  auto col = std::make_shared<AggregateColumn>(std::move(buckets_),
+                                               start_time_, bucket_interval_);
+  buckets_ = {};
+  start_time_ = 0;
+  return ToColumn(std::move(col));
 }
 
-size_t SumColumn::GetBucketsNum() const {
-  return buckets_.size();
+template <typename Op>
+CompressedBytes AggregateColumn<Op>::ToBytes() const {
+  return AggregatedBuckets::ToBytes();
 }
 
-CountColumn::CountColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-CountColumn::CountColumn(std::vector<double> buckets,
-                         const TimePoint& start_time, Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType CountColumn::GetType() const {
-  return ColumnType::kCount;
+template <typename Op>
+size_t AggregateColumn<Op>::GetBucketsNum() const {
+  return buckets_.size();
 }
 
-void CountColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
-  }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  size_t count = 0;
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    count += buckets_[i];
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = count;
-      count = 0;
-      updated = false;
-    }
-  }
+template class AggregateColumn<SumOp>;
+template class AggregateColumn<CountOp>;
+template class AggregateColumn<MinOp>;
+template class AggregateColumn<MaxOp>;
+template class AggregateColumn<LastOp>;
 
-  if (updated) {
-    buckets_[pos++] = count;
-  }
+namespace {
 
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
-}
-
-void CountColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto count_column = std::dynamic_pointer_cast<CountColumn>(column);
-  if (!count_column) {
-    throw std::runtime_error("Can't merge columns of different types");
-  }
-  if (this == count_column.get()) {
-    return;
-  }
-  if (count_column->bucket_interval_ != bucket_interval_) {
-    if (count_column->bucket_interval_ < bucket_interval_) {
-      count_column->ScaleBuckets(bucket_interval_);
-    } else {
-      ScaleBuckets(count_column->bucket_interval_);
-    }
-  }
-  if (buckets_.empty()) {
-    buckets_ = count_column->buckets_;
-    start_time_ = count_column->start_time_;
-    return;
-  }
-  if (count_column->buckets_.empty()) {
-    return;
-  }
-  if (count_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
-  }
-
-  auto count_column_time_range = count_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(count_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(count_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] += count_column->buckets_[i - intersection_start];
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (count_column->start_time_ > cur_time_range.end) {
-    auto to_insert_zeroes =
-        (count_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_zeroes; ++i) {
-      buckets_.push_back(0);
-    }
-  }
-
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(count_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
-  }
-}
-
-void CountColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
-  }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
-  auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size);
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    ++buckets_[idx];
+template <typename Op>
+void UpdateBuckets(double* buckets, size_t idx, Value value) {
+  if (buckets) {
+    buckets[idx] = Op::Update(buckets[idx], value);
   }
 }
 
-ReadColumn CountColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kCount);
+template <typename Op>
+ReadColumn MakeAggregateColumn(
+    SharedBuffer<double> buckets, TimePoint start_time,
+    Duration bucket_interval) {
+  return std::make_shared<AggregateColumn<Op>>(std::move(buckets), start_time,
+                                               bucket_interval);
 }
 
-std::vector<Value> CountColumn::GetValues() const {
-  return column_.GetValues();
-}
-
-TimeRange CountColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
-}
-
-Column CountColumn::Extract() {
-  return column_.Extract(ColumnType::kCount);
-}
-
-CompressedBytes CountColumn::ToBytes() const {
-  return column_.ToBytes();
-}
-
-size_t CountColumn::GetBucketsNum() const {
-  return buckets_.size();
-}
-
-MinColumn::MinColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-MinColumn::MinColumn(std::vector<double> buckets, const TimePoint& start_time,
-                     Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType MinColumn::GetType() const {
-  return ColumnType::kMin;
-}
-
-void MinColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
-  }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double min = std::numeric_limits<double>::max();
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    min = std::min(min, buckets_[i]);
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = min;
-      min = std::numeric_limits<double>::max();
-      updated = false;
+ReadColumn MakeAggregateColumn(ColumnType column_type,
+                               SharedBuffer<double> buckets,
+                               TimePoint start_time, Duration bucket_interval) {
+  ReadColumn column;
+  ForEachAggregateOp([&]<typename Op>(Op) {
+    if (Op::kType == column_type) {
+      column = MakeAggregateColumn<Op>(std::move(buckets), start_time,
+                                       bucket_interval);
     }
+  });
+  if (!column) {
+    throw std::runtime_error("Unsupported column type");
   }
-
-  if (updated) {
-    buckets_[pos++] = min;
-  }
-
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+  return column;
 }
 
-void MinColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto min_column = std::dynamic_pointer_cast<MinColumn>(column);
-  if (!min_column) {
-    throw std::runtime_error("Can't merge columns of different types");
-  }
-  if (this == min_column.get()) {
-    return;
-  }
-  if (min_column->bucket_interval_ != bucket_interval_) {
-    if (min_column->bucket_interval_ < bucket_interval_) {
-      min_column->ScaleBuckets(bucket_interval_);
-    } else {
-      ScaleBuckets(min_column->bucket_interval_);
-    }
-  }
-  if (buckets_.empty()) {
-    buckets_ = min_column->buckets_;
-    start_time_ = min_column->start_time_;
-    return;
-  }
-  if (min_column->buckets_.empty()) {
-    return;
-  }
-  if (min_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
-  }
+}  // namespace
 
-  auto min_column_time_range = min_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(min_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(min_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] =
-        std::min(buckets_[i], min_column->buckets_[i - intersection_start]);
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (min_column->start_time_ > cur_time_range.end) {
-    auto to_insert_max =
-        (min_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_max; ++i) {
-      buckets_.push_back(std::numeric_limits<double>::max());
+MultiAggregateColumn::MultiAggregateColumn(
+    const std::vector<ColumnType>& column_types, Duration bucket_interval)
+    : bucket_interval_(bucket_interval) {
+  for (auto column_type : column_types) {
+    if (static_cast<size_t>(column_type) >= kAggregatesNum) {
+      throw std::runtime_error("Type " +
+                               std::to_string(static_cast<int>(column_type)) +
+                               " is not an aggregate");
+    }
+    if (std::ranges::find(GetColumnTypes(), column_type) ==
+        GetColumnTypes().end()) {
+      column_types_[column_types_num_++] = column_type;
     }
-  }
-
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(min_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
   }
 }
 
-void MinColumn::Write(const InputTimeSeries& time_series) {
+void MultiAggregateColumn::Write(const InputTimeSeries& time_series) {
   assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
+  if (time_series.empty() || column_types_num_ == 0) {
+    return;
+  }
+  if (buckets_num_ == 0) {
     start_time_ = time_series.front().timestamp -
                   time_series.front().timestamp % bucket_interval_;
   }
-  assert(start_time_ % bucket_interval_ == 0);
   assert(time_series.front().timestamp >= start_time_);
   auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size, std::numeric_limits<double>::max());
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] = std::min(buckets_[idx], record.value);
-  }
-}
-
-ReadColumn MinColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kMin);
-}
-
-std::vector<Value> MinColumn::GetValues() const {
-  return column_.GetValues();
-}
-
-TimeRange MinColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
-}
-
-Column MinColumn::Extract() {
-  return column_.Extract(ColumnType::kMin);
-}
-
-CompressedBytes MinColumn::ToBytes() const {
-  return column_.ToBytes();
-}
-
-size_t MinColumn::GetBucketsNum() const {
-  return buckets_.size();
-}
-
-MaxColumn::MaxColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-MaxColumn::MaxColumn(std::vector<double> buckets, const TimePoint& start_time,
-                     Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType MaxColumn::GetType() const {
-  return ColumnType::kMax;
-}
-
-void MaxColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
-  }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double max = std::numeric_limits<double>::lowest();
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    max = std::max(max, buckets_[i]);
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = max;
-      max = std::numeric_limits<double>::lowest();
-      updated = false;
-    }
-  }
-
-  if (updated) {
-    buckets_[pos++] = max;
-  }
-
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
-}
-
-void MaxColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto max_column = std::dynamic_pointer_cast<MaxColumn>(column);
-  if (!max_column) {
-    throw std::runtime_error("Can't merge columns of different types");
-  }
-  if (this == max_column.get()) {
-    return;
-  }
-  if (max_column->bucket_interval_ != bucket_interval_) {
-    if (max_column->bucket_interval_ < bucket_interval_) {
-      max_column->ScaleBuckets(bucket_interval_);
-    } else {
-      ScaleBuckets(max_column->bucket_interval_);
-    }
-  }
-  if (buckets_.empty()) {
-    buckets_ = max_column->buckets_;
-    start_time_ = max_column->start_time_;
-    return;
-  }
-  if (max_column->buckets_.empty()) {
-    return;
-  }
-  if (max_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
-  }
+      (time_series.back().timestamp - start_time_) / bucket_interval_ + 1;
+  buckets_num_ = std::max(buckets_num_, needed_size);
 
-  auto max_column_time_range = max_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(max_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(max_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] =
-        std::max(buckets_[i], max_column->buckets_[i - intersection_start]);
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (max_column->start_time_ > cur_time_range.end) {
-    auto to_insert_min =
-        (max_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_min; ++i) {
-      buckets_.push_back(std::numeric_limits<double>::lowest());
+  std::array<double*, kAggregatesNum> data{};
+  ForEachAggregateOp([&]<typename Op>(Op) {
+    auto idx = static_cast<size_t>(Op::kType);
+    if (std::ranges::find(GetColumnTypes(), Op::kType) !=
+        GetColumnTypes().end()) {
+      auto& buckets = buckets_[idx].Mutable();
+      buckets.resize(buckets_num_, Op::kIdentity);
+      data[idx] = buckets.data();
     }
-  }
-
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(max_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
-  }
-}
+  });
 
-void MaxColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
-  }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
-  auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size, std::numeric_limits<double>::lowest());
   for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] = std::max(buckets_[idx], record.value);
+    auto idx = (record.timestamp - start_time_) / bucket_interval_;
+    ForEachAggregateOp([&]<typename Op>(Op) {
+      UpdateBuckets<Op>(data[static_cast<size_t>(Op::kType)], idx,
+                        record.value);
+    });
   }
 }
 
-ReadColumn MaxColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kMax);
-}
-
-std::vector<Value> MaxColumn::GetValues() const {
-  return column_.GetValues();
-}
-
-TimeRange MaxColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
-}
-
-Column MaxColumn::Extract() {
-  return column_.Extract(ColumnType::kMax);
-}
-
-CompressedBytes MaxColumn::ToBytes() const {
-  return column_.ToBytes();
-}
-
-size_t MaxColumn::GetBucketsNum() const {
-  return buckets_.size();
-}
-
-LastColumn::LastColumn(Duration bucket_interval)
-    : column_(bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-LastColumn::LastColumn(std::vector<double> buckets, const TimePoint& start_time,
-                       Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval),
-      buckets_(column_.buckets_),
-      start_time_(column_.start_time_),
-      bucket_interval_(column_.bucket_interval_) {}
-
-ColumnType LastColumn::GetType() const {
-  return ColumnType::kLast;
-}
-
-void LastColumn::ScaleBuckets(Duration bucket_interval) {
-  if (bucket_interval == bucket_interval_) {
-    return;
+ReadColumn MultiAggregateColumn::GetColumn(ColumnType column_type) const {
+  if (std::ranges::find(GetColumnTypes(), column_type) ==
+      GetColumnTypes().end()) {
+    return nullptr;
   }
-  assert(bucket_interval % bucket_interval_ == 0);
-  auto scale = bucket_interval / bucket_interval_;
-  auto new_buckets_sz = buckets_.size() / scale;
-  if (start_time_ % bucket_interval != 0 || buckets_.size() % scale != 0) {
-    ++new_buckets_sz;
-  }
-
-  double last = 0;
-  bool updated = false;
-  size_t pos = 0;
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    last = buckets_[i];
-    updated = true;
-    if ((start_time_ + bucket_interval_ * i) / bucket_interval !=
-        (start_time_ + bucket_interval_ * (i + 1)) / bucket_interval) {
-      buckets_[pos++] = last;
-      last = 0;
-      updated = false;
-    }
-  }
-
-  if (updated) {
-    buckets_[pos++] = last;
-  }
-
-  assert(pos == new_buckets_sz);
-
-  start_time_ = start_time_ - start_time_ % bucket_interval;
-  bucket_interval_ = bucket_interval;
-  buckets_.resize(new_buckets_sz);
+  return MakeAggregateColumn(column_type,
+                             buckets_[static_cast<size_t>(column_type)],
+                             start_time_, bucket_interval_);
 }
 
-void LastColumn::Merge(Column column) {
-  if (!column) {
-    return;
-  }
-  auto last_column = std::dynamic_pointer_cast<LastColumn>(column);
-  if (!last_column) {
-    throw std::runtime_error("Can't merge columns of different types");
-  }
-  if (this == last_column.get()) {
-    return;
-  }
-  if (last_column->bucket_interval_ != bucket_interval_) {
-    if (last_column->bucket_interval_ < bucket_interval_) {
-      last_column->ScaleBuckets(bucket_interval_);
-    } else {
-      ScaleBuckets(last_column->bucket_interval_);
-    }
+ReadColumn MultiAggregateColumn::ReadCopy(ColumnType column_type,
+                                          const TimeRange& time_range) const {
+  if (std::ranges::find(GetColumnTypes(), column_type) ==
+      GetColumnTypes().end()) {
+    return nullptr;
   }
-  if (buckets_.empty()) {
-    buckets_ = last_column->buckets_;
-    start_time_ = last_column->start_time_;
-    return;
-  }
-  if (last_column->buckets_.empty()) {
-    return;
-  }
-  if (last_column->start_time_ < start_time_) {
-    throw std::runtime_error("Wrong merge order");
-  }
-
-  auto last_column_time_range = last_column->GetTimeRange();
-  auto intersection_start_opt =
-      column_.GetBucketIdx(last_column_time_range.start);
-  auto intersection_end_opt = column_.GetBucketIdx(last_column_time_range.end);
-  auto intersection_end =
-      intersection_end_opt ? *intersection_end_opt : buckets_.size();
-  auto intersection_start =
-      intersection_end_opt ? *intersection_start_opt : buckets_.size();
-  for (size_t i = intersection_start; i < intersection_end; ++i) {
-    buckets_[i] = last_column->buckets_[i - intersection_start];
-  }
-
-  auto cur_time_range = GetTimeRange();
-  if (last_column->start_time_ > cur_time_range.end) {
-    auto to_insert_zeroes =
-        (last_column->start_time_ - cur_time_range.end) / bucket_interval_;
-    for (size_t i = 0; i < to_insert_zeroes; ++i) {
-      buckets_.push_back(0);
-    }
+  // slice shares buckets, only its window is copied
+  auto buckets = AggregatedBuckets(buckets_[static_cast<size_t>(column_type)],
+                                   start_time_, bucket_interval_)
+                     .Slice(time_range);
+  if (!buckets) {
+    return nullptr;
   }
+  return MakeAggregateColumn(
+      column_type, SharedBuffer<double>(buckets->GetValues()),
+      buckets->GetTimeRange().start, bucket_interval_);
+}
 
-  auto to_skip = intersection_start ? intersection_end - intersection_start : 0;
-  for (const auto& val : std::views::drop(last_column->buckets_, to_skip)) {
-    buckets_.push_back(val);
+Columns MultiAggregateColumn::GetColumns() const {
+  Columns res;
+  for (auto column_type : GetColumnTypes()) {
+    res.push_back(GetColumn(column_type));
   }
+  return res;
 }
 
-void LastColumn::Write(const InputTimeSeries& time_series) {
-  assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  if (buckets_.empty()) {
-    start_time_ = time_series.front().timestamp -
-                  time_series.front().timestamp % bucket_interval_;
-  }
-  assert(start_time_ % bucket_interval_ == 0);
-  assert(time_series.front().timestamp >= start_time_);
-  auto needed_size =
-      (time_series.back().timestamp + 1 - start_time_ + bucket_interval_ - 1) /
-      bucket_interval_;
-  buckets_.resize(needed_size);
-  for (const auto& record : time_series) {
-    auto idx = *column_.GetBucketIdx(record.timestamp);
-    buckets_[idx] = record.value;
+Columns MultiAggregateColumn::ExtractColumns() {
+  auto res = GetColumns();
+  for (auto column_type : GetColumnTypes()) {
+    buckets_[static_cast<size_t>(column_type)] = {};
   }
+  start_time_ = 0;
+  buckets_num_ = 0;
+  return res;
 }
 
-ReadColumn LastColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kLast);
+bool MultiAggregateColumn::Empty() const {
+  return buckets_num_ == 0;
 }
 
-std::vector<Value> LastColumn::GetValues() const {
-  return column_.GetValues();
+TimeRange MultiAggregateColumn::GetTimeRange() const {
+  return {start_time_, start_time_ + buckets_num_ * bucket_interval_};
 }
 
-TimeRange LastColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
+size_t MultiAggregateColumn::GetBucketsNum() const {
+  return buckets_num_;
 }
 
-Column LastColumn::Extract() {
-  return column_.Extract(ColumnType::kLast);
+size_t MultiAggregateColumn::GetColumnsNum() const {
+  return column_types_num_;
 }
 
-CompressedBytes LastColumn::ToBytes() const {
-  return column_.ToBytes();
+std::span<const ColumnType> MultiAggregateColumn::GetColumnTypes() const {
+  return {column_types_.data(), column_types_num_};
 }
 
-size_t LastColumn::GetBucketsNum() const {
-  return buckets_.size();
+RawTimestampsColumn::RawTimestampsColumn(SharedBuffer<TimePoint> timestamps)
+    : timestamps_(std::move(timestamps)) {
+  UpdateStep(0);
 }
 
-RawTimestampsColumn::RawTimestampsColumn(std::vector<TimePoint> timestamps)
-    : timestamps_(std::move(timestamps)) {}
+RawTimestampsColumn::RawTimestampsColumn(SharedBuffer<TimePoint> timestamps,
+                                         uint64_t step)
+    : timestamps_(std::move(timestamps)), step_(step) {}
 
 ColumnType RawTimestampsColumn::GetType() const {
   return ColumnType::kRawTimestamps;
@@ -915,7 +427,15 @@ ColumnType RawTimestampsColumn::GetType() const {
 
 CompressedBytes RawTimestampsColumn::ToBytes() const {
   CompressedBytes res;
-  Append(res, timestamps_.data(), timestamps_.size());
+  if (step_) {
+    AppendPageHeader(res, PageFormat::kRegular);
+    Append(res, timestamps_.empty() ? TimePoint{0} : timestamps_.front());
+    Append(res, *step_);
+    Append(res, timestamps_.size());
+    return res;
+  }
+  AppendPageHeader(res, PageFormat::kDeltaOfDelta);
+  EncodeDeltaOfDelta(res, timestamps_.View());
   return res;
 }
 
@@ -933,6 +453,7 @@ void RawTimestampsColumn::Merge(Column column) {
   }
   if (timestamps_.empty()) {
     timestamps_ = raw_timestamps_column->timestamps_;
+    step_ = raw_timestamps_column->step_;
     return;
   }
   if (raw_timestamps_column->timestamps_.empty()) {
@@ -941,27 +462,42 @@ void RawTimestampsColumn::Merge(Column column) {
   if (raw_timestamps_column->timestamps_.front() < timestamps_.back()) {
     throw std::runtime_error("Wrong merge order");
   }
-  timestamps_.insert(timestamps_.end(),
-                     raw_timestamps_column->timestamps_.begin(),
-                     raw_timestamps_column->timestamps_.end());
+  auto old_size = timestamps_.size();
+  auto& timestamps = timestamps_.Mutable();
+  timestamps.insert(timestamps.end(),
+                    raw_timestamps_column->timestamps_.begin(),
+                    raw_timestamps_column->timestamps_.end());
+  UpdateStep(old_size);
 }
 
 void RawTimestampsColumn::Write(const InputTimeSeries& time_series) {
   assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  timestamps_.reserve(timestamps_.size() + time_series.size());
+  auto old_size = timestamps_.size();
+  auto& timestamps = timestamps_.Mutable();
+  ReserveMore(timestamps, time_series.size());
   for (const auto& record : time_series) {
-    timestamps_.push_back(record.timestamp);
+    timestamps.push_back(record.timestamp);
   }
+  UpdateStep(old_size);
 }
 
 std::vector<Value> RawTimestampsColumn::GetValues() const {
   return {timestamps_.begin(), timestamps_.end()};
 }
 
+size_t RawTimestampsColumn::GetBytesSize() const {
+  return timestamps_.size() * sizeof(TimePoint);
+}
+
 Column RawTimestampsColumn::Extract() {
   auto timestamps = std::move(timestamps_);
   timestamps_ = {};
-  return std::make_shared<RawTimestampsColumn>(timestamps);
+  auto step = step_;
+  step_ = 0;
+  if (step) {
+    return std::make_shared<RawTimestampsColumn>(std::move(timestamps), *step);
+  }
+  return std::make_shared<RawTimestampsColumn>(std::move(timestamps));
 }
 
 TimeRange RawTimestampsColumn::GetTimeRange() const {
@@ -975,7 +511,40 @@ size_t RawTimestampsColumn::TimestampsNum() const {
   return timestamps_.size();
 }
 
-RawValuesColumn::RawValuesColumn(std::vector<Value> values)
+size_t RawTimestampsColumn::LowerBound(TimePoint timestamp) const {
+  if (!step_ || timestamps_.size() < 2) {
+    return std::lower_bound(timestamps_.begin(), timestamps_.end(),
+                            timestamp) -
+           timestamps_.begin();
+  }
+  auto start = timestamps_.front();
+  if (timestamp <= start) {
+    return 0;
+  }
+  if (*step_ == 0) {
+    return timestamps_.size();
+  }
+  return std::min(timestamps_.size(),
+                  (timestamp - start + *step_ - 1) / *step_);
+}
+
+void RawTimestampsColumn::UpdateStep(size_t from) {
+  if (from <= 1) {
+    step_ = timestamps_.size() >= 2 ? timestamps_[1] - timestamps_[0] : 0;
+    from = 2;
+  }
+  if (!step_) {
+    return;
+  }
+  for (size_t i = from; i < timestamps_.size(); ++i) {
+    if (timestamps_[i] - timestamps_[i - 1] != *step_) {
+      step_.reset();
+      return;
+    }
+  }
+}
+
+RawValuesColumn::RawValuesColumn(SharedBuffer<Value> values)
     : values_(std::move(values)) {}
 
 ColumnType RawValuesColumn::GetType() const {
@@ -984,7 +553,8 @@ ColumnType RawValuesColumn::GetType() const {
 
 CompressedBytes RawValuesColumn::ToBytes() const {
   CompressedBytes res;
-  Append(res, values_.data(), values_.size());
+  AppendPageHeader(res, PageFormat::kGorilla);
+  EncodeGorilla(res, values_.View());
   return res;
 }
 
@@ -1006,26 +576,32 @@ void RawValuesColumn::Merge(Column column) {
   if (raw_values_column->values_.empty()) {
     return;
   }
-  values_.insert(values_.end(), raw_values_column->values_.begin(),
-                 raw_values_column->values_.end());
+  auto& values = values_.Mutable();
+  values.insert(values.end(), raw_values_column->values_.begin(),
+                raw_values_column->values_.end());
 }
 
 void RawValuesColumn::Write(const InputTimeSeries& time_series) {
   assert(std::ranges::is_sorted(time_series, {}, &Record::timestamp));
-  values_.reserve(values_.size() + time_series.size());
+  auto& values = values_.Mutable();
+  ReserveMore(values, time_series.size());
   for (const auto& record : time_series) {
-    values_.push_back(record.value);
+    values.push_back(record.value);
   }
 }
 
 std::vector<Value> RawValuesColumn::GetValues() const {
-  return values_;
+  return values_.ToVector();
+}
+
+size_t RawValuesColumn::GetBytesSize() const {
+  return values_.size() * sizeof(Value);
 }
 
 Column RawValuesColumn::Extract() {
   auto values = std::move(values_);
   values_ = {};
-  return std::make_shared<RawValuesColumn>(values);
+  return std::make_shared<RawValuesColumn>(std::move(values));
 }
 
 size_t RawValuesColumn::ValuesNum() const {
@@ -1058,22 +634,38 @@ void ReadRawColumn::Merge(Column column) {
 }
 
 ReadColumn ReadRawColumn::Read(const TimeRange& time_range) const {
+  return Read(time_range, false);
+}
+
+ReadColumn ReadRawColumn::ReadCopy(const TimeRange& time_range) const {
+  return Read(time_range, true);
+}
+
+ReadColumn ReadRawColumn::Read(const TimeRange& time_range, bool copy) const {
   if (!timestamps_column_ || !values_column_) {
     return std::shared_ptr<ReadRawColumn>(nullptr);
   }
   auto& timestamps = timestamps_column_->timestamps_;
   auto& values = values_column_->values_;
-  auto start =
-      std::lower_bound(timestamps.begin(), timestamps.end(), time_range.start);
-  auto end = std::upper_bound(start, timestamps.end(), time_range.end - 1);
-  if (start == timestamps.end()) {
+  auto start = timestamps_column_->LowerBound(time_range.start);
+  auto end = std::max(start, timestamps_column_->LowerBound(time_range.end));
+  if (start == timestamps.size()) {
     return std::shared_ptr<ReadRawColumn>(nullptr);
   }
+  auto timestamps_slice = timestamps.Slice(start, end);
+  auto values_slice = values.Slice(start, end);
+  if (copy) {
+    timestamps_slice = timestamps_slice.Copy();
+    values_slice = values_slice.Copy();
+  }
+  auto timestamps_column =
+      timestamps_column_->step_
+          ? std::make_shared<RawTimestampsColumn>(std::move(timestamps_slice),
+                                                  *timestamps_column_->step_)
+          : std::make_shared<RawTimestampsColumn>(std::move(timestamps_slice));
   return std::make_shared<ReadRawColumn>(
-      std::make_shared<RawTimestampsColumn>(std::vector<TimePoint>(start, end)),
-      std::make_shared<RawValuesColumn>(
-          std::vector<Value>(values.begin() + (start - timestamps.begin()),
-                             values.begin() + (end - timestamps.begin()))));
+      std::move(timestamps_column),
+      std::make_shared<RawValuesColumn>(std::move(values_slice)));
 }
 
 void ReadRawColumn::Write(const InputTimeSeries& time_series) {
@@ -1094,6 +686,17 @@ std::vector<Value> ReadRawColumn::GetValues() const {
   return values_column_->GetValues();
 }
 
+size_t ReadRawColumn::GetBytesSize() const {
+  size_t bytes_size = 0;
+  if (timestamps_column_) {
+    bytes_size += timestamps_column_->GetBytesSize();
+  }
+  if (values_column_) {
+    bytes_size += values_column_->GetBytesSize();
+  }
+  return bytes_size;
+}
+
 TimeRange ReadRawColumn::GetTimeRange() const {
   return TimeRange{timestamps_column_->timestamps_.front(),
                    timestamps_column_->timestamps_.back() + 1};
@@ -1117,11 +720,14 @@ std::vector<TimePoint> ReadRawColumn::GetTimestamps() const {
   return {timestamps.begin(), timestamps.end()};
 }
 
-AvgColumn::AvgColumn(std::vector<double> buckets, const TimePoint& start_time,
+AvgColumn::AvgColumn(SharedBuffer<double> buckets, const TimePoint& start_time,
                      Duration bucket_interval)
-    : column_(std::move(buckets), start_time, bucket_interval) {}
+    : AggregatedBuckets(std::move(buckets), start_time, bucket_interval) {}
+
+AvgColumn::AvgColumn(AggregatedBuckets buckets)
+    : AggregatedBuckets(std::move(buckets)) {}
 
-AggregateColumn AvgColumn::CreateAvgAggregateColumn(
+AggregatedBuckets AvgColumn::CreateAvgBuckets(
     std::shared_ptr<SumColumn> sum_column,
     std::shared_ptr<CountColumn> count_column) {
   assert(sum_column && count_column);
@@ -1135,22 +741,26 @@ AggregateColumn AvgColumn::CreateAvgAggregateColumn(
         "Can't get avg of columns with different start "
         "times");
   }
-  std::vector<double> buckets;
-  for (size_t i = 0; i < sum_column->buckets_.size(); ++i) {
-    if (count_column->buckets_[i] == 0) {
-      buckets.push_back(0);
-    } else {
-      buckets.push_back(sum_column->buckets_[i] / count_column->buckets_[i]);
-    }
+  if (sum_column->buckets_.size() != count_column->buckets_.size()) {
+    throw std::runtime_error(
+        "Can't get avg of columns with different number of buckets");
   }
-  return {std::move(buckets), sum_column->start_time_,
+  // sums are divided in place, so there is a copy only if they are shared
+  auto sums = std::move(sum_column->buckets_);
+  sum_column->buckets_ = {};
+  auto& buckets = sums.Mutable();
+  auto counts = count_column->buckets_.View();
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    buckets[i] = counts[i] == 0 ? 0 : buckets[i] / counts[i];
+  }
+  return {std::move(sums), sum_column->start_time_,
           sum_column->bucket_interval_};
 }
 
 AvgColumn::AvgColumn(std::shared_ptr<SumColumn> sum_column,
                      std::shared_ptr<CountColumn> count_column)
-    : column_(CreateAvgAggregateColumn(std::move(sum_column),
-                                       std::move(count_column))) {}
+    : AggregatedBuckets(
+          CreateAvgBuckets(std::move(sum_column), std::move(count_column))) {}
 
 ColumnType AvgColumn::GetType() const {
   return ColumnType::kAvg;
@@ -1161,7 +771,11 @@ void AvgColumn::Merge(Column column) {
 }
 
 ReadColumn AvgColumn::Read(const TimeRange& time_range) const {
-  return column_.Read(time_range, ColumnType::kAvg);
+  auto buckets = Slice(time_range);
+  if (!buckets) {
+    return std::shared_ptr<AvgColumn>(nullptr);
+  }
+  return std::make_shared<AvgColumn>(std::move(*buckets));
 }
 
 void AvgColumn::Write(const InputTimeSeries& time_series) {
@@ -1169,15 +783,23 @@ void AvgColumn::Write(const InputTimeSeries& time_series) {
 }
 
 std::vector<Value> AvgColumn::GetValues() const {
-  return column_.GetValues();
+  return AggregatedBuckets::GetValues();
+}
+
+size_t AvgColumn::GetBytesSize() const {
+  return AggregatedBuckets::GetBytesSize();
 }
 
 TimeRange AvgColumn::GetTimeRange() const {
-  return column_.GetTimeRange();
+  return AggregatedBuckets::GetTimeRange();
 }
 
 Column AvgColumn::Extract() {
-  return column_.Extract(ColumnType::kAvg);
+  auto col = std::make_shared<AvgColumn>(std::move(buckets_), start_time_,
+                                         bucket_interval_);
+  buckets_ = {};
+  start_time_ = 0;
+  return col;
 }
 
 Column CreateRawColumn(ColumnType column_type) {
@@ -1214,41 +836,71 @@ Column CreateAggregatedColumn(ColumnType column_type,
   }
 }
 
-Column FromBytes(const CompressedBytes& bytes, ColumnType column_type) {
+Column FromBytes(std::span<const uint8_t> bytes, ColumnType column_type,
+                 const std::shared_ptr<const void>& owner) {
   switch (column_type) {
     case ColumnType::kRawValues: {
-      auto data = reinterpret_cast<const Value*>(bytes.data());
-      auto sz = bytes.size() / sizeof(Value);
-      return std::make_shared<RawValuesColumn>(
-          std::vector<Value>(data, data + sz));
+      switch (GetPageFormat(bytes)) {
+        case PageFormat::kPlain: {
+          return std::make_shared<RawValuesColumn>(
+              ToSharedBuffer<Value>(bytes, owner));
+        }
+        case PageFormat::kGorilla: {
+          return std::make_shared<RawValuesColumn>(DecodeGorilla(
+              std::span(bytes).subspan(kPageHeaderSize)));
+        }
+        default:
+          throw std::runtime_error("Unsupported raw values page format");
+      }
     }
     case ColumnType::kRawTimestamps: {
-      auto data = reinterpret_cast<const TimePoint*>(bytes.data());
-      auto sz = bytes.size() / sizeof(TimePoint);
-      return std::make_shared<RawTimestampsColumn>(
-          std::vector<TimePoint>(data, data + sz));
+      switch (GetPageFormat(bytes)) {
+        case PageFormat::kPlain: {
+          return std::make_shared<RawTimestampsColumn>(
+              ToSharedBuffer<TimePoint>(bytes, owner));
+        }
+        case PageFormat::kRegular: {
+          auto reader = CompressedBytesReader(bytes);
+          reader.Read<uint64_t>();
+          auto start = reader.Read<TimePoint>();
+          auto step = reader.Read<uint64_t>();
+          auto size = reader.Read<size_t>();
+          std::vector<TimePoint> timestamps(size);
+          for (size_t i = 0; i < size; ++i) {
+            timestamps[i] = start + i * step;
+          }
+          return std::make_shared<RawTimestampsColumn>(std::move(timestamps),
+                                                       step);
+        }
+        case PageFormat::kDeltaOfDelta: {
+          return std::make_shared<RawTimestampsColumn>(DecodeDeltaOfDelta(
+              std::span(bytes).subspan(kPageHeaderSize)));
+        }
+        default:
+          throw std::runtime_error("Unsupported raw timestamps page format");
+      }
     }
     case ColumnType::kSum: {
-      return AggregateFromBytes<SumColumn>(bytes);
+      return AggregateFromBytes<SumColumn>(bytes, owner);
     }
     case ColumnType::kCount: {
-      return AggregateFromBytes<CountColumn>(bytes);
+      return AggregateFromBytes<CountColumn>(bytes, owner);
     }
     case ColumnType::kMin: {
-      return AggregateFromBytes<MinColumn>(bytes);
+      return AggregateFromBytes<MinColumn>(bytes, owner);
     }
     case ColumnType::kMax: {
-      return AggregateFromBytes<MaxColumn>(bytes);
+      return AggregateFromBytes<MaxColumn>(bytes, owner);
     }
     case ColumnType::kLast: {
-      return AggregateFromBytes<LastColumn>(bytes);
+      return AggregateFromBytes<LastColumn>(bytes, owner);
     }
     default:
       throw std::runtime_error("Unsupported column type");
   }
 }
 
-CompressedBytesReader::CompressedBytesReader(const CompressedBytes& bytes)
+CompressedBytesReader::CompressedBytesReader(std::span<const uint8_t> bytes)
     : bytes_(bytes) {}
 
 }  // namespace tskv
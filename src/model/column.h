@@ -1,16 +1,24 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
 #include <vector>
+#include "compression.h"
+#include "kernels.h"
 #include "model.h"
+#include "shared_buffer.h"
 
 namespace tskv {
 
-using CompressedBytes = std::vector<uint8_t>;
-
 template <typename T>
 void Append(CompressedBytes& bytes, const T& value) {
   auto begin = reinterpret_cast<const uint8_t*>(&value);
@@ -26,35 +34,51 @@ void Append(CompressedBytes& bytes, T* value, size_t size) {
 }
 
 struct CompressedBytesReader {
-  explicit CompressedBytesReader(const CompressedBytes& bytes);
+  explicit CompressedBytesReader(std::span<const uint8_t> bytes);
 
   template <typename T>
   T Read() {
     assert(offset_ + sizeof(T) <= bytes_.size());
-    auto begin = bytes_.begin() + offset_;
-    auto end = begin + sizeof(T);
-    offset_ += sizeof(T);
     T value;
-    std::copy(begin, end, reinterpret_cast<uint8_t*>(&value));
+    std::memcpy(&value, bytes_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
     return value;
   }
 
   template <typename T>
   std::vector<T> ReadAll() {
-    auto begin = bytes_.begin() + offset_;
-    auto end = bytes_.end();
-    offset_ += (end - begin);
-    std::vector<T> values;
-    values.insert(values.end(), reinterpret_cast<const T*>(&*begin),
-                  reinterpret_cast<const T*>(&*end));
+    auto rest = ReadRest();
+    std::vector<T> values(rest.size() / sizeof(T));
+    std::memcpy(values.data(), rest.data(), values.size() * sizeof(T));
     return values;
   }
 
+  std::span<const uint8_t> ReadRest() {
+    auto rest = bytes_.subspan(offset_);
+    offset_ = bytes_.size();
+    return rest;
+  }
+
  private:
-  const CompressedBytes& bytes_;
+  std::span<const uint8_t> bytes_;
   size_t offset_{0};
 };
 
+// returns buffer over the bytes without copying them, if owner keeps them
+// alive and they are aligned
+template <typename T>
+SharedBuffer<T> ToSharedBuffer(std::span<const uint8_t> bytes,
+                               const std::shared_ptr<const void>& owner) {
+  auto size = bytes.size() / sizeof(T);
+  if (owner &&
+      reinterpret_cast<uintptr_t>(bytes.data()) % alignof(T) == 0) {
+    return {owner, {reinterpret_cast<const T*>(bytes.data()), size}};
+  }
+  std::vector<T> values(size);
+  std::memcpy(values.data(), bytes.data(), size * sizeof(T));
+  return values;
+}
+
 struct Record;
 using InputTimeSeries = std::vector<Record>;
 
@@ -72,10 +96,9 @@ enum class ColumnType {
   kAvg,
 };
 
-// I think, that Column should stores data vector with offsets and lengths, so
-// that we don't need to copy data in some cases
-//
-// But for now I implement it in a simple way
+// Columns store data in SharedBuffer, so that Read returns columns, that share
+// data with the column they were read from. Data is copied only when such
+// column is changed (e.g. by Merge or ScaleBuckets)
 class IColumn {
  protected:
   using Column = std::shared_ptr<IColumn>;
@@ -85,6 +108,9 @@ class IColumn {
   virtual void Merge(Column column) = 0;
   virtual void Write(const InputTimeSeries& time_series) = 0;
   virtual std::vector<Value> GetValues() const = 0;
+  // bytes of decoded data, that the column keeps in memory. Shared data is
+  // counted by every column sharing it
+  virtual size_t GetBytesSize() const = 0;
   // extracts data from column and clears it
   // returns new column with extracted data
   virtual Column Extract() = 0;
@@ -113,28 +139,25 @@ class IAggregateColumn : public ISerializableColumn, public IReadColumn {
   virtual size_t GetBucketsNum() const = 0;
 };
 
-class AggregateColumn {
+// Buckets of aggregated columns, i-th bucket holds aggregation of records with
+// timestamps in [start_time + i * bucket_interval,
+// start_time + (i + 1) * bucket_interval)
+class AggregatedBuckets {
  public:
-  explicit AggregateColumn(Duration bucket_interval);
-  AggregateColumn(std::vector<double> buckets, const TimePoint& start_time,
-                  Duration bucket_interval);
-  ReadColumn Read(const TimeRange& time_range, ColumnType column_type) const;
+  explicit AggregatedBuckets(Duration bucket_interval);
+  AggregatedBuckets(SharedBuffer<double> buckets, const TimePoint& start_time,
+                    Duration bucket_interval);
+  // returns buckets, that intersect with time_range, they share data with this
+  std::optional<AggregatedBuckets> Slice(const TimeRange& time_range) const;
   std::vector<Value> GetValues() const;
   TimeRange GetTimeRange() const;
-  Column Extract(ColumnType column_type);
   CompressedBytes ToBytes() const;
+  size_t GetBytesSize() const;
 
-  std::optional<size_t> GetBucketIdx(TimePoint timestamp) const;
+  size_t GetBucketIdx(TimePoint timestamp) const;
 
-  friend class SumColumn;
-  friend class CountColumn;
-  friend class MinColumn;
-  friend class MaxColumn;
-  friend class LastColumn;
-  friend class AvgColumn;
-
- private:
-  std::vector<double> buckets_;
+ protected:
+  SharedBuffer<double> buckets_;
   TimePoint start_time_{};
   Duration bucket_interval_;
 };
@@ -143,159 +166,191 @@ using SerializableColumn = std::shared_ptr<ISerializableColumn>;
 using Columns = std::vector<Column>;
 using SerializableColumns = std::vector<SerializableColumn>;
 
-class SumColumn : public IAggregateColumn {
- public:
-  explicit SumColumn(Duration bucket_interval);
-  SumColumn(std::vector<double> buckets, const TimePoint& start_time,
-            Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
-
-  friend class AvgColumn;
+// Aggregation policies for AggregateColumn:
+//  kIdentity - value of empty bucket
+//  kReduce - how buckets are merged (see kernels.h), older one goes first
+//  Update - adds record value to the bucket. Kernels merge buckets with
+//  Update and kIdentity of SumOp, MinOp and MaxOp too
+struct SumOp {
+  static constexpr ColumnType kType = ColumnType::kSum;
+  static constexpr double kIdentity = 0;
+  static constexpr ReduceKind kReduce = ReduceKind::kSum;
+  static double Update(double bucket, Value value) { return bucket + value; }
+};
 
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
+struct CountOp {
+  static constexpr ColumnType kType = ColumnType::kCount;
+  static constexpr double kIdentity = 0;
+  static constexpr ReduceKind kReduce = ReduceKind::kSum;
+  static double Update(double bucket, Value) { return bucket + 1; }
 };
 
-class CountColumn : public IAggregateColumn {
- public:
-  explicit CountColumn(Duration bucket_interval);
-  CountColumn(std::vector<double> buckets, const TimePoint& start_time,
-              Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
+struct MinOp {
+  static constexpr ColumnType kType = ColumnType::kMin;
+  static constexpr double kIdentity = std::numeric_limits<double>::max();
+  static constexpr ReduceKind kReduce = ReduceKind::kMin;
+  static double Update(double bucket, Value value) {
+    return std::min(bucket, value);
+  }
+};
 
-  friend class AvgColumn;
+struct MaxOp {
+  static constexpr ColumnType kType = ColumnType::kMax;
+  static constexpr double kIdentity = std::numeric_limits<double>::lowest();
+  static constexpr ReduceKind kReduce = ReduceKind::kMax;
+  static double Update(double bucket, Value value) {
+    return std::max(bucket, value);
+  }
+};
 
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
+struct LastOp {
+  static constexpr ColumnType kType = ColumnType::kLast;
+  static constexpr double kIdentity = 0;
+  static constexpr ReduceKind kReduce = ReduceKind::kLast;
+  static double Update(double, Value value) { return value; }
 };
 
-class MinColumn : public IAggregateColumn {
+// aggregate policies in the order of their types, the only place where types
+// are mapped to policies
+using AggregateOps = std::tuple<SumOp, CountOp, MinOp, MaxOp, LastOp>;
+
+static_assert(std::tuple_size_v<AggregateOps> ==
+              static_cast<size_t>(ColumnType::kLast) + 1);
+static_assert([]<size_t... Is>(std::index_sequence<Is...>) {
+  return ((std::tuple_element_t<Is, AggregateOps>::kType ==
+           static_cast<ColumnType>(Is)) &&
+          ...);
+}(std::make_index_sequence<std::tuple_size_v<AggregateOps>>{}));
+
+// calls visitor(Op{}) for every aggregate policy
+template <typename Visitor>
+void ForEachAggregateOp(Visitor&& visitor) {
+  std::apply([&visitor](auto... ops) { (visitor(ops), ...); }, AggregateOps{});
+}
+
+template <typename Op>
+class AggregateColumn : public IAggregateColumn,
+                        protected AggregatedBuckets {
  public:
-  explicit MinColumn(Duration bucket_interval);
-  MinColumn(std::vector<double> buckets, const TimePoint& start_time,
-            Duration bucket_interval);
+  explicit AggregateColumn(Duration bucket_interval);
+  AggregateColumn(SharedBuffer<double> buckets, const TimePoint& start_time,
+                  Duration bucket_interval);
+  explicit AggregateColumn(AggregatedBuckets buckets);
   ColumnType GetType() const override;
   void ScaleBuckets(Duration bucket_interval) override;
   void Merge(Column column) override;
   void Write(const InputTimeSeries& time_series) override;
   ReadColumn Read(const TimeRange& time_range) const override;
   std::vector<Value> GetValues() const override;
+  size_t GetBytesSize() const override;
   TimeRange GetTimeRange() const override;
   Column Extract() override;
   CompressedBytes ToBytes() const override;
   size_t GetBucketsNum() const override;
 
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
+  friend class AvgColumn;
 };
 
-class MaxColumn : public IAggregateColumn {
+extern template class AggregateColumn<SumOp>;
+extern template class AggregateColumn<CountOp>;
+extern template class AggregateColumn<MinOp>;
+extern template class AggregateColumn<MaxOp>;
+extern template class AggregateColumn<LastOp>;
+
+using SumColumn = AggregateColumn<SumOp>;
+using CountColumn = AggregateColumn<CountOp>;
+using MinColumn = AggregateColumn<MinOp>;
+using MaxColumn = AggregateColumn<MaxOp>;
+using LastColumn = AggregateColumn<LastOp>;
+
+// All aggregates of a metric with the same buckets layout. Each aggregate is
+// stored in its own array, but all of them are updated in one pass over the
+// written time series. Readers get usual per type columns, that share data
+// with this one.
+class MultiAggregateColumn {
  public:
-  explicit MaxColumn(Duration bucket_interval);
-  MaxColumn(std::vector<double> buckets, const TimePoint& start_time,
-            Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
+  // column_types must be aggregate types (kSum, ..., kLast)
+  MultiAggregateColumn(const std::vector<ColumnType>& column_types,
+                       Duration bucket_interval);
+  void Write(const InputTimeSeries& time_series);
+  // returns nullptr if column_type isn't stored
+  ReadColumn GetColumn(ColumnType column_type) const;
+  // buckets of the column, that intersect with time_range, copied instead of
+  // shared, as Write would copy all buckets, while they are shared. Returns
+  // nullptr if column_type isn't stored or there are no such buckets
+  ReadColumn ReadCopy(ColumnType column_type,
+                      const TimeRange& time_range) const;
+  // per type columns sharing data with this one
+  Columns GetColumns() const;
+  // extracts data into per type columns and clears this one
+  Columns ExtractColumns();
+  bool Empty() const;
+  TimeRange GetTimeRange() const;
+  size_t GetBucketsNum() const;
+  size_t GetColumnsNum() const;
 
  private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
-};
+  static constexpr size_t kAggregatesNum = std::tuple_size_v<AggregateOps>;
 
-class LastColumn : public IAggregateColumn {
- public:
-  explicit LastColumn(Duration bucket_interval);
-  LastColumn(std::vector<double> buckets, const TimePoint& start_time,
-             Duration bucket_interval);
-  ColumnType GetType() const override;
-  void ScaleBuckets(Duration bucket_interval) override;
-  void Merge(Column column) override;
-  void Write(const InputTimeSeries& time_series) override;
-  ReadColumn Read(const TimeRange& time_range) const override;
-  std::vector<Value> GetValues() const override;
-  TimeRange GetTimeRange() const override;
-  Column Extract() override;
-  CompressedBytes ToBytes() const override;
-  size_t GetBucketsNum() const override;
+  std::span<const ColumnType> GetColumnTypes() const;
 
- private:
-  AggregateColumn column_;
-  std::vector<double>& buckets_;
-  TimePoint& start_time_;
-  Duration& bucket_interval_;
+  // inline, as every memtable has them. Each type is stored once
+  std::array<ColumnType, kAggregatesNum> column_types_{};
+  size_t column_types_num_{0};
+  // indexed by ColumnType
+  std::array<SharedBuffer<double>, kAggregatesNum> buckets_;
+  TimePoint start_time_{};
+  Duration bucket_interval_;
+  size_t buckets_num_{0};
 };
 
 class RawTimestampsColumn : public ISerializableColumn {
  public:
   friend class ReadRawColumn;
   RawTimestampsColumn() = default;
-  explicit RawTimestampsColumn(std::vector<TimePoint> timestamps);
+  explicit RawTimestampsColumn(SharedBuffer<TimePoint> timestamps);
+  // caller guarantees, that timestamps are start + i * step
+  RawTimestampsColumn(SharedBuffer<TimePoint> timestamps, uint64_t step);
   ColumnType GetType() const override;
   CompressedBytes ToBytes() const override;
   void Merge(Column column) override;
   void Write(const InputTimeSeries& time_series) override;
   // not the best way to return timestamps, but I didn't want to break the interface
   std::vector<Value> GetValues() const override;
+  size_t GetBytesSize() const override;
   Column Extract() override;
   TimeRange GetTimeRange() const;
   size_t TimestampsNum() const;
+  // index of the first timestamp >= `timestamp`, for regular columns it's
+  // computed without binary search
+  size_t LowerBound(TimePoint timestamp) const;
 
  private:
-  std::vector<TimePoint> timestamps_;
+  // checks that timestamps starting from `from` keep the column regular
+  void UpdateStep(size_t from);
+
+ private:
+  SharedBuffer<TimePoint> timestamps_;
+  // set if timestamps are start + i * step
+  std::optional<uint64_t> step_{0};
 };
 
 class RawValuesColumn : public ISerializableColumn {
  public:
   friend class ReadRawColumn;
   RawValuesColumn() = default;
-  explicit RawValuesColumn(std::vector<Value> values);
+  explicit RawValuesColumn(SharedBuffer<Value> values);
   ColumnType GetType() const override;
   CompressedBytes ToBytes() const override;
   void Merge(Column column) override;
   void Write(const InputTimeSeries& time_series) override;
   std::vector<Value> GetValues() const override;
+  size_t GetBytesSize() const override;
   Column Extract() override;
   size_t ValuesNum() const;
 
  private:
-  std::vector<Value> values_;
+  SharedBuffer<Value> values_;
 };
 
 class ReadRawColumn : public IReadColumn {
@@ -306,22 +361,30 @@ class ReadRawColumn : public IReadColumn {
   ColumnType GetType() const override;
   void Merge(Column column) override;
   ReadColumn Read(const TimeRange& time_range) const override;
+  // same as Read, but copies the data, see MultiAggregateColumn::ReadCopy
+  ReadColumn ReadCopy(const TimeRange& time_range) const;
   void Write(const InputTimeSeries& time_series) override;
   std::vector<Value> GetValues() const override;
+  size_t GetBytesSize() const override;
   TimeRange GetTimeRange() const override;
   Column Extract() override;
 
   std::vector<TimePoint> GetTimestamps() const;
 
+ private:
+  ReadColumn Read(const TimeRange& time_range, bool copy) const;
+
  private:
   std::shared_ptr<RawTimestampsColumn> timestamps_column_;
   std::shared_ptr<RawValuesColumn> values_column_;
 };
 
-class AvgColumn : public IReadColumn {
+class AvgColumn : public IReadColumn, protected AggregatedBuckets {
  public:
-  AvgColumn(std::vector<double> buckets, const TimePoint& start_time,
+  AvgColumn(SharedBuffer<double> buckets, const TimePoint& start_time,
             Duration bucket_interval);
+  explicit AvgColumn(AggregatedBuckets buckets);
+  // takes buckets of sum_column, it's left empty
   AvgColumn(std::shared_ptr<SumColumn> sum_column,
             std::shared_ptr<CountColumn> count_column);
   ColumnType GetType() const override;
@@ -329,16 +392,14 @@ class AvgColumn : public IReadColumn {
   ReadColumn Read(const TimeRange& time_range) const override;
   void Write(const InputTimeSeries& time_series) override;
   std::vector<Value> GetValues() const override;
+  size_t GetBytesSize() const override;
   TimeRange GetTimeRange() const override;
   Column Extract() override;
 
  private:
-  static AggregateColumn CreateAvgAggregateColumn(
+  static AggregatedBuckets CreateAvgBuckets(
       std::shared_ptr<SumColumn> sum_column,
       std::shared_ptr<CountColumn> count_column);
-
- private:
-  AggregateColumn column_;
 };
 
 template <typename T>
@@ -356,16 +417,20 @@ Column CreateAggregatedColumn(ColumnType column_type, Duration bucket_interval);
 Column CreateRawColumn(ColumnType column_type);
 
 template <typename T>
-Column AggregateFromBytes(const CompressedBytes& bytes) {
+Column AggregateFromBytes(std::span<const uint8_t> bytes,
+                          const std::shared_ptr<const void>& owner) {
   auto reader = CompressedBytesReader(bytes);
   auto bucket_interval = reader.Read<size_t>();
   auto start = reader.Read<TimePoint>();
-  auto buckets = reader.ReadAll<Value>();
-  auto col = std::make_shared<T>(buckets, start, bucket_interval);
+  auto buckets = ToSharedBuffer<Value>(reader.ReadRest(), owner);
+  auto col = std::make_shared<T>(std::move(buckets), start, bucket_interval);
   auto read_column = std::static_pointer_cast<IReadColumn>(col);
   return std::static_pointer_cast<IColumn>(read_column);
 }
 
-Column FromBytes(const CompressedBytes& bytes, ColumnType column_type);
+// columns are views over bytes, if owner keeps them alive, otherwise they
+// are copied
+Column FromBytes(std::span<const uint8_t> bytes, ColumnType column_type,
+                 const std::shared_ptr<const void>& owner = nullptr);
 
 }  // namespace tskv
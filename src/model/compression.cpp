@@ -0,0 +1,272 @@
+#include "compression.h"
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace tskv {
+
+namespace {
+
+uint64_t LowBitsMask(size_t bits_num) {
+  return bits_num == 64 ? ~0ull : (1ull << bits_num) - 1;
+}
+
+uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// (prefix, prefix length, payload length) of delta-of-delta buckets
+struct DeltaOfDeltaBucket {
+  uint64_t prefix;
+  size_t prefix_bits;
+  size_t value_bits;
+};
+
+constexpr DeltaOfDeltaBucket kDeltaOfDeltaBuckets[] = {
+    {0b10, 2, 7},
+    {0b110, 3, 12},
+    {0b1110, 4, 20},
+    {0b1111, 4, 64},
+};
+
+}  // namespace
+
+void AppendPageHeader(CompressedBytes& bytes, PageFormat format) {
+  uint64_t header = kPageMagic | static_cast<uint8_t>(format);
+  auto begin = reinterpret_cast<const uint8_t*>(&header);
+  bytes.insert(bytes.end(), begin, begin + sizeof(header));
+}
+
+PageFormat GetPageFormat(std::span<const uint8_t> bytes) {
+  if (bytes.size() < kPageHeaderSize) {
+    return PageFormat::kPlain;
+  }
+  uint64_t header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if ((header & kPageMagicMask) != kPageMagic) {
+    return PageFormat::kPlain;
+  }
+  return static_cast<PageFormat>(header & ~kPageMagicMask);
+}
+
+BitWriter::BitWriter(CompressedBytes& bytes) : bytes_(bytes) {}
+
+void BitWriter::Write(uint64_t value, size_t bits_num) {
+  assert(bits_num <= 64);
+  while (bits_num > 0) {
+    auto take = std::min(bits_num, 64 - buffer_bits_);
+    auto chunk = (value >> (bits_num - take)) & LowBitsMask(take);
+    buffer_ = take == 64 ? chunk : (buffer_ << take) | chunk;
+    buffer_bits_ += take;
+    bits_num -= take;
+    if (buffer_bits_ == 64) {
+      for (int shift = 56; shift >= 0; shift -= 8) {
+        bytes_.push_back(static_cast<uint8_t>(buffer_ >> shift));
+      }
+      buffer_ = 0;
+      buffer_bits_ = 0;
+    }
+  }
+}
+
+void BitWriter::WriteBit(bool bit) {
+  Write(bit ? 1 : 0, 1);
+}
+
+void BitWriter::Flush() {
+  if (buffer_bits_ == 0) {
+    return;
+  }
+  auto aligned = buffer_ << (64 - buffer_bits_);
+  for (size_t i = 0; i < (buffer_bits_ + 7) / 8; ++i) {
+    bytes_.push_back(static_cast<uint8_t>(aligned >> (56 - 8 * i)));
+  }
+  buffer_ = 0;
+  buffer_bits_ = 0;
+}
+
+BitReader::BitReader(std::span<const uint8_t> bytes) : bytes_(bytes) {}
+
+uint64_t BitReader::Read(size_t bits_num) {
+  assert(bits_num <= 64);
+  uint64_t result = 0;
+  while (bits_num > 0) {
+    if (buffer_bits_ == 0) {
+      if (offset_ + sizeof(uint64_t) <= bytes_.size()) {
+        uint64_t word;
+        std::memcpy(&word, bytes_.data() + offset_, sizeof(word));
+        buffer_ = std::byteswap(word);
+        buffer_bits_ = 64;
+        offset_ += sizeof(uint64_t);
+      } else if (offset_ < bytes_.size()) {
+        buffer_ = bytes_[offset_++];
+        buffer_bits_ = 8;
+      } else {
+        throw std::runtime_error("Unexpected end of bit stream");
+      }
+    }
+    auto take = std::min(bits_num, buffer_bits_);
+    auto chunk = (buffer_ >> (buffer_bits_ - take)) & LowBitsMask(take);
+    result = take == 64 ? chunk : (result << take) | chunk;
+    buffer_bits_ -= take;
+    bits_num -= take;
+  }
+  return result;
+}
+
+bool BitReader::ReadBit() {
+  return Read(1) != 0;
+}
+
+void EncodeGorilla(CompressedBytes& bytes, std::span<const Value> values) {
+  BitWriter writer(bytes);
+  writer.Write(values.size(), 64);
+  if (values.empty()) {
+    writer.Flush();
+    return;
+  }
+  auto prev = std::bit_cast<uint64_t>(values[0]);
+  writer.Write(prev, 64);
+  // 64 means that there is no previous window yet
+  int prev_leading = 64;
+  int prev_trailing = 0;
+  for (size_t i = 1; i < values.size(); ++i) {
+    auto cur = std::bit_cast<uint64_t>(values[i]);
+    auto xored = cur ^ prev;
+    prev = cur;
+    if (xored == 0) {
+      writer.WriteBit(false);
+      continue;
+    }
+    writer.WriteBit(true);
+    // leading zeroes are stored in 5 bits
+    int leading = std::min(std::countl_zero(xored), 31);
+    int trailing = std::countr_zero(xored);
+    if (prev_leading != 64 && leading >= prev_leading &&
+        trailing >= prev_trailing) {
+      writer.WriteBit(false);
+      writer.Write(xored >> prev_trailing, 64 - prev_leading - prev_trailing);
+      continue;
+    }
+    writer.WriteBit(true);
+    auto meaningful = 64 - leading - trailing;
+    writer.Write(leading, 5);
+    // meaningful is in [1, 64], so store it minus one in 6 bits
+    writer.Write(meaningful - 1, 6);
+    writer.Write(xored >> trailing, meaningful);
+    prev_leading = leading;
+    prev_trailing = trailing;
+  }
+  writer.Flush();
+}
+
+std::vector<Value> DecodeGorilla(std::span<const uint8_t> bytes) {
+  BitReader reader(bytes);
+  auto size = reader.Read(64);
+  std::vector<Value> values;
+  if (size == 0) {
+    return values;
+  }
+  values.reserve(size);
+  auto prev = reader.Read(64);
+  values.push_back(std::bit_cast<Value>(prev));
+  int prev_leading = 0;
+  int prev_trailing = 0;
+  for (size_t i = 1; i < size; ++i) {
+    if (reader.ReadBit()) {
+      if (reader.ReadBit()) {
+        prev_leading = static_cast<int>(reader.Read(5));
+        auto meaningful = static_cast<int>(reader.Read(6)) + 1;
+        prev_trailing = 64 - prev_leading - meaningful;
+      }
+      auto meaningful = 64 - prev_leading - prev_trailing;
+      prev ^= reader.Read(meaningful) << prev_trailing;
+    }
+    values.push_back(std::bit_cast<Value>(prev));
+  }
+  return values;
+}
+
+void EncodeDeltaOfDelta(CompressedBytes& bytes,
+                        std::span<const TimePoint> timestamps) {
+  BitWriter writer(bytes);
+  writer.Write(timestamps.size(), 64);
+  if (timestamps.empty()) {
+    writer.Flush();
+    return;
+  }
+  writer.Write(timestamps[0], 64);
+  // unsigned arithmetic to wrap around instead of overflow
+  uint64_t prev_delta = 0;
+  for (size_t i = 1; i < timestamps.size(); ++i) {
+    auto delta = timestamps[i] - timestamps[i - 1];
+    auto encoded = ZigZagEncode(static_cast<int64_t>(delta - prev_delta));
+    prev_delta = delta;
+    if (encoded == 0) {
+      writer.WriteBit(false);
+      continue;
+    }
+    for (const auto& bucket : kDeltaOfDeltaBuckets) {
+      if (bucket.value_bits == 64 || encoded < (1ull << bucket.value_bits)) {
+        writer.Write(bucket.prefix, bucket.prefix_bits);
+        writer.Write(encoded, bucket.value_bits);
+        break;
+      }
+    }
+  }
+  writer.Flush();
+}
+
+std::vector<TimePoint> DecodeDeltaOfDelta(std::span<const uint8_t> bytes) {
+  BitReader reader(bytes);
+  auto size = reader.Read(64);
+  std::vector<TimePoint> timestamps;
+  if (size == 0) {
+    return timestamps;
+  }
+  timestamps.reserve(size);
+  timestamps.push_back(reader.Read(64));
+  uint64_t delta = 0;
+  for (size_t i = 1; i < size; ++i) {
+    if (reader.ReadBit()) {
+      size_t ones = 1;
+      while (ones < 4 && reader.ReadBit()) {
+        ++ones;
+      }
+      const auto& bucket = kDeltaOfDeltaBuckets[ones - 1];
+      delta += static_cast<uint64_t>(
+          ZigZagDecode(reader.Read(bucket.value_bits)));
+    }
+    timestamps.push_back(timestamps.back() + delta);
+  }
+  return timestamps;
+}
+
+uint32_t Crc32(std::span<const uint8_t> bytes, uint32_t crc) {
+  static const auto kTable = [] {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; ++j) {
+        crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320u : 0);
+      }
+      table[i] = crc;
+    }
+    return table;
+  }();
+  crc ^= 0xffffffffu;
+  for (auto byte : bytes) {
+    crc = kTable[(crc ^ byte) & 0xff] ^ (crc >> 8);
+  }
+  return crc ^ 0xffffffffu;
+}
+
+}  // namespace tskv
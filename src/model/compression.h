@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "model.h"
+
+namespace tskv {
+
+using CompressedBytes = std::vector<uint8_t>;
+
+// Pages written before compression was added have no header at all, so the
+// header starts with a signalling NaN bit pattern, that can't be the first
+// value (or timestamp) of an old plain page. Low byte stores the format.
+constexpr uint64_t kPageMagic = 0x7ff4'7473'6b76'0000ull;
+constexpr uint64_t kPageMagicMask = 0xffff'ffff'ffff'ff00ull;
+
+enum class PageFormat : uint8_t {
+  kPlain = 0,
+  kGorilla = 1,
+  kDeltaOfDelta = 2,
+  // (start, step, count) for perfectly regular timestamps
+  kRegular = 3,
+};
+
+void AppendPageHeader(CompressedBytes& bytes, PageFormat format);
+// returns kPlain for pages without header
+PageFormat GetPageFormat(std::span<const uint8_t> bytes);
+constexpr size_t kPageHeaderSize = sizeof(uint64_t);
+
+class BitWriter {
+ public:
+  explicit BitWriter(CompressedBytes& bytes);
+  // writes lower `bits_num` bits of `value`, bits_num <= 64
+  void Write(uint64_t value, size_t bits_num);
+  void WriteBit(bool bit);
+  // pads the last byte with zeroes
+  void Flush();
+
+ private:
+  CompressedBytes& bytes_;
+  uint64_t buffer_{0};
+  size_t buffer_bits_{0};
+};
+
+class BitReader {
+ public:
+  explicit BitReader(std::span<const uint8_t> bytes);
+  uint64_t Read(size_t bits_num);
+  bool ReadBit();
+
+ private:
+  std::span<const uint8_t> bytes_;
+  size_t offset_{0};
+  uint64_t buffer_{0};
+  size_t buffer_bits_{0};
+};
+
+// Gorilla XOR float compression, see
+// http://www.vldb.org/pvldb/vol8/p1816-teller.pdf (4.1.2)
+void EncodeGorilla(CompressedBytes& bytes, std::span<const Value> values);
+std::vector<Value> DecodeGorilla(std::span<const uint8_t> bytes);
+
+// Delta-of-delta timestamps compression, like in Gorilla (4.1.1), but with
+// zigzag encoded deltas and wider buckets, because we store microseconds
+void EncodeDeltaOfDelta(CompressedBytes& bytes,
+                        std::span<const TimePoint> timestamps);
+std::vector<TimePoint> DecodeDeltaOfDelta(std::span<const uint8_t> bytes);
+
+// crc32 (IEEE), to check files written not by us, like WAL and manifests.
+// Crc of concatenated bytes is Crc32(second, Crc32(first))
+uint32_t Crc32(std::span<const uint8_t> bytes, uint32_t crc = 0);
+
+}  // namespace tskv
@@ -0,0 +1,239 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "column.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TSKV_HAS_AVX2_KERNELS
+#endif
+
+namespace tskv {
+
+namespace {
+
+// scalar reductions use the aggregate policies of the column types, that are
+// merged with them
+template <typename Op>
+double ReduceScalar(const double* in, size_t size) {
+  double acc = Op::kIdentity;
+  for (size_t i = 0; i < size; ++i) {
+    acc = Op::Update(acc, in[i]);
+  }
+  return acc;
+}
+
+template <typename Op>
+void CombineScalar(double* dst, const double* src, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = Op::Update(dst[i], src[i]);
+  }
+}
+
+// windows boundaries are computed once, instead of a division per bucket
+template <typename ReduceWindow>
+size_t ForEachWindow(std::span<const double> in, size_t head, size_t stride,
+                     double* out, ReduceWindow reduce) {
+  assert(head > 0 && stride > 0);
+  size_t written = 0;
+  size_t pos = 0;
+  auto len = std::min(head, in.size());
+  while (pos < in.size()) {
+    out[written++] = reduce(in.data() + pos, len);
+    pos += len;
+    len = std::min(stride, in.size() - pos);
+  }
+  return written;
+}
+
+template <typename Op>
+size_t ReduceStridedScalarImpl(std::span<const double> in, size_t head,
+                               size_t stride, double* out) {
+  return ForEachWindow(in, head, stride, out,
+                       [](const double* data, size_t size) {
+                         return ReduceScalar<Op>(data, size);
+                       });
+}
+
+size_t ReduceLast(std::span<const double> in, size_t head, size_t stride,
+                  double* out) {
+  return ForEachWindow(
+      in, head, stride, out,
+      [](const double* data, size_t size) { return data[size - 1]; });
+}
+
+#ifdef TSKV_HAS_AVX2_KERNELS
+
+struct SumAvx2 {
+  using Scalar = SumOp;
+  __attribute__((target("avx2"))) static __m256d Apply(__m256d lhs,
+                                                       __m256d rhs) {
+    return _mm256_add_pd(lhs, rhs);
+  }
+};
+
+// argument order matches std::min/std::max, so results are the same as in
+// scalar version unless there are NaNs
+struct MinAvx2 {
+  using Scalar = MinOp;
+  __attribute__((target("avx2"))) static __m256d Apply(__m256d lhs,
+                                                       __m256d rhs) {
+    return _mm256_min_pd(rhs, lhs);
+  }
+};
+
+struct MaxAvx2 {
+  using Scalar = MaxOp;
+  __attribute__((target("avx2"))) static __m256d Apply(__m256d lhs,
+                                                       __m256d rhs) {
+    return _mm256_max_pd(rhs, lhs);
+  }
+};
+
+template <typename Kernel>
+__attribute__((target("avx2"))) double ReduceAvx2(const double* in,
+                                                  size_t size) {
+  using Scalar = typename Kernel::Scalar;
+  if (size < 8) {
+    return ReduceScalar<Scalar>(in, size);
+  }
+  // two accumulators to hide the latency of add/min/max
+  auto acc0 = _mm256_set1_pd(Scalar::kIdentity);
+  auto acc1 = acc0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    acc0 = Kernel::Apply(acc0, _mm256_loadu_pd(in + i));
+    acc1 = Kernel::Apply(acc1, _mm256_loadu_pd(in + i + 4));
+  }
+  if (i + 4 <= size) {
+    acc0 = Kernel::Apply(acc0, _mm256_loadu_pd(in + i));
+    i += 4;
+  }
+  acc0 = Kernel::Apply(acc0, acc1);
+  alignas(32) double lanes[4];
+  _mm256_store_pd(lanes, acc0);
+  double acc = Scalar::Update(Scalar::Update(lanes[0], lanes[1]),
+                              Scalar::Update(lanes[2], lanes[3]));
+  for (; i < size; ++i) {
+    acc = Scalar::Update(acc, in[i]);
+  }
+  return acc;
+}
+
+// same as ForEachWindow, but without lambda, so that ReduceAvx2 is inlined
+template <typename Kernel>
+__attribute__((target("avx2"))) size_t ReduceStridedAvx2(
+    std::span<const double> in, size_t head, size_t stride, double* out) {
+  assert(head > 0 && stride > 0);
+  size_t written = 0;
+  size_t pos = 0;
+  auto len = std::min(head, in.size());
+  while (pos < in.size()) {
+    out[written++] = ReduceAvx2<Kernel>(in.data() + pos, len);
+    pos += len;
+    len = std::min(stride, in.size() - pos);
+  }
+  return written;
+}
+
+template <typename Kernel>
+__attribute__((target("avx2"))) void CombineAvx2(double* dst, const double* src,
+                                                 size_t size) {
+  size_t i = 0;
+  for (; i + 4 <= size; i += 4) {
+    auto res =
+        Kernel::Apply(_mm256_loadu_pd(dst + i), _mm256_loadu_pd(src + i));
+    _mm256_storeu_pd(dst + i, res);
+  }
+  CombineScalar<typename Kernel::Scalar>(dst + i, src + i, size - i);
+}
+
+bool HasAvx2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+
+#else
+
+bool HasAvx2() {
+  return false;
+}
+
+#endif
+
+}  // namespace
+
+size_t ReduceStridedScalar(ReduceKind kind, std::span<const double> in,
+                           size_t head, size_t stride, double* out) {
+  switch (kind) {
+    case ReduceKind::kSum:
+      return ReduceStridedScalarImpl<SumOp>(in, head, stride, out);
+    case ReduceKind::kMin:
+      return ReduceStridedScalarImpl<MinOp>(in, head, stride, out);
+    case ReduceKind::kMax:
+      return ReduceStridedScalarImpl<MaxOp>(in, head, stride, out);
+    case ReduceKind::kLast:
+      return ReduceLast(in, head, stride, out);
+  }
+  assert(false);
+  return 0;
+}
+
+void CombineIntoScalar(ReduceKind kind, double* dst,
+                       std::span<const double> src) {
+  switch (kind) {
+    case ReduceKind::kSum:
+      return CombineScalar<SumOp>(dst, src.data(), src.size());
+    case ReduceKind::kMin:
+      return CombineScalar<MinOp>(dst, src.data(), src.size());
+    case ReduceKind::kMax:
+      return CombineScalar<MaxOp>(dst, src.data(), src.size());
+    case ReduceKind::kLast:
+      if (!src.empty()) {
+        std::memmove(dst, src.data(), src.size_bytes());
+      }
+      return;
+  }
+}
+
+size_t ReduceStrided(ReduceKind kind, std::span<const double> in, size_t head,
+                     size_t stride, double* out) {
+#ifdef TSKV_HAS_AVX2_KERNELS
+  if (HasAvx2()) {
+    switch (kind) {
+      case ReduceKind::kSum:
+        return ReduceStridedAvx2<SumAvx2>(in, head, stride, out);
+      case ReduceKind::kMin:
+        return ReduceStridedAvx2<MinAvx2>(in, head, stride, out);
+      case ReduceKind::kMax:
+        return ReduceStridedAvx2<MaxAvx2>(in, head, stride, out);
+      case ReduceKind::kLast:
+        break;
+    }
+  }
+#endif
+  return ReduceStridedScalar(kind, in, head, stride, out);
+}
+
+void CombineInto(ReduceKind kind, double* dst, std::span<const double> src) {
+#ifdef TSKV_HAS_AVX2_KERNELS
+  if (HasAvx2()) {
+    switch (kind) {
+      case ReduceKind::kSum:
+        return CombineAvx2<SumAvx2>(dst, src.data(), src.size());
+      case ReduceKind::kMin:
+        return CombineAvx2<MinAvx2>(dst, src.data(), src.size());
+      case ReduceKind::kMax:
+        return CombineAvx2<MaxAvx2>(dst, src.data(), src.size());
+      case ReduceKind::kLast:
+        break;
+    }
+  }
+#endif
+  CombineIntoScalar(kind, dst, src);
+}
+
+}  // namespace tskv
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+
+namespace tskv {
+
+// Reductions used by aggregated columns. Dispatched to AVX2 versions when the
+// CPU supports them, otherwise plain loops are used.
+enum class ReduceKind {
+  kSum,
+  kMin,
+  kMax,
+  kLast,
+};
+
+// Reduces windows [0, head), [head, head + stride), ... of `in` into out[0],
+// out[1], ... The last window may be shorter than stride. Returns number of
+// written values, out must have space for them.
+size_t ReduceStrided(ReduceKind kind, std::span<const double> in, size_t head,
+                     size_t stride, double* out);
+
+// dst[i] = combine(dst[i], src[i])
+void CombineInto(ReduceKind kind, double* dst, std::span<const double> src);
+
+// scalar versions, exposed for tests and benchmarks
+size_t ReduceStridedScalar(ReduceKind kind, std::span<const double> in,
+                           size_t head, size_t stride, double* out);
+void CombineIntoScalar(ReduceKind kind, double* dst,
+                       std::span<const double> src);
+
+}  // namespace tskv
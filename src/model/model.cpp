@@ -46,3 +46,11 @@ tskv::TimeRange tskv::TimeRange::Merge(const TimeRange& other) const {
   }
   return {std::min(start, other.start), std::max(end, other.end)};
 }
+
+bool tskv::TimeRange::Empty() const {
+  return start >= end;
+}
+
+bool tskv::TimeRange::Overlaps(const TimeRange& other) const {
+  return start < other.end && other.start < end;
+}
@@ -11,6 +11,9 @@ namespace tskv {
 
 using TimePoint = uint64_t;
 using Value = double;
+using MetricId = uint64_t;
+// log sequence number, position of the record in WAL, starts from 1
+using Lsn = uint64_t;
 
 class Duration {
  public:
@@ -42,6 +45,10 @@ struct TimeRange {
   Duration GetDuration() const;
 
   TimeRange Merge(const TimeRange& other) const;
+
+  bool Empty() const;
+
+  bool Overlaps(const TimeRange& other) const;
 };
 
 struct Record {
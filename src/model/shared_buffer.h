@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace tskv {
+
+// Window [offset, offset + size) over a vector, that can be shared between
+// columns. Reads return columns pointing into the same vector, and the data is
+// copied only when one of them needs to change it (copy on write).
+//
+// Buffer can also be a view over memory of some other owner (like memory
+// mapped page), it's kept alive by the buffer and is never changed.
+//
+// All changes must go through Mutable().
+template <typename T>
+class SharedBuffer {
+ public:
+  SharedBuffer() = default;
+
+  SharedBuffer(std::vector<T> data)
+      : data_(std::make_shared<std::vector<T>>(std::move(data))) {}
+
+  SharedBuffer(std::shared_ptr<const void> owner, std::span<const T> view)
+      : owner_(std::move(owner)),
+        view_(view.data()),
+        size_(view.size()),
+        whole_(false) {}
+
+  size_t size() const {
+    if (view_) {
+      return size_;
+    }
+    if (!data_) {
+      return 0;
+    }
+    return whole_ ? data_->size() : size_;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  const T* data() const {
+    if (view_) {
+      return view_ + offset_;
+    }
+    return data_ ? data_->data() + offset_ : nullptr;
+  }
+
+  const T* begin() const { return data(); }
+
+  const T* end() const { return data() + size(); }
+
+  const T& operator[](size_t idx) const {
+    assert(idx < size());
+    return data()[idx];
+  }
+
+  const T& front() const { return (*this)[0]; }
+
+  const T& back() const { return (*this)[size() - 1]; }
+
+  std::span<const T> View() const { return {data(), size()}; }
+
+  // returns buffer, that shares the data with this one
+  SharedBuffer Slice(size_t begin, size_t end) const {
+    assert(begin <= end && end <= size());
+    SharedBuffer res;
+    res.data_ = data_;
+    res.owner_ = owner_;
+    res.view_ = view_;
+    res.offset_ = offset_ + begin;
+    res.size_ = end - begin;
+    res.whole_ = false;
+    return res;
+  }
+
+  // returns buffer, that owns a copy of this window. Readers of data, that
+  // keeps changing, take it, so that the next change doesn't copy all of it
+  SharedBuffer Copy() const { return SharedBuffer(ToVector()); }
+
+  // returns vector, that is owned only by this buffer, copies data if it's
+  // shared, if it's a view or if the buffer is a window over a bigger vector
+  std::vector<T>& Mutable() {
+    if (view_) {
+      data_ = std::make_shared<std::vector<T>>(begin(), end());
+      owner_.reset();
+      view_ = nullptr;
+    } else if (!data_) {
+      data_ = std::make_shared<std::vector<T>>();
+    } else if (data_.use_count() != 1) {
+      data_ = std::make_shared<std::vector<T>>(begin(), end());
+    } else {
+      // use_count() is a relaxed load, so the last reader, that has just
+      // dropped the data in another thread, could still be ordered after our
+      // writes. Dropping a copy does the acq_rel decrement, that orders them
+      std::shared_ptr<std::vector<T>>(data_).reset();
+      if (!whole_) {
+        data_->resize(offset_ + size_);
+        data_->erase(data_->begin(), data_->begin() + offset_);
+      }
+    }
+    offset_ = 0;
+    size_ = 0;
+    whole_ = true;
+    return *data_;
+  }
+
+  std::vector<T> ToVector() const { return {begin(), end()}; }
+
+ private:
+  std::shared_ptr<std::vector<T>> data_;
+  // used instead of data_ for views
+  std::shared_ptr<const void> owner_;
+  const T* view_{nullptr};
+  size_t offset_{0};
+  // used only for windows, otherwise size of the vector is used, so that it
+  // stays correct after changes made through Mutable()
+  size_t size_{0};
+  bool whole_{true};
+};
+
+}  // namespace tskv
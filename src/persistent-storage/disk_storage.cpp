@@ -1,5 +1,10 @@
 #include "disk_storage.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -13,6 +18,13 @@ DiskStorage::DiskStorage(const Options& options) : path_(options.path) {
   if (!std::filesystem::exists(path_)) {
     std::filesystem::create_directories(path_);
   }
+  if (options.io_uring) {
+    try {
+      ring_ = std::make_unique<IoUring>();
+    } catch (const std::runtime_error&) {
+      // batches fall back to reading files one by one
+    }
+  }
 }
 
 DiskStorage::Metadata DiskStorage::GetMetadata() const {
@@ -51,8 +63,9 @@ CompressedBytes DiskStorage::Read(const PageId& page_id) {
   if (!in) {
     throw std::runtime_error("file not found");
   }
-  CompressedBytes content = {(std::istreambuf_iterator<char>(in)),
-                             std::istreambuf_iterator<char>()};
+  CompressedBytes content(std::filesystem::file_size(path_ / page_id));
+  in.read(reinterpret_cast<char*>(content.data()), content.size());
+  content.resize(in.gcount());
   return content;
 }
 
@@ -62,9 +75,148 @@ void DiskStorage::Write(const PageId& page_id, const CompressedBytes& bytes) {
     throw std::runtime_error("file not found");
   }
   out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  std::lock_guard lock(unsynced_mutex_);
+  unsynced_pages_.insert(page_id);
 }
 
 void DiskStorage::DeletePage(const PageId& page_id) {
   std::filesystem::remove(path_ / page_id);
 }
+
+void DiskStorage::Sync() {
+  std::unordered_set<PageId> pages;
+  {
+    std::lock_guard lock(unsynced_mutex_);
+    pages.swap(unsynced_pages_);
+  }
+  auto sync = [&](const std::filesystem::path& path, int flags) {
+    int fd = ::open(path.c_str(), flags | O_CLOEXEC);
+    // deleted pages don't have to be durable
+    if (fd < 0 && errno == ENOENT) {
+      return;
+    }
+    if (fd < 0 || ::fsync(fd) != 0) {
+      auto error = std::string(std::strerror(errno));
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      {
+        // pages are synced by the next call
+        std::lock_guard lock(unsynced_mutex_);
+        unsynced_pages_.insert(pages.begin(), pages.end());
+      }
+      throw std::runtime_error("sync of " + path.string() +
+                               " failed: " + error);
+    }
+    ::close(fd);
+  };
+  for (const auto& page_id : pages) {
+    sync(path_ / page_id, O_RDONLY);
+  }
+  // new page files are durable only with their directory entries
+  if (!pages.empty()) {
+    sync(path_, O_RDONLY | O_DIRECTORY);
+  }
+}
+
+std::vector<PageBytes> DiskStorage::ReadMany(
+    std::span<const PageId> page_ids) {
+  if (!ring_) {
+    return IPersistentStorage::ReadMany(page_ids);
+  }
+  std::vector<int> fds;
+  std::vector<std::shared_ptr<CompressedBytes>> pages;
+  std::vector<iovec> iov(page_ids.size());
+  std::vector<IoUring::Request> requests;
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    int fd = ::open((path_ / page_ids[i]).c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat file_stat;
+    if (fd < 0 || ::fstat(fd, &file_stat) != 0) {
+      for (int opened : fds) {
+        ::close(opened);
+      }
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      throw std::runtime_error("file not found");
+    }
+    fds.push_back(fd);
+    pages.push_back(std::make_shared<CompressedBytes>(file_stat.st_size));
+    iov[i] = {pages.back()->data(), pages.back()->size()};
+    requests.push_back({.op = IoUring::Op::kRead,
+                        .fd = fd,
+                        .iov = &iov[i],
+                        .iov_num = 1});
+  }
+  Submit(requests, fds);
+
+  std::vector<PageBytes> result;
+  result.reserve(pages.size());
+  for (size_t i = 0; i < pages.size(); ++i) {
+    // page could be cut by a concurrent write
+    pages[i]->resize(requests[i].result);
+    result.push_back({pages[i], *pages[i]});
+  }
+  return result;
+}
+
+void DiskStorage::WriteMany(std::span<const PageId> page_ids,
+                            std::span<const CompressedBytes> pages) {
+  if (!ring_) {
+    IPersistentStorage::WriteMany(page_ids, pages);
+    return;
+  }
+  std::vector<int> fds;
+  std::vector<iovec> iov(page_ids.size());
+  std::vector<IoUring::Request> requests;
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    int fd = ::open((path_ / page_ids[i]).c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      for (int opened : fds) {
+        ::close(opened);
+      }
+      throw std::runtime_error("file not found");
+    }
+    fds.push_back(fd);
+    iov[i] = {const_cast<uint8_t*>(pages[i].data()), pages[i].size()};
+    requests.push_back({.op = IoUring::Op::kWrite,
+                        .fd = fd,
+                        .iov = &iov[i],
+                        .iov_num = 1});
+  }
+  Submit(requests, fds);
+  {
+    std::lock_guard lock(unsynced_mutex_);
+    unsynced_pages_.insert(page_ids.begin(), page_ids.end());
+  }
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (static_cast<size_t>(requests[i].result) != pages[i].size()) {
+      // short writes are rare, the page is just rewritten
+      Write(page_ids[i], pages[i]);
+    }
+  }
+}
+
+void DiskStorage::Submit(std::span<IoUring::Request> requests,
+                         std::span<const int> fds) {
+  try {
+    ring_->Submit(requests);
+  } catch (...) {
+    for (int fd : fds) {
+      ::close(fd);
+    }
+    throw;
+  }
+  for (int fd : fds) {
+    ::close(fd);
+  }
+  for (const auto& request : requests) {
+    if (request.result < 0) {
+      throw std::runtime_error(
+          std::string("page I/O failed: ") +
+          std::strerror(static_cast<int>(-request.result)));
+    }
+  }
+}
 }  // namespace tskv
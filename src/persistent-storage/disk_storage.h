@@ -1,7 +1,11 @@
 #pragma once
 
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 
+#include "io_uring.h"
 #include "persistent_storage.h"
 
 namespace tskv {
@@ -10,6 +14,8 @@ class DiskStorage : public IPersistentStorage {
  public:
   struct Options {
     std::string path;
+    // batched reads and writes are sent with one io_uring submission
+    bool io_uring{false};
   };
 
  public:
@@ -19,10 +25,23 @@ class DiskStorage : public IPersistentStorage {
   CompressedBytes Read(const PageId& page_id) override;
   void Write(const PageId& page_id, const CompressedBytes& bytes) override;
   void DeletePage(const PageId& page_id) override;
+  // syncs pages written since the last sync and the directory with them
+  void Sync() override;
+  std::vector<PageBytes> ReadMany(std::span<const PageId> page_ids) override;
+  void WriteMany(std::span<const PageId> page_ids,
+                 std::span<const CompressedBytes> pages) override;
   static std::string GeneratePageId();
 
+ private:
+  // files are opened one by one, their reads or writes are sent together
+  void Submit(std::span<IoUring::Request> requests, std::span<const int> fds);
+
  private:
   std::filesystem::path path_;
+  // null if io_uring isn't used
+  std::unique_ptr<IoUring> ring_;
+  std::mutex unsynced_mutex_;
+  std::unordered_set<PageId> unsynced_pages_;
 };
 
 }  // namespace tskv
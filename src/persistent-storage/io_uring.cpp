@@ -0,0 +1,247 @@
+#include "io_uring.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+namespace tskv {
+
+namespace {
+
+int Setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int Enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+  return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+void* MapRing(int fd, size_t size, uint64_t offset) {
+  auto* ring = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, offset);
+  if (ring == MAP_FAILED) {
+    throw std::runtime_error(std::string("can't map io_uring: ") +
+                             std::strerror(errno));
+  }
+  return ring;
+}
+
+template <typename T>
+T* At(void* base, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+
+// ring indexes are shared with the kernel
+unsigned LoadAcquire(unsigned* value) {
+  return std::atomic_ref(*value).load(std::memory_order_acquire);
+}
+
+void StoreRelease(unsigned* value, unsigned new_value) {
+  std::atomic_ref(*value).store(new_value, std::memory_order_release);
+}
+
+}  // namespace
+
+IoUring::IoUring(unsigned entries) {
+  io_uring_params params{};
+  fd_ = Setup(entries, &params);
+  if (fd_ < 0) {
+    throw std::runtime_error(std::string("io_uring isn't supported: ") +
+                             std::strerror(errno));
+  }
+  entries_ = params.sq_entries;
+
+  try {
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = MapRing(fd_, sq_ring_size_, IORING_OFF_SQ_RING);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+      cq_ring_ = sq_ring_;
+    } else {
+      cq_ring_ = MapRing(fd_, cq_ring_size_, IORING_OFF_CQ_RING);
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = MapRing(fd_, sqes_size_, IORING_OFF_SQES);
+  } catch (...) {
+    Close();
+    throw;
+  }
+
+  sq_tail_ = At<unsigned>(sq_ring_, params.sq_off.tail);
+  sq_mask_ = *At<unsigned>(sq_ring_, params.sq_off.ring_mask);
+  sq_array_ = At<unsigned>(sq_ring_, params.sq_off.array);
+  cq_head_ = At<unsigned>(cq_ring_, params.cq_off.head);
+  cq_tail_ = At<unsigned>(cq_ring_, params.cq_off.tail);
+  cq_mask_ = *At<unsigned>(cq_ring_, params.cq_off.ring_mask);
+  cqes_ = At<io_uring_cqe>(cq_ring_, params.cq_off.cqes);
+
+  slots_.resize(entries_);
+  for (uint64_t slot = entries_; slot > 0; --slot) {
+    free_slots_.push_back(slot - 1);
+  }
+}
+
+IoUring::~IoUring() {
+  Close();
+}
+
+void IoUring::Close() {
+  if (sqes_) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ && cq_ring_ != sq_ring_) {
+    ::munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_) {
+    ::munmap(sq_ring_, sq_ring_size_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  sqes_ = cq_ring_ = sq_ring_ = nullptr;
+  fd_ = -1;
+}
+
+void IoUring::Submit(std::span<Request> requests) {
+  Call call;
+  std::exception_ptr error;
+  std::unique_lock lock(mutex_);
+  while (true) {
+    // the waiting caller needs a completion in the ring to return from
+    // io_uring_enter, so only it reaps them, until it's back
+    if (!waiting_) {
+      ReapCompletions();
+    }
+    while (!error && call.submitted < requests.size() &&
+           !free_slots_.empty()) {
+      try {
+        SubmitRequests(
+            requests.subspan(call.submitted,
+                             std::min(free_slots_.size(),
+                                      requests.size() - call.submitted)),
+            call);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    // submitted requests use buffers of the caller, so they are waited for
+    // even after an error
+    if (call.completed == call.submitted &&
+        (error || call.submitted == requests.size())) {
+      break;
+    }
+    if (waiting_) {
+      completed_.wait(lock);
+      continue;
+    }
+
+    // waits for any completion, there are requests in flight: of this call or
+    // of others, that take all slots
+    waiting_ = true;
+    lock.unlock();
+    // errors like EINTR are retried, as completions are checked anyway
+    Enter(fd_, 0, 1, IORING_ENTER_GETEVENTS);
+    lock.lock();
+    waiting_ = false;
+    // one of the others waits next
+    completed_.notify_all();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void IoUring::SubmitRequests(std::span<Request> requests, Call& call) {
+  auto* sqes = static_cast<io_uring_sqe*>(sqes_);
+  auto tail = *sq_tail_;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    auto& request = requests[i];
+    auto slot = free_slots_.back();
+    free_slots_.pop_back();
+    slots_[slot] = {&request, &call};
+
+    auto index = (tail + i) & sq_mask_;
+    auto& sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.fd = request.fd;
+    sqe.user_data = slot;
+    switch (request.op) {
+      case Op::kRead:
+        sqe.opcode = IORING_OP_READV;
+        break;
+      case Op::kWrite:
+        sqe.opcode = IORING_OP_WRITEV;
+        break;
+      case Op::kSync:
+        sqe.opcode = IORING_OP_FSYNC;
+        sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+        break;
+    }
+    if (request.op != Op::kSync) {
+      sqe.addr = reinterpret_cast<uint64_t>(request.iov);
+      sqe.len = static_cast<uint32_t>(request.iov_num);
+      sqe.off = request.offset;
+    }
+    sq_array_[index] = index;
+  }
+  StoreRelease(sq_tail_, tail + requests.size());
+
+  // completions are waited for by Submit, so only submits here
+  size_t submitted = 0;
+  while (submitted < requests.size()) {
+    auto entered = Enter(fd_, requests.size() - submitted, 0, 0);
+    if (entered < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      auto error = errno;
+      // the rest isn't taken by the kernel, the ring has no other requests
+      // after them, as they're submitted under the lock
+      StoreRelease(sq_tail_, tail + submitted);
+      for (size_t i = submitted; i < requests.size(); ++i) {
+        auto slot = sqes[(tail + i) & sq_mask_].user_data;
+        slots_[slot] = {};
+        free_slots_.push_back(slot);
+      }
+      call.submitted += submitted;
+      throw std::runtime_error(std::string("io_uring_enter failed: ") +
+                               std::strerror(error));
+    }
+    submitted += entered;
+  }
+  call.submitted += submitted;
+}
+
+void IoUring::ReapCompletions() {
+  auto head = *cq_head_;
+  auto cq_tail = LoadAcquire(cq_tail_);
+  if (head == cq_tail) {
+    return;
+  }
+  for (; head != cq_tail; ++head) {
+    const auto& cqe = static_cast<io_uring_cqe*>(cqes_)[head & cq_mask_];
+    auto& slot = slots_[cqe.user_data];
+    slot.request->result = cqe.res;
+    ++slot.call->completed;
+    slot = {};
+    free_slots_.push_back(cqe.user_data);
+  }
+  StoreRelease(cq_head_, head);
+  completed_.notify_all();
+}
+
+}  // namespace tskv
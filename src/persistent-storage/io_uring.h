@@ -0,0 +1,100 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace tskv {
+
+// Minimal io_uring wrapper over raw syscalls (there is no liburing in our
+// build). Requests of one Submit call are sent with one io_uring_enter, so
+// a batch of page reads costs one syscall instead of one per page.
+//
+// Thread safe, concurrent Submit calls share the ring. Every request in flight
+// takes a slot, that tags its completion, so completions of other calls are
+// handed to them. One of the waiting callers waits for completions without the
+// lock and only it reaps them meanwhile, the others wait for it.
+class IoUring {
+ public:
+  enum class Op {
+    kRead,
+    kWrite,
+    // fdatasync
+    kSync,
+  };
+
+  struct Request {
+    Op op;
+    int fd;
+    const iovec* iov{nullptr};
+    size_t iov_num{0};
+    uint64_t offset{0};
+    // bytes read or written, or -errno
+    int64_t result{0};
+  };
+
+ public:
+  // throws if io_uring isn't supported, e.g. by old kernels or seccomp
+  explicit IoUring(unsigned entries = 256);
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+  ~IoUring();
+
+  // waits for all requests, results are written to them. If requests can't
+  // be submitted, waits for the submitted ones and throws
+  void Submit(std::span<Request> requests);
+
+ private:
+  struct Call {
+    size_t submitted{0};
+    size_t completed{0};
+  };
+
+  struct Slot {
+    Request* request{nullptr};
+    Call* call{nullptr};
+  };
+
+ private:
+  // submits requests with free slots, must be called under mutex_
+  void SubmitRequests(std::span<Request> requests, Call& call);
+  // hands completions to their calls, must be called under mutex_
+  void ReapCompletions();
+  void Close();
+
+ private:
+  int fd_{-1};
+  unsigned entries_{0};
+
+  void* sq_ring_{nullptr};
+  size_t sq_ring_size_{0};
+  void* cq_ring_{nullptr};
+  size_t cq_ring_size_{0};
+  void* sqes_{nullptr};
+  size_t sqes_size_{0};
+
+  unsigned* sq_tail_{nullptr};
+  unsigned sq_mask_{0};
+  unsigned* sq_array_{nullptr};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  unsigned cq_mask_{0};
+  void* cqes_{nullptr};
+
+  // guards the rings and slots
+  std::mutex mutex_;
+  std::condition_variable completed_;
+  // at most entries_ requests are in flight, so completions always fit into
+  // the completion ring
+  std::vector<Slot> slots_;
+  std::vector<uint64_t> free_slots_;
+  // one caller waits in io_uring_enter at a time
+  bool waiting_{false};
+};
+
+}  // namespace tskv
@@ -2,13 +2,24 @@
 
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 #include "model/column.h"
 
 namespace tskv {
 
 using PageId = std::string;
 
+// page bytes, that stay valid while owner is alive
+struct PageBytes {
+  std::shared_ptr<const void> owner;
+  std::span<const uint8_t> bytes;
+  // owner is much larger than the page (e.g. a mapped segment), so columns,
+  // that are kept long, copy bytes instead of keeping the owner alive
+  bool shared_owner{false};
+};
+
 class IPersistentStorage {
  public:
   struct Metadata {};
@@ -19,8 +30,40 @@ class IPersistentStorage {
   virtual Metadata GetMetadata() const = 0;
   virtual PageId CreatePage() = 0;
   virtual CompressedBytes Read(const PageId& page_id) = 0;
+  // columns read from these bytes don't copy them, so storages can return
+  // views over memory mapped files here
+  virtual PageBytes ReadShared(const PageId& page_id) {
+    auto bytes = std::make_shared<const CompressedBytes>(Read(page_id));
+    return {bytes, *bytes};
+  }
   virtual void Write(const PageId& page_id, const CompressedBytes& bytes) = 0;
   virtual void DeletePage(const PageId& page_id) = 0;
+  // makes all written pages durable. Must be called before anything durable
+  // (manifest, WAL truncation) relies on them
+  virtual void Sync() = 0;
+
+  // batched versions, storages can read or write all pages with one
+  // submission. Default ones call single page methods
+  virtual std::vector<PageBytes> ReadMany(std::span<const PageId> page_ids) {
+    std::vector<PageBytes> pages;
+    pages.reserve(page_ids.size());
+    for (const auto& page_id : page_ids) {
+      pages.push_back(ReadShared(page_id));
+    }
+    return pages;
+  }
+  // pages[i] is written to page_ids[i]
+  virtual void WriteMany(std::span<const PageId> page_ids,
+                         std::span<const CompressedBytes> pages) {
+    for (size_t i = 0; i < page_ids.size(); ++i) {
+      Write(page_ids[i], pages[i]);
+    }
+  }
+  virtual void DeleteMany(std::span<const PageId> page_ids) {
+    for (const auto& page_id : page_ids) {
+      DeletePage(page_id);
+    }
+  }
 };
 
 }  // namespace tskv
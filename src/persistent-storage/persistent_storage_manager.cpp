@@ -1,44 +1,292 @@
 #include "persistent_storage_manager.h"
 
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <utility>
+
+#include "manifest/manifest.h"
 #include "model/column.h"
 
 namespace tskv {
 
-PersistentStorageManager::PersistentStorageManager(const Options& options) {
-  for (size_t i = 0; i < options.levels.size(); ++i) {
-    levels_.emplace_back(options.levels[i], options.storage);
-  }
+PersistentStorageManager::PersistentStorageManager(const Options& options)
+    : PersistentStorageManager(std::make_shared<const Options>(options),
+                               options.manifest_path) {}
+
+PersistentStorageManager::PersistentStorageManager(
+    std::shared_ptr<const Options> options,
+    std::optional<std::string> manifest_path)
+    : options_(std::move(options)),
+      manifest_path_(std::move(manifest_path)),
+      compaction_task_(options_->executor, [this] { Compact(); }) {
+  RestoreManifest();
 }
 
 void PersistentStorageManager::Write(const SerializableColumns& columns) {
-  for (const auto& column : columns) {
-    levels_.front().Write(column);
+  CommitWrite(PrepareWrite(columns));
+  AfterCommit();
+}
+
+Level::PreparedWrite PersistentStorageManager::PrepareWrite(
+    const SerializableColumns& columns) {
+  compaction_task_.RethrowError();
+  WaitForPendingSegments();
+  {
+    std::unique_lock lock(levels_mutex_);
+    CreateLevels();
+  }
+  // pages are written by the level without changing it, so no lock is needed
+  return levels_.front().PrepareWrite(columns);
+}
+
+Level::PreparedWrite PersistentStorageManager::PrepareWrite(
+    const SerializableColumns& columns, Level::PageWrites& writes) {
+  compaction_task_.RethrowError();
+  WaitForPendingSegments();
+  {
+    std::unique_lock lock(levels_mutex_);
+    CreateLevels();
   }
+  return levels_.front().PrepareWrite(columns, writes);
+}
+
+void PersistentStorageManager::CommitWrite(
+    const Level::PreparedWrite& prepared, Lsn flushed_lsn) {
+  // only appends new segments, so it doesn't wait for the merge of levels to
+  // finish, just for its short phases
+  std::unique_lock lock(levels_mutex_);
+  levels_.front().CommitWrite(prepared);
+  flushed_lsn_ = std::max(flushed_lsn_, flushed_lsn);
+  if (levels_.size() > 1 && levels_.front().NeedMerge()) {
+    ++pending_segments_;
+  }
+}
 
+void PersistentStorageManager::AfterCommit(bool save_manifest) {
+  if (save_manifest) {
+    SaveManifest();
+  }
   MergeLevels();
 }
 
+void PersistentStorageManager::WaitForCompaction() {
+  compaction_task_.Wait();
+}
+
+Lsn PersistentStorageManager::GetFlushedLsn() const {
+  std::shared_lock lock(levels_mutex_);
+  return flushed_lsn_;
+}
+
 Column PersistentStorageManager::Read(
     const TimeRange& time_range, StoredAggregationType aggregation_type) const {
-  // TODO: not read all levels, check time_range and read only needed levels
-  Column result;
-  for (int i = levels_.size() - 1; i >= 0; --i) {
-    auto column = levels_[i].Read(time_range, aggregation_type);
-    if (result) {
-      result->Merge(column);
-    } else {
-      result = column;
+  return Read(time_range, std::vector{aggregation_type}).front();
+}
+
+Columns PersistentStorageManager::Read(
+    const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types) const {
+  auto plan = PlanRead(time_range, aggregation_types);
+  Columns pages;
+  if (!plan.page_ids.empty()) {
+    pages = Level::LoadPages(*plan.storage, plan.page_cache, plan.page_ids,
+                             plan.page_types);
+  }
+  return FinishRead(plan, pages);
+}
+
+PersistentStorageManager::PlannedRead PersistentStorageManager::PlanRead(
+    const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types) const {
+  PlannedRead plan{.lock = std::shared_lock(levels_mutex_),
+                   .storage = options_->storage.get(),
+                   .page_cache = options_->page_cache.get(),
+                   .columns_num = aggregation_types.size()};
+  // levels are ordered from newest to oldest and older levels have only
+  // records older than the first record of a newer level, which is in its
+  // first bucket. So if the query starts after that bucket, older levels
+  // aren't needed
+  size_t levels_num = levels_.size();
+  for (size_t i = 0; i < levels_.size(); ++i) {
+    auto level_range = levels_[i].GetTimeRange();
+    if (!level_range.Empty() &&
+        level_range.start + levels_[i].GetBucketInterval() <=
+            time_range.start) {
+      levels_num = i + 1;
+      break;
+    }
+  }
+
+  // pages of all levels are read with one batch
+  for (int i = levels_num - 1; i >= 0; --i) {
+    if (!levels_[i].GetTimeRange().Overlaps(time_range)) {
+      continue;
+    }
+    const auto& level_plan = plan.levels.emplace_back(
+        levels_[i].PlanRead(time_range, aggregation_types));
+    plan.page_ids.insert(plan.page_ids.end(), level_plan.page_ids.begin(),
+                         level_plan.page_ids.end());
+    plan.page_types.insert(plan.page_types.end(),
+                           level_plan.page_types.begin(),
+                           level_plan.page_types.end());
+  }
+  return plan;
+}
+
+Columns PersistentStorageManager::FinishRead(const PlannedRead& plan,
+                                             std::span<const Column> pages) {
+  Columns result(plan.columns_num);
+  for (const auto& level_plan : plan.levels) {
+    auto columns =
+        Level::FinishRead(level_plan, pages.first(level_plan.page_ids.size()));
+    pages = pages.subspan(level_plan.page_ids.size());
+    for (size_t j = 0; j < columns.size(); ++j) {
+      if (result[j]) {
+        result[j]->Merge(columns[j]);
+      } else {
+        result[j] = std::move(columns[j]);
+      }
     }
   }
   return result;
 }
 
 void PersistentStorageManager::MergeLevels() {
-  for (size_t i = 0; i < levels_.size() - 1; ++i) {
+  {
+    std::shared_lock lock(levels_mutex_);
+    if (!FindLevelToMerge()) {
+      return;
+    }
+  }
+  compaction_task_.Schedule();
+}
+
+void PersistentStorageManager::WaitForPendingSegments() {
+  while (true) {
+    {
+      std::shared_lock lock(levels_mutex_);
+      if (pending_segments_ <= options_->max_pending_segments) {
+        return;
+      }
+    }
+    // the writer waits instead of threads of the compaction executor, so
+    // they never block. Merges are scheduled after commits are saved, that
+    // can be after this write started, so it's scheduled here too
+    compaction_task_.Schedule();
+    compaction_task_.Wait();
+  }
+}
+
+void PersistentStorageManager::Compact() {
+  while (true) {
+    size_t idx;
+    Level::Compaction compaction;
+    {
+      std::shared_lock lock(levels_mutex_);
+      auto level_idx = FindLevelToMerge();
+      if (!level_idx) {
+        return;
+      }
+      idx = *level_idx;
+      compaction = levels_[idx + 1].StartCompaction(levels_[idx]);
+    }
+    // reads only the snapshot, so readers and writers aren't blocked
+    levels_[idx + 1].BuildCompaction(compaction);
+    {
+      std::unique_lock lock(levels_mutex_);
+      levels_[idx + 1].FinishCompaction(levels_[idx], compaction);
+      if (idx == 0) {
+        pending_segments_ = 0;
+      }
+    }
+    SaveManifest();
+    // readers, that could see these pages, have already finished, and the
+    // manifest doesn't point to them
+    Level::DeleteCompactedPages(compaction);
+  }
+}
+
+void PersistentStorageManager::CreateLevels() {
+  if (!levels_.empty()) {
+    return;
+  }
+  levels_.reserve(options_->levels.size());
+  for (const auto& level_options : options_->levels) {
+    levels_.emplace_back(level_options, options_->storage,
+                         options_->page_cache);
+  }
+}
+
+std::optional<size_t> PersistentStorageManager::FindLevelToMerge() const {
+  for (size_t i = 0; i + 1 < levels_.size(); ++i) {
     if (levels_[i].NeedMerge()) {
-      levels_[i + 1].MovePagesFrom(levels_[i]);
+      return i;
     }
   }
+  return std::nullopt;
+}
+
+void PersistentStorageManager::SaveManifest() {
+  if (!manifest_path_) {
+    return;
+  }
+  std::lock_guard lock(manifest_mutex_);
+  auto manifest = BuildManifest();
+  // pages, that the manifest points to, must be durable before it. The sync
+  // follows the snapshot, so that it covers pages of merges, that were
+  // committed right before the snapshot
+  options_->storage->Sync();
+  WriteManifest(*manifest_path_, manifest);
+}
+
+CompressedBytes PersistentStorageManager::SnapshotManifest() {
+  std::lock_guard lock(manifest_mutex_);
+  return BuildManifest();
+}
+
+CompressedBytes PersistentStorageManager::BuildManifest() {
+  CompressedBytes payload;
+  std::shared_lock levels_lock(levels_mutex_);
+  Append(payload, ++manifest_version_);
+  Append(payload, flushed_lsn_);
+  Append(payload, static_cast<uint64_t>(levels_.size()));
+  for (const auto& level : levels_) {
+    auto bytes = level.ToBytes();
+    payload.insert(payload.end(), bytes.begin(), bytes.end());
+  }
+  return payload;
+}
+
+void PersistentStorageManager::RestoreManifest() {
+  if (!manifest_path_) {
+    return;
+  }
+  if (auto payload = ReadManifest(*manifest_path_)) {
+    RestoreManifest(*payload);
+  }
+}
+
+void PersistentStorageManager::RestoreManifest(const CompressedBytes& payload) {
+  CompressedBytesReader reader(payload);
+  auto version = reader.Read<uint64_t>();
+  if (version <= manifest_version_) {
+    return;
+  }
+  manifest_version_ = version;
+  flushed_lsn_ = reader.Read<Lsn>();
+  auto levels_num = reader.Read<uint64_t>();
+  if (levels_num == 0) {
+    return;
+  }
+  CreateLevels();
+  if (levels_num != levels_.size()) {
+    throw std::runtime_error("manifest of levels has different number of "
+                             "levels");
+  }
+  for (auto& level : levels_) {
+    level.RestoreFromBytes(reader);
+  }
 }
 
 }  // namespace tskv
@@ -1,11 +1,19 @@
 #pragma once
 
+#include "../executor/background_task.h"
+#include "../executor/executor.h"
+#include "../cache/page_cache.h"
 #include "../level/level.h"
 #include "../model/column.h"
 #include "../model/model.h"
 #include "persistent_storage.h"
 
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
 #include <vector>
 
 namespace tskv {
@@ -15,20 +23,121 @@ class PersistentStorageManager {
   struct Options {
     std::vector<Level::Options> levels;
     std::shared_ptr<IPersistentStorage> storage;
+    // levels are merged in background if set, otherwise during Write. Storage
+    // must be thread safe then
+    std::shared_ptr<Executor> executor;
+    // levels are saved there after every change and restored from it, if set
+    std::optional<std::string> manifest_path;
+    // decoded pages of levels are cached there, if set. Can be shared with
+    // other managers
+    std::shared_ptr<PageCache> page_cache;
+    // writes wait for the merge of levels, if the first level got more
+    // segments than that since it needs the merge. So writes are slowed down,
+    // when merges fall behind, instead of growing the first level without
+    // bound
+    size_t max_pending_segments{64};
+
+    bool operator==(const Options& other) const = default;
   };
 
  public:
   explicit PersistentStorageManager(const Options& options);
+  // options can be shared by managers of different metrics, so manifest_path
+  // is passed apart from them and the one in options is ignored
+  PersistentStorageManager(std::shared_ptr<const Options> options,
+                           std::optional<std::string> manifest_path);
   void Write(const SerializableColumns& columns);
+  // Write split into phases: Prepare writes pages and can run concurrently with
+  // reads, Commit makes them visible to reads
+  Level::PreparedWrite PrepareWrite(const SerializableColumns& columns);
+  // only adds pages to writes, so that flushes of several metrics are written
+  // with one batch. The caller writes them to the storage before Commit
+  Level::PreparedWrite PrepareWrite(const SerializableColumns& columns,
+                                    Level::PageWrites& writes);
+  // flushed_lsn is the last WAL record, that is in the written columns. Only
+  // appends the pages to the first level, so it's cheap enough to be called
+  // under locks of the caller. AfterCommit must follow
+  void CommitWrite(const Level::PreparedWrite& prepared, Lsn flushed_lsn = 0);
+  // saves the manifest and schedules merges of levels after one or more
+  // commits. Does I/O, so it's called after the caller releases its locks.
+  // Without save_manifest the caller saves SnapshotManifest itself
+  void AfterCommit(bool save_manifest = true);
+  // syncs the storage and writes the manifest to manifest_path
+  void SaveManifest();
+  // the manifest with the current levels, so that the caller saves manifests
+  // of many managers with one write. The caller syncs the storage after taking
+  // the snapshot, so that pages of merges committed before it are durable too.
+  // Every
+  // snapshot and saved manifest has a newer version, restore picks the newest
+  CompressedBytes SnapshotManifest();
+  // restores levels from the snapshot, if it's newer than the manifest at
+  // manifest_path. Must be called before reads and writes
+  void RestoreManifest(const CompressedBytes& payload);
+  // waits until all scheduled merges of levels are done
+  void WaitForCompaction();
+  // WAL records up to it are already in levels
+  Lsn GetFlushedLsn() const;
 
   Column Read(const TimeRange& time_range,
               StoredAggregationType aggregation_type) const;
+  // reads several aggregations with one pass over levels
+  Columns Read(const TimeRange& time_range,
+               const std::vector<StoredAggregationType>& aggregation_types)
+      const;
+
+  // Read split into phases, so that pages of many managers, that share the
+  // storage, are read with one batch: Plan lists pages of levels under their
+  // shared lock, that is held till Finish, the caller loads them with
+  // Level::LoadPages from storage and page_cache, Finish builds columns
+  struct PlannedRead {
+    std::shared_lock<std::shared_mutex> lock;
+    IPersistentStorage* storage{nullptr};
+    PageCache* page_cache{nullptr};
+    std::vector<Level::PlannedRead> levels;
+    std::vector<PageId> page_ids;
+    // page_types[i] is the column type of page_ids[i]
+    std::vector<ColumnType> page_types;
+    size_t columns_num{0};
+  };
+  PlannedRead PlanRead(
+      const TimeRange& time_range,
+      const std::vector<StoredAggregationType>& aggregation_types) const;
+  // pages[i] is the loaded page of plan.page_ids[i]
+  static Columns FinishRead(const PlannedRead& plan,
+                            std::span<const Column> pages);
 
  private:
   void MergeLevels();
+  // waits for merges, while there are more than max_pending_segments
+  void WaitForPendingSegments();
+  // merges levels until none of them needs it
+  void Compact();
+  // returns index of level, that needs to be moved to the next one
+  std::optional<size_t> FindLevelToMerge() const;
+  // levels are created on the first write, so that managers of idle metrics
+  // take less memory. Must be called under unique levels_mutex_
+  void CreateLevels();
+  // must be called under manifest_mutex_
+  CompressedBytes BuildManifest();
+  void RestoreManifest();
 
  private:
+  // levels use the same storage, so reads of all levels are batched
+  std::shared_ptr<const Options> options_;
+  // empty until the first write
   std::vector<Level> levels_;
+  // readers share it for the whole read, so they see the same set of pages
+  mutable std::shared_mutex levels_mutex_;
+  Lsn flushed_lsn_{0};
+  // segments committed to the first level, since it needs the merge
+  size_t pending_segments_{0};
+
+  std::optional<std::string> manifest_path_;
+  // manifest is written by flushes and merges, the latest state must win
+  std::mutex manifest_mutex_;
+  uint64_t manifest_version_{0};
+  // last, so that it's destroyed before levels it uses
+  BackgroundTask compaction_task_;
 };
 
 }  // namespace tskv
@@ -0,0 +1,831 @@
+#include "segment_storage.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "manifest/manifest.h"
+#include "model/compression.h"
+
+namespace tskv {
+
+namespace {
+
+constexpr size_t kCrcSize = sizeof(uint32_t);
+// records start at aligned offsets, so pages can be used in place when
+// segments are memory mapped
+constexpr size_t kRecordAlignment = alignof(uint64_t);
+constexpr std::array<uint8_t, kRecordAlignment> kPadding{};
+constexpr std::string_view kSegmentExtension = ".seg";
+
+std::runtime_error SystemError(const std::string& message) {
+  return std::runtime_error(message + ": " + std::strerror(errno));
+}
+
+// single request through the ring, or blocking syscall without it. Returns
+// -1 and sets errno on errors like syscalls do
+ssize_t Perform(IoUring* ring, IoUring::Op op, int fd, std::span<iovec> iov,
+                size_t offset) {
+  if (!ring) {
+    switch (op) {
+      case IoUring::Op::kRead:
+        return ::preadv(fd, iov.data(), iov.size(), offset);
+      case IoUring::Op::kWrite:
+        return ::pwritev(fd, iov.data(), iov.size(), offset);
+      case IoUring::Op::kSync:
+        return ::fdatasync(fd);
+    }
+  }
+  IoUring::Request request{.op = op,
+                           .fd = fd,
+                           .iov = iov.data(),
+                           .iov_num = iov.size(),
+                           .offset = offset};
+  ring->Submit({&request, 1});
+  if (request.result < 0) {
+    errno = static_cast<int>(-request.result);
+    return -1;
+  }
+  return request.result;
+}
+
+void PreadFull(IoUring* ring, int fd, std::span<iovec> iov, size_t offset) {
+  size_t total = 0;
+  for (const auto& part : iov) {
+    total += part.iov_len;
+  }
+  // regular files return short reads only at the end, so no retry loop
+  ssize_t read = Perform(ring, IoUring::Op::kRead, fd, iov, offset);
+  while (read < 0 && errno == EINTR) {
+    read = Perform(ring, IoUring::Op::kRead, fd, iov, offset);
+  }
+  if (read < 0) {
+    throw SystemError("segment read failed");
+  }
+  if (static_cast<size_t>(read) != total) {
+    throw std::runtime_error("segment record is truncated");
+  }
+}
+
+void PwriteFull(IoUring* ring, int fd, std::span<iovec> iov, size_t offset) {
+  size_t left = 0;
+  for (const auto& part : iov) {
+    left += part.iov_len;
+  }
+  size_t part = 0;
+  while (left > 0) {
+    auto written =
+        Perform(ring, IoUring::Op::kWrite, fd, iov.subspan(part), offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw SystemError("segment write failed");
+    }
+    offset += written;
+    left -= written;
+    // skips written parts after the short write
+    while (part < iov.size() &&
+           static_cast<size_t>(written) >= iov[part].iov_len) {
+      written -= iov[part].iov_len;
+      ++part;
+    }
+    if (part < iov.size()) {
+      iov[part].iov_base = static_cast<uint8_t*>(iov[part].iov_base) + written;
+      iov[part].iov_len -= written;
+    }
+  }
+}
+
+void SyncData(IoUring* ring, int fd) {
+  if (Perform(ring, IoUring::Op::kSync, fd, {}, 0) != 0) {
+    throw SystemError("segment sync failed");
+  }
+}
+
+uint32_t RecordCrc(std::span<const uint8_t> header,
+                   std::span<const uint8_t> bytes) {
+  return Crc32(bytes, Crc32(header.subspan(kCrcSize)));
+}
+
+}  // namespace
+
+SegmentStorage::SegmentStorage(const Options& options)
+    : options_(options),
+      path_(options.path),
+      collect_task_(options_.executor, [this] { CollectGarbage(); }) {
+  if (options_.io_uring) {
+    try {
+      ring_ = std::make_unique<IoUring>();
+    } catch (const std::runtime_error&) {
+      // falls back to blocking syscalls
+    }
+  }
+  std::filesystem::create_directories(path_);
+  Recover();
+}
+
+SegmentStorage::~SegmentStorage() {
+  // collections don't throw, they keep their errors
+  collect_task_.Wait();
+  for (auto& [_, segment] : segments_) {
+    ::close(segment.fd);
+  }
+}
+
+IPersistentStorage::Metadata SegmentStorage::GetMetadata() const {
+  return {};
+}
+
+PageId SegmentStorage::CreatePage() {
+  std::lock_guard lock(mutex_);
+  auto page = next_page_++;
+  pages_[page] = {};
+  return std::to_string(page);
+}
+
+CompressedBytes SegmentStorage::Read(const PageId& page_id) {
+  return std::move(ReadPages({&page_id, 1}).front());
+}
+
+PageBytes SegmentStorage::ReadShared(const PageId& page_id) {
+  if (!options_.mmap_reads) {
+    return IPersistentStorage::ReadShared(page_id);
+  }
+  auto page = ParsePageId(page_id);
+  std::shared_lock lock(mutex_);
+  auto it = pages_.find(page);
+  if (it == pages_.end()) {
+    throw std::runtime_error("page " + page_id + " not found");
+  }
+  const auto& location = it->second;
+  if (location.segment_id == 0) {
+    return {};
+  }
+
+  auto mapping =
+      GetMapping(segments_.at(location.segment_id),
+                 location.offset + kRecordHeaderSize + location.size);
+  HeaderBytes header;
+  std::memcpy(header.data(), mapping->data + location.offset, header.size());
+  auto record = DecodeHeader(header);
+  if (record.page != page || record.size != location.size) {
+    throw std::runtime_error("page " + page_id + " is corrupted");
+  }
+  return {mapping,
+          {mapping->data + location.offset + kRecordHeaderSize, location.size},
+          true};
+}
+
+void SegmentStorage::Write(const PageId& page_id,
+                           const CompressedBytes& bytes) {
+  WriteMany({&page_id, 1}, {&bytes, 1});
+}
+
+void SegmentStorage::DeletePage(const PageId& page_id) {
+  DeleteMany({&page_id, 1});
+}
+
+void SegmentStorage::Sync() {
+  // collections need the unique lock, so synced segments aren't closed
+  std::shared_lock lock(mutex_);
+  std::lock_guard sync_lock(sync_mutex_);
+  while (!unsynced_segments_.empty()) {
+    auto it = segments_.find(*unsynced_segments_.begin());
+    // collected segments have already moved their live pages and synced them
+    if (it != segments_.end()) {
+      SyncData(ring_.get(), it->second.fd);
+    }
+    unsynced_segments_.erase(unsynced_segments_.begin());
+  }
+  // records of a new segment are lost with it, if its entry isn't durable
+  if (directory_unsynced_) {
+    SyncDirectory(path_);
+    directory_unsynced_ = false;
+  }
+}
+
+std::vector<PageBytes> SegmentStorage::ReadMany(
+    std::span<const PageId> page_ids) {
+  std::vector<PageBytes> result;
+  result.reserve(page_ids.size());
+  if (options_.mmap_reads) {
+    // nothing to batch, mapped pages are read without syscalls
+    for (const auto& page_id : page_ids) {
+      result.push_back(ReadShared(page_id));
+    }
+    return result;
+  }
+  for (auto& bytes : ReadPages(page_ids)) {
+    auto owner = std::make_shared<const CompressedBytes>(std::move(bytes));
+    result.push_back({owner, *owner});
+  }
+  return result;
+}
+
+void SegmentStorage::WriteMany(std::span<const PageId> page_ids,
+                               std::span<const CompressedBytes> pages) {
+  std::vector<NewRecord> records;
+  records.reserve(page_ids.size());
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    records.push_back({ParsePageId(page_ids[i]), RecordType::kPage, pages[i]});
+  }
+  {
+    std::lock_guard lock(mutex_);
+    for (size_t i = 0; i < records.size(); ++i) {
+      if (!pages_.contains(records[i].page)) {
+        throw std::runtime_error("page " + page_ids[i] + " not found");
+      }
+    }
+    auto offsets = AppendRecords(records);
+    for (size_t i = 0; i < records.size(); ++i) {
+      // rewritten page keeps the old record until its segment is collected
+      RemovePage(records[i].page);
+      AddPage(records[i].page,
+              {current_segment_id_, offsets[i], records[i].bytes.size()});
+    }
+    if (!HasCollectCandidates()) {
+      return;
+    }
+  }
+  collect_task_.Schedule();
+}
+
+void SegmentStorage::DeleteMany(std::span<const PageId> page_ids) {
+  std::vector<PageNum> pages;
+  pages.reserve(page_ids.size());
+  for (const auto& page_id : page_ids) {
+    pages.push_back(ParsePageId(page_id));
+  }
+  {
+    std::lock_guard lock(mutex_);
+    std::vector<NewRecord> tombstones;
+    for (auto page : pages) {
+      auto it = pages_.find(page);
+      if (it != pages_.end() && it->second.segment_id != 0) {
+        tombstones.push_back({page, RecordType::kTombstone, {}});
+      }
+    }
+    AppendRecords(tombstones);
+    for (auto page : pages) {
+      RemovePage(page);
+      pages_.erase(page);
+    }
+    if (!HasCollectCandidates()) {
+      return;
+    }
+  }
+  collect_task_.Schedule();
+}
+
+size_t SegmentStorage::GetSegmentsNum() const {
+  std::shared_lock lock(mutex_);
+  return segments_.size();
+}
+
+std::vector<CompressedBytes> SegmentStorage::ReadPages(
+    std::span<const PageId> page_ids) {
+  std::vector<PageNum> pages;
+  pages.reserve(page_ids.size());
+  for (const auto& page_id : page_ids) {
+    pages.push_back(ParsePageId(page_id));
+  }
+
+  std::shared_lock lock(mutex_);
+  std::vector<CompressedBytes> result(pages.size());
+  std::vector<HeaderBytes> headers(pages.size());
+  std::vector<std::array<iovec, 2>> iovs(pages.size());
+  std::vector<IoUring::Request> requests;
+  std::vector<size_t> read_pages;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    auto it = pages_.find(pages[i]);
+    if (it == pages_.end()) {
+      throw std::runtime_error("page " + page_ids[i] + " not found");
+    }
+    const auto& location = it->second;
+    if (location.segment_id == 0) {
+      continue;
+    }
+    // header and page are read with one request
+    result[i].resize(location.size);
+    iovs[i] = {iovec{headers[i].data(), headers[i].size()},
+               iovec{result[i].data(), result[i].size()}};
+    auto fd = segments_.at(location.segment_id).fd;
+    if (ring_) {
+      requests.push_back({.op = IoUring::Op::kRead,
+                          .fd = fd,
+                          .iov = iovs[i].data(),
+                          .iov_num = iovs[i].size(),
+                          .offset = location.offset});
+    } else {
+      PreadFull(nullptr, fd, iovs[i], location.offset);
+    }
+    read_pages.push_back(i);
+  }
+  if (ring_) {
+    // all pages are read with one submission
+    ring_->Submit(requests);
+    for (size_t j = 0; j < requests.size(); ++j) {
+      auto i = read_pages[j];
+      if (requests[j].result < 0) {
+        throw std::runtime_error(
+            std::string("segment read failed: ") +
+            std::strerror(static_cast<int>(-requests[j].result)));
+      }
+      if (static_cast<size_t>(requests[j].result) !=
+          kRecordHeaderSize + result[i].size()) {
+        throw std::runtime_error("segment record is truncated");
+      }
+    }
+  }
+
+  for (auto i : read_pages) {
+    auto record = DecodeHeader(headers[i]);
+    if (record.page != pages[i] || record.size != result[i].size() ||
+        record.crc != RecordCrc(headers[i], result[i])) {
+      throw std::runtime_error("page " + page_ids[i] + " is corrupted");
+    }
+  }
+  return result;
+}
+
+void SegmentStorage::Recover() {
+  std::vector<SegmentId> segment_ids;
+  for (const auto& entry : std::filesystem::directory_iterator(path_)) {
+    if (entry.path().extension() != kSegmentExtension) {
+      continue;
+    }
+    segment_ids.push_back(std::stoull(entry.path().stem().string()));
+  }
+  std::ranges::sort(segment_ids);
+  // later records of the page override the earlier ones
+  for (auto segment_id : segment_ids) {
+    OpenSegment(segment_id);
+    RecoverSegment(segment_id, segment_id == segment_ids.back());
+  }
+
+  if (segment_ids.empty() ||
+      segments_.at(segment_ids.back()).size >= options_.max_segment_size) {
+    OpenSegment(segment_ids.empty() ? 1 : segment_ids.back() + 1);
+  }
+  for (const auto& [segment_id, _] : segments_) {
+    collect_candidates_.push_back(segment_id);
+  }
+  if (HasCollectCandidates()) {
+    collect_task_.Schedule();
+  }
+}
+
+void SegmentStorage::RecoverSegment(SegmentId segment_id, bool is_last) {
+  auto& segment = segments_.at(segment_id);
+  auto file_size = std::filesystem::file_size(segment.path);
+  size_t offset = 0;
+  while (offset < file_size) {
+    HeaderBytes header;
+    RecordHeader record;
+    bool valid = file_size - offset >= kRecordHeaderSize;
+    if (valid) {
+      std::array<iovec, 1> iov{iovec{header.data(), header.size()}};
+      PreadFull(ring_.get(), segment.fd, iov, offset);
+      record = DecodeHeader(header);
+      valid = file_size - offset >= RecordSize(record.size) &&
+              record.type <= RecordType::kTombstone;
+    }
+    if (valid && is_last) {
+      // only the last segment can have a torn tail, so only its pages are
+      // checked on start, the others are checked on reads
+      CompressedBytes bytes(record.size);
+      std::array<iovec, 1> iov{iovec{bytes.data(), bytes.size()}};
+      PreadFull(ring_.get(), segment.fd, iov, offset + kRecordHeaderSize);
+      valid = record.crc == RecordCrc(header, bytes);
+    }
+    if (!valid) {
+      if (!is_last) {
+        throw std::runtime_error("segment " + segment.path.string() +
+                                 " is corrupted");
+      }
+      if (::ftruncate(segment.fd, offset) != 0) {
+        throw SystemError("can't truncate segment " + segment.path.string());
+      }
+      break;
+    }
+
+    next_page_ = std::max(next_page_, record.page + 1);
+    if (record.type == RecordType::kPage) {
+      RemovePage(record.page);
+      AddPage(record.page, {segment_id, offset, record.size});
+    } else {
+      RemovePage(record.page);
+      pages_.erase(record.page);
+    }
+    offset += RecordSize(record.size);
+  }
+  segment.size = offset;
+}
+
+void SegmentStorage::OpenSegment(SegmentId segment_id) {
+  auto name = std::to_string(segment_id);
+  name.insert(0, 20 - name.size(), '0');
+  auto path = path_ / (name + std::string(kSegmentExtension));
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw SystemError("can't open segment " + path.string());
+  }
+  segments_[segment_id] = Segment{.fd = fd, .path = std::move(path)};
+  current_segment_id_ = segment_id;
+  directory_unsynced_ = true;
+}
+
+SegmentStorage::Mapping::Mapping(int fd, size_t size) : size(size) {
+  auto* mapped = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    throw SystemError("can't map segment");
+  }
+  data = static_cast<const uint8_t*>(mapped);
+}
+
+SegmentStorage::Mapping::~Mapping() {
+  ::munmap(const_cast<uint8_t*>(data), size);
+}
+
+std::shared_ptr<const SegmentStorage::Mapping> SegmentStorage::GetMapping(
+    Segment& segment, size_t min_size) {
+  std::lock_guard lock(mapping_mutex_);
+  if (!segment.mapping || segment.mapping->size < min_size) {
+    // the current segment is mapped with its max size, so it's not remapped
+    // after every append. Bytes after the end of file are never accessed
+    segment.mapping = std::make_shared<const Mapping>(
+        segment.fd, std::max(min_size, options_.max_segment_size));
+  }
+  return segment.mapping;
+}
+
+SegmentStorage::PageNum SegmentStorage::ParsePageId(const PageId& page_id) {
+  PageNum page;
+  auto [end, error] =
+      std::from_chars(page_id.data(), page_id.data() + page_id.size(), page);
+  if (error != std::errc{} || end != page_id.data() + page_id.size()) {
+    throw std::runtime_error("invalid page id " + page_id);
+  }
+  return page;
+}
+
+size_t SegmentStorage::RecordSize(size_t page_size) {
+  auto size = kRecordHeaderSize + page_size;
+  return (size + kRecordAlignment - 1) / kRecordAlignment * kRecordAlignment;
+}
+
+SegmentStorage::HeaderBytes SegmentStorage::EncodeHeader(
+    const RecordHeader& record) {
+  HeaderBytes header{};
+  auto* out = header.data();
+  std::memcpy(out, &record.crc, sizeof(record.crc));
+  out += sizeof(record.crc);
+  std::memcpy(out, &record.size, sizeof(record.size));
+  out += sizeof(record.size);
+  std::memcpy(out, &record.page, sizeof(record.page));
+  out += sizeof(record.page);
+  std::memcpy(out, &record.type, sizeof(record.type));
+  return header;
+}
+
+SegmentStorage::RecordHeader SegmentStorage::DecodeHeader(
+    const HeaderBytes& header) {
+  RecordHeader record;
+  const auto* in = header.data();
+  std::memcpy(&record.crc, in, sizeof(record.crc));
+  in += sizeof(record.crc);
+  std::memcpy(&record.size, in, sizeof(record.size));
+  in += sizeof(record.size);
+  std::memcpy(&record.page, in, sizeof(record.page));
+  in += sizeof(record.page);
+  std::memcpy(&record.type, in, sizeof(record.type));
+  return record;
+}
+
+size_t SegmentStorage::AppendRecord(PageNum page, RecordType type,
+                                    std::span<const uint8_t> bytes) {
+  return AppendRecords(std::array{NewRecord{page, type, bytes}}).front();
+}
+
+std::vector<size_t> SegmentStorage::AppendRecords(
+    std::span<const NewRecord> records) {
+  if (records.empty()) {
+    return {};
+  }
+  for (const auto& record : records) {
+    if (record.bytes.size() > std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error("page is too big");
+    }
+  }
+  // the whole batch goes to one segment, so it can be written at once
+  if (segments_.at(current_segment_id_).size >= options_.max_segment_size) {
+    auto sealed_segment_id = current_segment_id_;
+    OpenSegment(current_segment_id_ + 1);
+    collect_candidates_.push_back(sealed_segment_id);
+  }
+
+  auto& segment = segments_.at(current_segment_id_);
+  std::vector<HeaderBytes> headers(records.size());
+  std::vector<iovec> iov;
+  std::vector<size_t> offsets;
+  iov.reserve(3 * records.size());
+  offsets.reserve(records.size());
+  auto offset = segment.size;
+  auto write_offset = offset;
+  for (size_t i = 0; i < records.size(); ++i) {
+    const auto& record = records[i];
+    auto& header = headers[i];
+    header = EncodeHeader({.crc = 0,
+                           .size = static_cast<uint32_t>(record.bytes.size()),
+                           .page = record.page,
+                           .type = record.type});
+    auto crc = RecordCrc(header, record.bytes);
+    std::memcpy(header.data(), &crc, sizeof(crc));
+
+    auto record_size = RecordSize(record.bytes.size());
+    iov.push_back({header.data(), header.size()});
+    iov.push_back({const_cast<uint8_t*>(record.bytes.data()),
+                   record.bytes.size()});
+    iov.push_back({const_cast<uint8_t*>(kPadding.data()),
+                   record_size - kRecordHeaderSize - record.bytes.size()});
+    offsets.push_back(offset);
+    offset += record_size;
+    // writev takes at most IOV_MAX parts
+    if (iov.size() + 3 > IOV_MAX || i + 1 == records.size()) {
+      PwriteFull(ring_.get(), segment.fd, iov, write_offset);
+      iov.clear();
+      write_offset = offset;
+    }
+  }
+  segment.size = offset;
+  unsynced_segments_.insert(current_segment_id_);
+  return offsets;
+}
+
+void SegmentStorage::AddPage(PageNum page, const Location& location) {
+  auto& segment = segments_.at(location.segment_id);
+  segment.live_bytes += RecordSize(location.size);
+  segment.pages.insert(page);
+  pages_[page] = location;
+}
+
+void SegmentStorage::RemovePage(PageNum page) {
+  auto it = pages_.find(page);
+  if (it == pages_.end() || it->second.segment_id == 0) {
+    return;
+  }
+  auto segment_id = it->second.segment_id;
+  auto& segment = segments_.at(segment_id);
+  segment.live_bytes -= RecordSize(it->second.size);
+  segment.pages.erase(page);
+  it->second = {};
+  ++dead_records_[page];
+  collect_candidates_.push_back(segment_id);
+}
+
+bool SegmentStorage::NeedCollect(SegmentId segment_id) const {
+  auto it = segments_.find(segment_id);
+  if (it == segments_.end() || segment_id == current_segment_id_) {
+    return false;
+  }
+  const auto& segment = it->second;
+  return segment.size - segment.live_bytes >=
+         segment.size * options_.gc_garbage_ratio;
+}
+
+bool SegmentStorage::HasCollectCandidates() {
+  std::erase_if(collect_candidates_, [this](SegmentId segment_id) {
+    return !NeedCollect(segment_id);
+  });
+  return !collect_candidates_.empty();
+}
+
+void SegmentStorage::CollectGarbage() {
+  // the running collection takes candidates added during it
+  std::unique_lock collect_lock(collect_mutex_, std::try_to_lock);
+  if (!collect_lock) {
+    return;
+  }
+  while (true) {
+    SegmentId segment_id;
+    {
+      std::lock_guard lock(mutex_);
+      if (!HasCollectCandidates()) {
+        return;
+      }
+      segment_id = collect_candidates_.back();
+      std::erase(collect_candidates_, segment_id);
+    }
+    // records of writes, that started it, are already written, so they don't
+    // fail with its error. The segment stays and is retried with its next
+    // garbage
+    try {
+      CollectSegment(segment_id);
+    } catch (...) {
+      std::lock_guard lock(mutex_);
+      // moved pages made it a candidate again, but it waits for new garbage
+      std::erase(collect_candidates_, segment_id);
+      collect_error_ = std::current_exception();
+      return;
+    }
+  }
+}
+
+void SegmentStorage::CollectSegment(SegmentId segment_id) {
+  int fd;
+  size_t size;
+  {
+    // the segment is sealed, so its size doesn't change
+    std::shared_lock lock(mutex_);
+    const auto& segment = segments_.at(segment_id);
+    fd = segment.fd;
+    size = segment.size;
+  }
+
+  // the segment stays in segments_, until its pages are moved and synced, so
+  // it's still readable, if the collection fails
+  Collection collection{.segment_id = segment_id};
+  std::vector<uint8_t> chunk;
+  size_t min_chunk_size = kRecordHeaderSize;
+  size_t offset = 0;
+  while (offset < size) {
+    chunk.resize(std::min(std::max(options_.gc_chunk_size, min_chunk_size),
+                          size - offset));
+    std::array<iovec, 1> iov{iovec{chunk.data(), chunk.size()}};
+    PreadFull(ring_.get(), fd, iov, offset);
+    auto records = ParseChunk(chunk, offset);
+    if (records.empty()) {
+      // the record is bigger than the chunk, it's read whole the next time
+      if (chunk.size() < kRecordHeaderSize) {
+        throw std::runtime_error("segment " + std::to_string(segment_id) +
+                                 " is corrupted");
+      }
+      HeaderBytes header;
+      std::memcpy(header.data(), chunk.data(), header.size());
+      auto record_size = RecordSize(DecodeHeader(header).size);
+      if (record_size <= chunk.size() || record_size > size - offset) {
+        throw std::runtime_error("segment " + std::to_string(segment_id) +
+                                 " is corrupted");
+      }
+      min_chunk_size = record_size;
+      continue;
+    }
+    min_chunk_size = kRecordHeaderSize;
+    MoveRecords(records, collection);
+    offset = records.back().offset + RecordSize(records.back().record.size);
+  }
+
+  std::vector<int> moved_fds;
+  {
+    std::lock_guard lock(mutex_);
+    // tombstone is kept while older records of the page can be restored
+    for (auto page : collection.tombstones) {
+      auto it = dead_records_.find(page);
+      if (!pages_.contains(page) && it != dead_records_.end() &&
+          it->second > collection.collected_records[page]) {
+        AppendRecord(page, RecordType::kTombstone, {});
+        collection.moved_to.insert(current_segment_id_);
+      }
+    }
+    for (auto moved_segment_id : collection.moved_to) {
+      moved_fds.push_back(segments_.at(moved_segment_id).fd);
+    }
+  }
+  // moved pages must be durable before their old copies are removed, with
+  // entries of the segments they were moved to
+  for (auto moved_fd : moved_fds) {
+    SyncData(ring_.get(), moved_fd);
+  }
+  SyncDirectory(path_);
+
+  std::filesystem::path path;
+  {
+    std::lock_guard lock(mutex_);
+    auto it = segments_.find(segment_id);
+    assert(it->second.pages.empty());
+    for (auto [page, records_num] : collection.collected_records) {
+      auto dead_it = dead_records_.find(page);
+      dead_it->second -= records_num;
+      if (dead_it->second == 0) {
+        dead_records_.erase(dead_it);
+      }
+    }
+    path = std::move(it->second.path);
+    segments_.erase(it);
+  }
+  // readers use the descriptor under the lock, so it's closed after that
+  ::close(fd);
+  std::filesystem::remove(path);
+  // otherwise the segment can come back after a crash, and pages deleted
+  // since then come back with it, as their tombstones could be collected
+  SyncDirectory(path_);
+}
+
+std::vector<SegmentStorage::ChunkRecord> SegmentStorage::ParseChunk(
+    std::span<const uint8_t> chunk, size_t chunk_offset) {
+  std::vector<ChunkRecord> records;
+  size_t offset = 0;
+  while (chunk.size() - offset >= kRecordHeaderSize) {
+    ChunkRecord chunk_record;
+    std::memcpy(chunk_record.header.data(), chunk.data() + offset,
+                kRecordHeaderSize);
+    chunk_record.record = DecodeHeader(chunk_record.header);
+    auto record_size = RecordSize(chunk_record.record.size);
+    if (chunk.size() - offset < record_size) {
+      break;
+    }
+    if (chunk_record.record.type > RecordType::kTombstone) {
+      throw std::runtime_error("segment record has unknown type");
+    }
+    chunk_record.offset = chunk_offset + offset;
+    chunk_record.bytes =
+        chunk.subspan(offset + kRecordHeaderSize, chunk_record.record.size);
+    records.push_back(chunk_record);
+    offset += record_size;
+  }
+  return records;
+}
+
+void SegmentStorage::MoveRecords(std::span<const ChunkRecord> records,
+                                 Collection& collection) {
+  auto is_live = [this, &collection](const ChunkRecord& chunk_record) {
+    auto it = pages_.find(chunk_record.record.page);
+    return it != pages_.end() &&
+           it->second.segment_id == collection.segment_id &&
+           it->second.offset == chunk_record.offset;
+  };
+
+  std::vector<const ChunkRecord*> live;
+  {
+    std::shared_lock lock(mutex_);
+    for (const auto& chunk_record : records) {
+      if (chunk_record.record.type == RecordType::kTombstone) {
+        collection.tombstones.push_back(chunk_record.record.page);
+        continue;
+      }
+      ++collection.collected_records[chunk_record.record.page];
+      if (is_live(chunk_record)) {
+        live.push_back(&chunk_record);
+      }
+    }
+  }
+  if (live.empty()) {
+    return;
+  }
+  for (const auto* chunk_record : live) {
+    if (chunk_record->record.crc !=
+        RecordCrc(chunk_record->header, chunk_record->bytes)) {
+      throw std::runtime_error("segment " +
+                               std::to_string(collection.segment_id) +
+                               " is corrupted");
+    }
+  }
+
+  std::lock_guard lock(mutex_);
+  // pages could be rewritten or deleted, while the chunk was checked
+  std::erase_if(live, [&is_live](const ChunkRecord* chunk_record) {
+    return !is_live(*chunk_record);
+  });
+  std::vector<NewRecord> moved;
+  moved.reserve(live.size());
+  for (const auto* chunk_record : live) {
+    moved.push_back(
+        {chunk_record->record.page, RecordType::kPage, chunk_record->bytes});
+  }
+  auto offsets = AppendRecords(moved);
+  for (size_t i = 0; i < moved.size(); ++i) {
+    // the old record becomes dead like the one of a rewritten page
+    RemovePage(moved[i].page);
+    AddPage(moved[i].page,
+            {current_segment_id_, offsets[i], moved[i].bytes.size()});
+  }
+  if (!moved.empty()) {
+    collection.moved_to.insert(current_segment_id_);
+  }
+}
+
+void SegmentStorage::WaitForCollection() {
+  collect_task_.Wait();
+  std::lock_guard lock(mutex_);
+  if (collect_error_) {
+    std::rethrow_exception(std::exchange(collect_error_, nullptr));
+  }
+}
+
+}  // namespace tskv
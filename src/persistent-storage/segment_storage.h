@@ -0,0 +1,224 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../executor/background_task.h"
+#include "../executor/executor.h"
+#include "io_uring.h"
+#include "persistent_storage.h"
+
+namespace tskv {
+
+// Storage, that appends pages to big segment files instead of creating a file
+// per page. Page ids are numbers, their offsets are kept in memory and are
+// restored on start by scanning segment headers.
+//
+// Deleted and rewritten pages become garbage, segments with enough garbage
+// are collected: live pages are copied to the current segment and the file is
+// removed. Collections run in background, they read segments in chunks without
+// locks and block reads and writes only to move the live pages of a chunk.
+// Deleted pages leave tombstones, so they aren't restored on start until their
+// older records are collected.
+//
+// With mmap_reads ReadShared returns views over memory mapped segments, so
+// columns are read without copies. Views don't check page crc, and keep the
+// mapping alive after the segment is collected, so cached columns copy them.
+class SegmentStorage : public IPersistentStorage {
+ public:
+  struct Options {
+    std::string path;
+    size_t max_segment_size{64 * 1024 * 1024};
+    // part of garbage bytes, after which a full segment is collected
+    double gc_garbage_ratio{0.5};
+    // collections read segments by such chunks and move live pages of a chunk
+    // with one write
+    size_t gc_chunk_size{1024 * 1024};
+    bool mmap_reads{false};
+    // file I/O goes through io_uring if the kernel allows it
+    bool io_uring{false};
+    // garbage is collected there if set, otherwise by writes and deletes after
+    // they release the storage
+    std::shared_ptr<Executor> executor;
+  };
+
+ public:
+  explicit SegmentStorage(const Options& options);
+  SegmentStorage(const SegmentStorage&) = delete;
+  SegmentStorage& operator=(const SegmentStorage&) = delete;
+  ~SegmentStorage() override;
+
+  Metadata GetMetadata() const override;
+  PageId CreatePage() override;
+  CompressedBytes Read(const PageId& page_id) override;
+  PageBytes ReadShared(const PageId& page_id) override;
+  void Write(const PageId& page_id, const CompressedBytes& bytes) override;
+  void DeletePage(const PageId& page_id) override;
+  // syncs segments, that got records since the last sync
+  void Sync() override;
+  // reads are sent with one io_uring submission, writes and deletes append
+  // all records with one write
+  std::vector<PageBytes> ReadMany(std::span<const PageId> page_ids) override;
+  void WriteMany(std::span<const PageId> page_ids,
+                 std::span<const CompressedBytes> pages) override;
+  void DeleteMany(std::span<const PageId> page_ids) override;
+
+  size_t GetSegmentsNum() const;
+  // waits for scheduled collections and rethrows the error of a failed one.
+  // Writes and deletes, that start collections, don't fail with their errors
+  void WaitForCollection();
+
+ private:
+  using SegmentId = uint64_t;
+  using PageNum = uint64_t;
+
+  struct Mapping {
+    Mapping(int fd, size_t size);
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+    ~Mapping();
+
+    const uint8_t* data;
+    size_t size;
+  };
+
+  struct Segment {
+    int fd{-1};
+    // can be changed under the shared lock, guarded by mapping_mutex_
+    std::shared_ptr<const Mapping> mapping;
+    std::filesystem::path path;
+    size_t size{0};
+    size_t live_bytes{0};
+    std::unordered_set<PageNum> pages;
+  };
+
+  struct Location {
+    // 0 for created but not written pages
+    SegmentId segment_id{0};
+    size_t offset{0};
+    size_t size{0};
+  };
+
+  enum class RecordType : uint8_t {
+    kPage = 0,
+    kTombstone = 1,
+  };
+
+  // record is [crc32][size][page][type][padding][bytes][padding], crc covers
+  // all after it except the last padding
+  struct RecordHeader {
+    uint32_t crc;
+    uint32_t size;
+    PageNum page;
+    RecordType type;
+  };
+  static constexpr size_t kRecordHeaderSize = 3 * sizeof(uint64_t);
+  using HeaderBytes = std::array<uint8_t, kRecordHeaderSize>;
+
+  struct NewRecord {
+    PageNum page;
+    RecordType type;
+    std::span<const uint8_t> bytes;
+  };
+
+  // record of the collected segment, bytes point to the read chunk
+  struct ChunkRecord {
+    HeaderBytes header;
+    RecordHeader record;
+    size_t offset;
+    std::span<const uint8_t> bytes;
+  };
+
+  // state of one collection, that is changed between its chunks
+  struct Collection {
+    SegmentId segment_id;
+    std::vector<PageNum> tombstones;
+    // records of pages, that are dead after the collection
+    std::unordered_map<PageNum, size_t> collected_records;
+    // appends can seal the current segment and open a new one, so moved
+    // pages can be in several segments
+    std::set<SegmentId> moved_to;
+  };
+
+ private:
+  void Recover();
+  void RecoverSegment(SegmentId segment_id, bool is_last);
+  void OpenSegment(SegmentId segment_id);
+  // returns mapping of at least min_size bytes of the segment
+  std::shared_ptr<const Mapping> GetMapping(Segment& segment, size_t min_size);
+
+  static PageNum ParsePageId(const PageId& page_id);
+  // size of the record with padding
+  static size_t RecordSize(size_t page_size);
+  static HeaderBytes EncodeHeader(const RecordHeader& record);
+  static RecordHeader DecodeHeader(const HeaderBytes& header);
+  // reads pages into memory, checking their crc
+  std::vector<CompressedBytes> ReadPages(std::span<const PageId> page_ids);
+  // appends record to the current segment, returns its offset
+  size_t AppendRecord(PageNum page, RecordType type,
+                      std::span<const uint8_t> bytes);
+  // appends records to the current segment with one write (or few, if there
+  // are too many), returns their offsets
+  std::vector<size_t> AppendRecords(std::span<const NewRecord> records);
+  void AddPage(PageNum page, const Location& location);
+  // called after the record of the page stops being live
+  void RemovePage(PageNum page);
+
+  bool NeedCollect(SegmentId segment_id) const;
+  // drops candidates without enough garbage, returns if there are others. Must
+  // be called under unique mutex_
+  bool HasCollectCandidates();
+  // collects candidates, that have enough garbage
+  void CollectGarbage();
+  void CollectSegment(SegmentId segment_id);
+  // parses whole records at the start of the chunk
+  static std::vector<ChunkRecord> ParseChunk(std::span<const uint8_t> chunk,
+                                             size_t chunk_offset);
+  // moves live pages of the chunk to the current segment
+  void MoveRecords(std::span<const ChunkRecord> records,
+                   Collection& collection);
+
+ private:
+  Options options_;
+  std::filesystem::path path_;
+  // null if io_uring isn't used
+  std::unique_ptr<IoUring> ring_;
+
+  mutable std::shared_mutex mutex_;
+  std::mutex mapping_mutex_;
+  std::map<SegmentId, Segment> segments_;
+  SegmentId current_segment_id_{0};
+  std::unordered_map<PageNum, Location> pages_;
+  // number of not collected records of pages, that aren't live anymore. Page
+  // tombstone is needed while there are such records
+  std::unordered_map<PageNum, size_t> dead_records_;
+  PageNum next_page_{0};
+  // segments, that got garbage or were sealed since the last collection
+  std::vector<SegmentId> collect_candidates_;
+  std::exception_ptr collect_error_;
+  // segments with records, that aren't synced yet. Changed under unique
+  // mutex_ by appends, Sync takes it under shared mutex_ and sync_mutex_
+  std::set<SegmentId> unsynced_segments_;
+  // segments were created since the directory was synced, guarded the same
+  // way
+  bool directory_unsynced_{false};
+  std::mutex sync_mutex_;
+  // one collection runs at a time. Only collections close segments, so
+  // they use descriptors of segments without mutex_
+  std::mutex collect_mutex_;
+  // last, so that collections are finished before the storage is destroyed
+  BackgroundTask collect_task_;
+};
+
+}  // namespace tskv
@@ -1,8 +1,99 @@
 #include "storage.h"
+#include "manifest/manifest.h"
 #include "model/aggregations.h"
 
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <latch>
+#include <map>
+#include <mutex>
+#include <utility>
+
 namespace tskv {
 
+namespace {
+
+constexpr std::string_view kMetricsJournalName = "metrics.journal";
+constexpr std::string_view kLevelsJournalName = "levels.journal";
+// levels journal is read as a whole on start
+constexpr size_t kMaxLevelsJournalSize = 16 * 1024 * 1024;
+// writes wait for flushes, when memtables take that many budgets
+constexpr size_t kMaxMemtablesBudgets = 2;
+
+template <typename T>
+void AppendOptional(CompressedBytes& bytes, const std::optional<T>& value) {
+  Append(bytes, value.has_value());
+  if (value) {
+    Append(bytes, static_cast<uint64_t>(*value));
+  }
+}
+
+std::optional<uint64_t> ReadOptional(CompressedBytesReader& reader) {
+  if (!reader.Read<bool>()) {
+    return std::nullopt;
+  }
+  return reader.Read<uint64_t>();
+}
+
+// only options, that describe data, storage and executors aren't saved
+void AppendOptions(CompressedBytes& bytes,
+                   const MetricStorage::Options& options) {
+  const auto& aggregation_types = options.metric_options.aggregation_types;
+  Append(bytes, static_cast<uint64_t>(aggregation_types.size()));
+  Append(bytes, aggregation_types.data(), aggregation_types.size());
+
+  const auto& memtable_options = options.memtable_options;
+  Append(bytes, static_cast<uint64_t>(memtable_options.bucket_interval));
+  AppendOptional(bytes, memtable_options.max_bytes_size);
+  AppendOptional(bytes, memtable_options.max_age);
+  Append(bytes, memtable_options.store_raw);
+
+  const auto& levels = options.persistent_storage_manager_options.levels;
+  Append(bytes, static_cast<uint64_t>(levels.size()));
+  for (const auto& level : levels) {
+    Append(bytes, static_cast<uint64_t>(level.bucket_interval));
+    Append(bytes, static_cast<uint64_t>(level.level_duration));
+    Append(bytes, level.store_raw);
+  }
+  Append(bytes, static_cast<uint64_t>(options.max_immutable_memtables));
+  Append(bytes, static_cast<uint64_t>(
+                    options.persistent_storage_manager_options
+                        .max_pending_segments));
+}
+
+MetricStorage::Options ReadOptions(CompressedBytesReader& reader) {
+  MetricStorage::Options options;
+  auto& aggregation_types = options.metric_options.aggregation_types;
+  aggregation_types.resize(reader.Read<uint64_t>());
+  for (auto& aggregation_type : aggregation_types) {
+    aggregation_type = reader.Read<StoredAggregationType>();
+  }
+
+  auto& memtable_options = options.memtable_options;
+  memtable_options.bucket_interval = reader.Read<uint64_t>();
+  memtable_options.max_bytes_size = ReadOptional(reader);
+  if (auto max_age = ReadOptional(reader)) {
+    memtable_options.max_age = *max_age;
+  }
+  memtable_options.store_raw = reader.Read<bool>();
+
+  auto& levels = options.persistent_storage_manager_options.levels;
+  levels.resize(reader.Read<uint64_t>());
+  for (auto& level : levels) {
+    level.bucket_interval = reader.Read<uint64_t>();
+    level.level_duration = reader.Read<uint64_t>();
+    level.store_raw = reader.Read<bool>();
+  }
+  options.max_immutable_memtables = reader.Read<uint64_t>();
+  options.persistent_storage_manager_options.max_pending_segments =
+      reader.Read<uint64_t>();
+  return options;
+}
+
+}  // namespace
+
 void ValidateOptions(const MetricStorage::Options& options) {
   auto memtable_options = options.memtable_options;
   auto persistent_storage_options = options.persistent_storage_manager_options;
@@ -16,6 +107,11 @@ void ValidateOptions(const MetricStorage::Options& options) {
     throw std::runtime_error("Memtable should have max_size or max_age");
   }
 
+  if (options.max_immutable_memtables == 0) {
+    throw std::runtime_error(
+        "At least one immutable memtable should be allowed");
+  }
+
   if (!persistent_storage_options.levels.empty()) {
     if (persistent_storage_options.levels[0].bucket_interval !=
         memtable_options.bucket_interval) {
@@ -46,36 +142,602 @@ void ValidateOptions(const MetricStorage::Options& options) {
   }
 }
 
+Storage::Storage(const Options& options)
+    : executor_(options.executor),
+      max_memtables_bytes_size_(options.max_memtables_bytes_size),
+      memtables_flush_task_(options.flush_executor,
+                            [this] { FlushLargestMemtables(); }) {
+  if (options.page_cache) {
+    page_cache_ = std::make_shared<PageCache>(*options.page_cache);
+  }
+  if (max_memtables_bytes_size_) {
+    memtables_bytes_size_ = std::make_shared<std::atomic<size_t>>(0);
+  }
+  if (options.manifest_path) {
+    manifest_path_ = *options.manifest_path;
+    std::filesystem::create_directories(*manifest_path_);
+    RestoreManifest(options);
+  }
+  if (options.wal) {
+    wal_ = std::make_unique<Wal>(*options.wal);
+  }
+}
+
+Storage::Metric::Metric(std::shared_ptr<const MetricStorage::Options> options,
+                        std::optional<std::string> manifest_path)
+    : storage(std::move(options), std::move(manifest_path)) {}
+
 MetricId Storage::InitMetric(const MetricStorage::Options& options) {
+  auto id = CreateMetric(options, {});
+  SyncMetrics();
+  return id;
+}
+
+MetricId Storage::InitMetric(Labels labels,
+                             const MetricStorage::Options& options) {
+  if (labels.empty()) {
+    throw std::runtime_error("Series must have labels");
+  }
+  // found metric can be created by a concurrent init, that hasn't synced it
+  // yet
+  if (auto id = catalog_.Find(labels)) {
+    SyncMetrics();
+    return *id;
+  }
+  MetricId id;
+  {
+    std::lock_guard lock(init_mutex_);
+    if (auto found_id = catalog_.Find(labels)) {
+      id = *found_id;
+    } else {
+      id = CreateMetric(options, std::move(labels));
+    }
+  }
+  SyncMetrics();
+  return id;
+}
+
+std::optional<MetricId> Storage::FindMetric(Labels labels) const {
+  return catalog_.Find(std::move(labels));
+}
+
+std::vector<MetricId> Storage::SelectMetrics(std::string_view selector) const {
+  return catalog_.Select(ParseSelector(selector));
+}
+
+MetricId Storage::CreateMetric(const MetricStorage::Options& options,
+                               Labels labels) {
   ValidateOptions(options);
   MetricId id = next_id_++;
-  metrics_.emplace(id, options);
+  auto metric_options = options;
+  auto& persistent_storage_manager_options =
+      metric_options.persistent_storage_manager_options;
+  if (page_cache_ && !persistent_storage_manager_options.page_cache) {
+    persistent_storage_manager_options.page_cache = page_cache_;
+  }
+  if (memtables_bytes_size_) {
+    metric_options.memtables_bytes_size = memtables_bytes_size_;
+  }
+  // before the metric can be found, so that inits, which find it, sync it
+  if (metrics_journal_) {
+    SaveMetric(id, metric_options, labels);
+  }
+  AddMetric(id, metric_options, std::move(labels));
   return id;
 }
 
 void Storage::Write(MetricId id, const InputTimeSeries& input) {
-  auto it = metrics_.find(id);
-  if (it == metrics_.end()) {
-    throw std::runtime_error("Metric with id " + std::to_string(id) +
-                             " not found");
+  auto& metric = GetMetric(id);
+  {
+    std::lock_guard lock(metric.write_mutex);
+    Lsn lsn = 0;
+    if (wal_) {
+      lsn = wal_->Append(id, input);
+    }
+    metric.storage.Write(input, lsn);
+  }
+  CheckMemtablesBudget();
+  WaitForMemtablesBudget();
+
+  // segments are deleted only when a new one is started, as the current one
+  // isn't flushed for sure
+  if (wal_ && wal_->GetSegmentsNum() != wal_segments_num_) {
+    TruncateWal();
+  }
+}
+
+void Storage::ReplayWal() {
+  if (!wal_) {
+    return;
+  }
+  std::unordered_map<MetricId, std::vector<Wal::Record>> metrics_records;
+  for (auto& record : wal_->Recover()) {
+    auto& shard = shards_[record.metric_id % kShardsNum];
+    auto it = shard.metrics.find(record.metric_id);
+    if (it == shard.metrics.end()) {
+      throw std::runtime_error("WAL has records of unknown metric with id " +
+                               std::to_string(record.metric_id));
+    }
+    if (record.lsn <= it->second.storage.GetFlushedLsn()) {
+      continue;
+    }
+    metrics_records[record.metric_id].push_back(std::move(record));
+  }
+
+  std::latch replayed(metrics_records.size());
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  for (const auto& [id, records] : metrics_records) {
+    auto replay = [&, id] {
+      try {
+        auto& metric = GetMetric(id);
+        for (const auto& record : records) {
+          metric.storage.Write(record.time_series, record.lsn);
+          CheckMemtablesBudget();
+        }
+      } catch (...) {
+        std::lock_guard lock(error_mutex);
+        error = std::current_exception();
+      }
+      replayed.count_down();
+    };
+    if (executor_) {
+      executor_->Submit(replay);
+    } else {
+      replay();
+    }
   }
-  it->second.Write(input);
+  replayed.wait();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  wal_segments_num_ = wal_->GetSegmentsNum();
 }
 
 Column Storage::Read(MetricId id, const TimeRange& time_range,
                      AggregationType aggregation_type) const {
-  auto it = metrics_.find(id);
-  if (it == metrics_.end()) {
-    throw std::runtime_error("Metric with id " + std::to_string(id) +
-                             " not found");
+  return GetMetric(id).storage.Read(time_range, aggregation_type);
+}
+
+Column Storage::ReadGroup(std::span<const MetricId> metric_ids,
+                         const TimeRange& time_range,
+                         AggregationType aggregation_type,
+                         Duration window) const {
+  if (aggregation_type == AggregationType::kNone) {
+    throw std::runtime_error("Raw values can't be read by groups");
+  }
+  // avg of the group is the sum of all metrics divided by their count
+  bool is_avg = aggregation_type == AggregationType::kAvg;
+  std::vector<StoredAggregationType> aggregation_types;
+  if (is_avg) {
+    aggregation_types = {StoredAggregationType::kSum,
+                         StoredAggregationType::kCount};
+  } else {
+    aggregation_types = {ToStoredAggregationType(aggregation_type)};
+  }
+
+  // the first part is read by the caller, others by the executor. There are
+  // no more parts than executor threads, as the caller waits anyway
+  size_t parts_num = 1;
+  if (executor_) {
+    parts_num = std::clamp<size_t>(
+        (metric_ids.size() + kGroupTaskSize - 1) / kGroupTaskSize, 1,
+        executor_->GetThreadsNum());
+  }
+  size_t part_size = (metric_ids.size() + parts_num - 1) / parts_num;
+  std::vector<Columns> parts(parts_num);
+  std::latch read(parts_num - 1);
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  auto read_part = [&](size_t idx) {
+    auto begin = std::min(idx * part_size, metric_ids.size());
+    auto end = std::min(begin + part_size, metric_ids.size());
+    parts[idx] = ReadGroupPart(metric_ids.subspan(begin, end - begin),
+                               time_range, aggregation_types, window);
+  };
+  for (size_t i = 1; i < parts_num; ++i) {
+    executor_->Submit([&, i] {
+      try {
+        read_part(i);
+      } catch (...) {
+        std::lock_guard lock(error_mutex);
+        error = std::current_exception();
+      }
+      read.count_down();
+    });
+  }
+  try {
+    read_part(0);
+  } catch (...) {
+    std::lock_guard lock(error_mutex);
+    error = std::current_exception();
+  }
+  read.wait();
+  if (error) {
+    std::rethrow_exception(error);
   }
-  return it->second.Read(time_range, aggregation_type);
+
+  Columns result = std::move(parts.front());
+  if (parts_num > 1) {
+    for (size_t i = 0; i < aggregation_types.size(); ++i) {
+      Columns columns{std::move(result[i])};
+      for (size_t j = 1; j < parts_num; ++j) {
+        columns.push_back(std::move(parts[j][i]));
+      }
+      result[i] = MergeTree(std::move(columns));
+    }
+  }
+  if (!is_avg) {
+    return result.front();
+  }
+  if (!result[0] || !result[1]) {
+    return {};
+  }
+  return std::make_shared<AvgColumn>(
+      std::dynamic_pointer_cast<SumColumn>(result[0]),
+      std::dynamic_pointer_cast<CountColumn>(result[1]));
 }
 
 void Storage::Flush() {
-  for (auto& [_, metric] : metrics_) {
-    metric.Flush();
+  memtables_flush_task_.Wait();
+  auto metrics = GetMetrics();
+  for (auto [_, metric] : metrics) {
+    metric->storage.Flush();
+  }
+  // so that flushed data is already in its final levels
+  for (auto [_, metric] : metrics) {
+    metric->storage.WaitForCompaction();
+  }
+  TruncateWal();
+}
+
+PageCache::Stats Storage::GetPageCacheStats() const {
+  if (!page_cache_) {
+    return {};
+  }
+  return page_cache_->GetStats();
+}
+
+size_t Storage::GetMemtablesBytesSize() const {
+  return memtables_bytes_size_ ? memtables_bytes_size_->load() : 0;
+}
+
+Storage::Metric& Storage::GetMetric(MetricId metric_id) {
+  return const_cast<Metric&>(std::as_const(*this).GetMetric(metric_id));
+}
+
+const Storage::Metric& Storage::GetMetric(MetricId metric_id) const {
+  const auto& shard = shards_[metric_id % kShardsNum];
+  std::shared_lock lock(shard.mutex);
+  auto it = shard.metrics.find(metric_id);
+  if (it == shard.metrics.end()) {
+    throw std::runtime_error("Metric with id " + std::to_string(metric_id) +
+                             " not found");
+  }
+  return it->second;
+}
+
+std::vector<std::pair<MetricId, Storage::Metric*>> Storage::GetMetrics() {
+  std::vector<std::pair<MetricId, Metric*>> metrics;
+  for (auto& shard : shards_) {
+    std::shared_lock lock(shard.mutex);
+    for (auto& [id, metric] : shard.metrics) {
+      metrics.emplace_back(id, &metric);
+    }
   }
+  return metrics;
+}
+
+std::shared_ptr<const MetricStorage::Options> Storage::ShareOptions(
+    const MetricStorage::Options& options) {
+  std::lock_guard lock(metric_options_mutex_);
+  auto it = std::ranges::find(
+      metric_options_, options,
+      [](const auto& shared) -> const auto& { return *shared; });
+  if (it != metric_options_.end()) {
+    return *it;
+  }
+  return metric_options_.emplace_back(
+      std::make_shared<const MetricStorage::Options>(options));
+}
+
+void Storage::AddMetric(MetricId metric_id,
+                        const MetricStorage::Options& options, Labels labels) {
+  // levels of every metric have their own manifest, so it's kept apart from
+  // shared options
+  auto metric_manifest_path =
+      options.persistent_storage_manager_options.manifest_path;
+  if (manifest_path_) {
+    metric_manifest_path = GetMetricManifestPath(metric_id).string();
+  }
+  auto shared_options = ShareOptions(options);
+  {
+    auto& shard = shards_[metric_id % kShardsNum];
+    std::unique_lock lock(shard.mutex);
+    shard.metrics.try_emplace(metric_id, std::move(shared_options),
+                              std::move(metric_manifest_path));
+  }
+  // after the metric, so that selected ids can be read right away
+  if (!labels.empty()) {
+    catalog_.Add(std::move(labels), metric_id);
+  }
+}
+
+Columns Storage::ReadGroupPart(
+    std::span<const MetricId> metric_ids, const TimeRange& time_range,
+    const std::vector<StoredAggregationType>& aggregation_types,
+    Duration window) const {
+  // metrics are planned in id order, so that concurrent reads take their locks
+  // in the same order
+  std::vector<MetricId> sorted_ids(metric_ids.begin(), metric_ids.end());
+  std::ranges::sort(sorted_ids);
+  std::vector<MetricStorage::PlannedRead> plans;
+  plans.reserve(sorted_ids.size());
+  for (auto metric_id : sorted_ids) {
+    plans.push_back(
+        GetMetric(metric_id).storage.PlanRead(time_range, aggregation_types));
+  }
+
+  // pages of metrics, that share the storage, are read with one batch
+  std::map<std::pair<IPersistentStorage*, PageCache*>, std::vector<size_t>>
+      batches;
+  for (size_t i = 0; i < plans.size(); ++i) {
+    const auto& levels = plans[i].levels;
+    if (levels && !levels->page_ids.empty()) {
+      batches[{levels->storage, levels->page_cache}].push_back(i);
+    }
+  }
+  std::vector<Columns> pages(plans.size());
+  for (const auto& [key, batch] : batches) {
+    std::vector<PageId> page_ids;
+    std::vector<ColumnType> page_types;
+    for (auto i : batch) {
+      const auto& levels = *plans[i].levels;
+      page_ids.insert(page_ids.end(), levels.page_ids.begin(),
+                      levels.page_ids.end());
+      page_types.insert(page_types.end(), levels.page_types.begin(),
+                        levels.page_types.end());
+    }
+    auto batch_pages =
+        Level::LoadPages(*key.first, key.second, page_ids, page_types);
+    auto it = batch_pages.begin();
+    for (auto i : batch) {
+      auto pages_num = plans[i].levels->page_ids.size();
+      pages[i].assign(std::make_move_iterator(it),
+                      std::make_move_iterator(it + pages_num));
+      it += pages_num;
+    }
+  }
+
+  std::vector<Columns> columns(aggregation_types.size());
+  for (size_t plan_idx = 0; plan_idx < plans.size(); ++plan_idx) {
+    auto metric_columns = MetricStorage::FinishRead(std::move(plans[plan_idx]),
+                                                    pages[plan_idx]);
+    for (size_t i = 0; i < metric_columns.size(); ++i) {
+      if (!metric_columns[i]) {
+        continue;
+      }
+      std::dynamic_pointer_cast<IAggregateColumn>(metric_columns[i])
+          ->ScaleBuckets(window);
+      columns[i].push_back(std::move(metric_columns[i]));
+    }
+  }
+  Columns result;
+  for (auto& type_columns : columns) {
+    result.push_back(MergeTree(std::move(type_columns)));
+  }
+  return result;
+}
+
+Column Storage::MergeTree(Columns columns) {
+  std::erase(columns, nullptr);
+  if (columns.empty()) {
+    return {};
+  }
+  // merged columns must start after the one they are merged into
+  auto start = [](const Column& column) {
+    return std::dynamic_pointer_cast<IReadColumn>(column)
+        ->GetTimeRange()
+        .start;
+  };
+  std::ranges::sort(columns, {}, start);
+  for (size_t step = 1; step < columns.size(); step *= 2) {
+    for (size_t i = 0; i + step < columns.size(); i += 2 * step) {
+      columns[i]->Merge(std::move(columns[i + step]));
+    }
+  }
+  return columns.front();
+}
+
+void Storage::CheckMemtablesBudget() {
+  if (!memtables_bytes_size_ ||
+      *memtables_bytes_size_ <= *max_memtables_bytes_size_) {
+    return;
+  }
+  memtables_flush_task_.RethrowError();
+  memtables_flush_task_.Schedule();
+}
+
+void Storage::WaitForMemtablesBudget() {
+  while (memtables_bytes_size_ &&
+         *memtables_bytes_size_ >
+             kMaxMemtablesBudgets * *max_memtables_bytes_size_) {
+    // the flush could have finished before the last writes, so it's scheduled
+    // once more
+    memtables_flush_task_.Schedule();
+    memtables_flush_task_.Wait();
+  }
+}
+
+void Storage::FlushLargestMemtables() {
+  std::unique_lock lock(memtables_flush_mutex_, std::try_to_lock);
+  // the running flush frees the budget anyway
+  if (!lock) {
+    return;
+  }
+  size_t bytes_size = *memtables_bytes_size_;
+  if (bytes_size <= *max_memtables_bytes_size_) {
+    return;
+  }
+  using FlushedMetric = std::pair<MetricId, MetricStorage*>;
+  std::vector<std::pair<size_t, FlushedMetric>> metrics;
+  for (auto [id, metric] : GetMetrics()) {
+    if (auto metric_bytes_size = metric->storage.GetUnflushedBytesSize()) {
+      metrics.push_back({metric_bytes_size, {id, &metric->storage}});
+    }
+  }
+  // the largest memtables free the most memory with the fewest pages
+  std::ranges::sort(metrics, std::greater{},
+                    [](const auto& metric) { return metric.first; });
+
+  // half of the budget is freed, so that a flush writes many memtables at once
+  // and writers don't start a new one right after it
+  std::unordered_map<IPersistentStorage*, std::vector<FlushedMetric>>
+      storages_metrics;
+  for (auto [metric_bytes_size, metric] : metrics) {
+    if (bytes_size <= *max_memtables_bytes_size_ / 2) {
+      break;
+    }
+    bytes_size -= std::min(bytes_size, metric_bytes_size);
+    const auto& storage =
+        metric.second->GetOptions().persistent_storage_manager_options.storage;
+    storages_metrics[storage.get()].push_back(metric);
+  }
+
+  for (auto& [storage, storage_metrics] : storages_metrics) {
+    // flush locks of metrics are always taken in the same order
+    std::ranges::sort(storage_metrics, {}, &FlushedMetric::second);
+    Level::PageWrites writes;
+    std::vector<MetricStorage::PreparedFlush> prepared;
+    prepared.reserve(storage_metrics.size());
+    for (auto [_, metric] : storage_metrics) {
+      prepared.push_back(metric->PrepareFlush(writes));
+    }
+    storage->WriteMany(writes.page_ids, writes.pages);
+    for (size_t i = 0; i < storage_metrics.size(); ++i) {
+      storage_metrics[i].second->CommitFlush(prepared[i]);
+    }
+    if (levels_journal_) {
+      std::vector<CompressedBytes> records;
+      records.reserve(storage_metrics.size());
+      for (auto [id, metric] : storage_metrics) {
+        auto& record = records.emplace_back();
+        Append(record, id);
+        auto manifest = metric->SnapshotManifest();
+        record.insert(record.end(), manifest.begin(), manifest.end());
+      }
+      // one sync for all metrics after their snapshots, so that it also covers
+      // pages of merges, that were committed before them
+      storage->Sync();
+      for (size_t i = 0; i < storage_metrics.size(); ++i) {
+        levels_journal_->Append(records[i]);
+        journaled_metrics_.insert(storage_metrics[i].first);
+      }
+      // one sync for manifests of all metrics
+      levels_journal_->Sync();
+    }
+    for (size_t i = 0; i < storage_metrics.size(); ++i) {
+      storage_metrics[i].second->FinishFlush(std::move(prepared[i]),
+                                             levels_journal_ != nullptr);
+    }
+  }
+  CheckpointLevels();
+}
+
+void Storage::CheckpointLevels() {
+  if (!levels_journal_ ||
+      levels_journal_->GetSize() < kMaxLevelsJournalSize) {
+    return;
+  }
+  // own manifests get newer versions, than the journaled ones
+  for (auto id : journaled_metrics_) {
+    GetMetric(id).storage.SaveManifest();
+  }
+  levels_journal_->Reset();
+  journaled_metrics_.clear();
+}
+
+void Storage::TruncateWal() {
+  if (!wal_) {
+    return;
+  }
+  std::lock_guard lock(truncate_mutex_);
+  // records appended after it are newer than the bound, so they are kept,
+  // even if they aren't in memtables yet
+  auto lsn = wal_->GetNextLsn();
+  for (auto [_, metric] : GetMetrics()) {
+    // waits for the write, that could have appended an older record, but
+    // hasn't written it to the memtable yet
+    std::lock_guard write_lock(metric->write_mutex);
+    if (auto metric_lsn = metric->storage.GetUnflushedLsn()) {
+      lsn = std::min(lsn, *metric_lsn);
+    }
+  }
+  wal_->Truncate(lsn);
+  wal_segments_num_ = wal_->GetSegmentsNum();
+}
+
+void Storage::SaveMetric(MetricId metric_id,
+                         const MetricStorage::Options& options,
+                         const Labels& labels) {
+  CompressedBytes record;
+  Append(record, metric_id);
+  AppendOptions(record, options);
+  Append(record, static_cast<uint64_t>(labels.size()));
+  for (const auto& label : labels) {
+    AppendString(record, label.name);
+    AppendString(record, label.value);
+  }
+  metrics_journal_->Append(record);
+}
+
+void Storage::SyncMetrics() {
+  if (metrics_journal_) {
+    metrics_journal_->Sync();
+  }
+}
+
+void Storage::RestoreManifest(const Options& options) {
+  metrics_journal_ =
+      std::make_unique<Journal>(*manifest_path_ / kMetricsJournalName);
+  for (const auto& record : metrics_journal_->Recover()) {
+    CompressedBytesReader reader(record);
+    auto id = reader.Read<MetricId>();
+    auto metric_options = ReadOptions(reader);
+    auto& persistent_storage_manager_options =
+        metric_options.persistent_storage_manager_options;
+    persistent_storage_manager_options.storage = options.persistent_storage;
+    persistent_storage_manager_options.executor = options.compaction_executor;
+    persistent_storage_manager_options.page_cache = page_cache_;
+    metric_options.flush_executor = options.flush_executor;
+    metric_options.memtables_bytes_size = memtables_bytes_size_;
+    Labels labels(reader.Read<uint64_t>());
+    for (auto& label : labels) {
+      label.name = ReadString(reader);
+      label.value = ReadString(reader);
+    }
+    // ids of concurrent inits are journaled out of order
+    next_id_ = std::max<size_t>(next_id_, id + 1);
+    // levels are restored from their own manifest
+    AddMetric(id, metric_options, std::move(labels));
+  }
+
+  levels_journal_ =
+      std::make_unique<Journal>(*manifest_path_ / kLevelsJournalName);
+  for (const auto& record : levels_journal_->Recover()) {
+    CompressedBytesReader reader(record);
+    auto id = reader.Read<MetricId>();
+    // newer, than the own manifest of the metric, only if it isn't saved
+    // after the flush
+    GetMetric(id).storage.RestoreManifest(
+        CompressedBytes(record.begin() + sizeof(MetricId), record.end()));
+    journaled_metrics_.insert(id);
+  }
+}
+
+std::filesystem::path Storage::GetMetricManifestPath(MetricId metric_id) const {
+  return *manifest_path_ /
+         ("metric-" + std::to_string(metric_id) + ".manifest");
 }
 
 }  // namespace tskv
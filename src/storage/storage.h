@@ -1,26 +1,193 @@
 #pragma once
 
+#include "../cache/page_cache.h"
+#include "../catalog/series_catalog.h"
+#include "../executor/background_task.h"
+#include "../executor/executor.h"
+#include "../manifest/manifest.h"
 #include "../metric-storage/metric_storage.h"
+#include "../wal/wal.h"
 #include "model/model.h"
 
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace tskv {
 
-using MetricId = uint64_t;
-
+// Thread safe: metrics can be initialized, written and read concurrently.
+// Metrics are split into shards by id with their own locks, that are held
+// only to find a metric, so writers and readers of different metrics don't
+// wait for each other.
+//
+// Metrics can be initialized with labels of their series, then their ids are
+// found by labels or selectors with the series catalog.
 class Storage {
  public:
+  struct Options {
+    // writes are logged before they go to memtables, if set
+    std::optional<Wal::Options> wal;
+    // WAL of different metrics is replayed and metrics of ReadGroup are read
+    // in parallel, if set
+    std::shared_ptr<Executor> executor;
+
+    // directory, where metrics and their levels are saved after every change
+    // and restored from on start, if set
+    std::optional<std::string> manifest_path;
+    // restored metrics use them, as they can't be saved
+    std::shared_ptr<IPersistentStorage> persistent_storage;
+    std::shared_ptr<Executor> compaction_executor;
+    std::shared_ptr<Executor> flush_executor;
+
+    // decoded pages of all metrics are cached in one cache, if set
+    std::optional<PageCache::Options> page_cache;
+
+    // memtables of all metrics take about that many bytes at most, if set.
+    // When they take more, the largest ones are flushed by flush_executor
+    // until half of the budget is free, and pages of metrics sharing storage
+    // are written with one batch. Writes wait for the flush, if memtables take
+    // twice the budget, as flushes can't keep up with them then. Limits of
+    // memtables of metrics apply too
+    std::optional<size_t> max_memtables_bytes_size;
+  };
+
+ public:
+  Storage() = default;
+  explicit Storage(const Options& options);
   MetricId InitMetric(const MetricStorage::Options& options);
+  // returns the id of the series with these labels, the metric is initialized
+  // only if there is no such series yet. Labels are saved to the manifest
+  MetricId InitMetric(Labels labels, const MetricStorage::Options& options);
+  std::optional<MetricId> FindMetric(Labels labels) const;
+  // ids of series matching the selector in ascending order, see
+  // ParseSelector
+  std::vector<MetricId> SelectMetrics(std::string_view selector) const;
+  // replays WAL left by the previous run, must be called after all metrics
+  // are initialized and before writes
+  void ReplayWal();
   Column Read(MetricId metric_id, const TimeRange& time_range,
               AggregationType aggregation_type) const;
+  // reads metrics in parallel, scales them to window buckets and merges them
+  // into one column, like dashboard group by queries do. Window must be a
+  // multiple of bucket intervals of all metrics, raw values aren't supported
+  Column ReadGroup(std::span<const MetricId> metric_ids,
+                   const TimeRange& time_range,
+                   AggregationType aggregation_type, Duration window) const;
 
   void Write(MetricId metric_id, const InputTimeSeries& time_series);
   void Flush();
+  // hits and misses of the page cache, zeros if there is no cache
+  PageCache::Stats GetPageCacheStats() const;
+  // bytes of memtables of all metrics, that aren't flushed yet. Counted only
+  // with max_memtables_bytes_size
+  size_t GetMemtablesBytesSize() const;
+
+ private:
+  struct Metric {
+    Metric(std::shared_ptr<const MetricStorage::Options> options,
+           std::optional<std::string> manifest_path);
+
+    MetricStorage storage;
+    // WAL append and memtable write of a metric are done under it, so its
+    // records get to memtables in lsn order
+    std::mutex write_mutex;
+  };
+
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    // metrics are never removed, so references to them stay valid
+    std::unordered_map<MetricId, Metric> metrics;
+  };
+
+  static constexpr size_t kShardsNum = 16;
+  // metrics of ReadGroup, that are read by one task
+  static constexpr size_t kGroupTaskSize = 4;
+
+ private:
+  // throws if there is no such metric
+  Metric& GetMetric(MetricId metric_id);
+  const Metric& GetMetric(MetricId metric_id) const;
+  std::vector<std::pair<MetricId, Metric*>> GetMetrics();
+  MetricId CreateMetric(const MetricStorage::Options& options, Labels labels);
+  // metrics with equal options share them
+  std::shared_ptr<const MetricStorage::Options> ShareOptions(
+      const MetricStorage::Options& options);
+  void AddMetric(MetricId metric_id, const MetricStorage::Options& options,
+                 Labels labels);
+  // reads and scales metrics, result[i] is the merge of aggregation_types[i].
+  // Pages of all metrics, that share the storage, are read with one batch
+  Columns ReadGroupPart(
+      std::span<const MetricId> metric_ids, const TimeRange& time_range,
+      const std::vector<StoredAggregationType>& aggregation_types,
+      Duration window) const;
+  // merges columns pairwise, so that merged columns stay small
+  static Column MergeTree(Columns columns);
+  // schedules flush of the largest memtables, if they are over the budget
+  void CheckMemtablesBudget();
+  // waits for flushes, while memtables take several budgets. Only writers
+  // wait, as WAL replay runs on the executor
+  void WaitForMemtablesBudget();
+  void FlushLargestMemtables();
+  // deletes WAL segments, that are already flushed by all metrics
+  void TruncateWal();
+  // appends the new metric to the journal, it's durable after SyncMetrics
+  void SaveMetric(MetricId metric_id, const MetricStorage::Options& options,
+                  const Labels& labels);
+  // makes initialized metrics durable before their WAL records are,
+  // concurrent inits share one sync
+  void SyncMetrics();
+  // saves manifests of levels of journaled metrics to their own files, so
+  // that the levels journal can be reset, if it's too big
+  void CheckpointLevels();
+  void RestoreManifest(const Options& options);
+  std::filesystem::path GetMetricManifestPath(MetricId metric_id) const;
 
  private:
-  std::unordered_map<MetricId, MetricStorage> metrics_;
-  size_t next_id_ = 0;
+  std::array<Shard, kShardsNum> shards_;
+  std::atomic<size_t> next_id_{0};
+  std::unique_ptr<Wal> wal_;
+  std::atomic<size_t> wal_segments_num_{0};
+  // only one writer truncates WAL, the others skip it
+  std::mutex truncate_mutex_;
+  std::shared_ptr<Executor> executor_;
+  std::shared_ptr<PageCache> page_cache_;
+  SeriesCatalog catalog_;
+  // concurrent inits of one series create only one metric
+  std::mutex init_mutex_;
+  // distinct options of metrics, there are few of them
+  std::vector<std::shared_ptr<const MetricStorage::Options>> metric_options_;
+  std::mutex metric_options_mutex_;
+  std::optional<std::filesystem::path> manifest_path_;
+  // metrics are only added, so each one is appended there once instead of
+  // rewriting all of them
+  std::unique_ptr<Journal> metrics_journal_;
+  // manifests of levels of metrics flushed by one memtables flush are
+  // appended there with one sync instead of writing a file for each metric.
+  // Restore picks the newest of it and the own manifest of the metric
+  std::unique_ptr<Journal> levels_journal_;
+  // metrics with manifests in the levels journal, guarded by
+  // memtables_flush_mutex_
+  std::unordered_set<MetricId> journaled_metrics_;
+  std::optional<size_t> max_memtables_bytes_size_;
+  // shared by all metrics, if there is a budget
+  std::shared_ptr<std::atomic<size_t>> memtables_bytes_size_;
+  // a flush holds flush locks of many metrics, so flushes of different
+  // writers mustn't run at once
+  std::mutex memtables_flush_mutex_;
+  // last, so that it's destroyed before metrics it flushes
+  BackgroundTask memtables_flush_task_{nullptr,
+                                       [this] { FlushLargestMemtables(); }};
 };
 
 }  // namespace tskv
@@ -143,9 +143,43 @@ TEST(SumColumn, Read) {
               tskv::TimeRange(6, 10));
     EXPECT_EQ(column.Read(tskv::TimeRange(6, 9))->GetType(),
               tskv::ColumnType::kSum);
+
+    // ends before the column
+    EXPECT_FALSE(column.Read(tskv::TimeRange(0, 1)));
+    EXPECT_FALSE(column.Read(tskv::TimeRange(0, 2)));
   }
 }
 
+TEST(SumColumn, ReadIsCopyOnWrite) {
+  tskv::SumColumn column(std::vector<double>{1, 2, 3, 4, 5}, tskv::TimePoint(1),
+                         1);
+  auto read_column = std::static_pointer_cast<tskv::SumColumn>(
+      column.Read(tskv::TimeRange(2, 5)));
+
+  column.Write({{2, 10}, {6, 1}});
+  auto expected = std::vector<double>{2, 3, 4};
+  EXPECT_EQ(read_column->GetValues(), expected);
+  expected = std::vector<double>{1, 12, 3, 4, 5, 1};
+  EXPECT_EQ(column.GetValues(), expected);
+
+  std::shared_ptr<tskv::IReadColumn> column_to_merge =
+      std::make_shared<tskv::SumColumn>(std::vector<double>{1, 1},
+                                        tskv::TimePoint(4), 1);
+  read_column->Merge(column_to_merge);
+  expected = std::vector<double>{2, 3, 5, 1};
+  EXPECT_EQ(read_column->GetValues(), expected);
+  expected = std::vector<double>{1, 12, 3, 4, 5, 1};
+  EXPECT_EQ(column.GetValues(), expected);
+
+  read_column = std::static_pointer_cast<tskv::SumColumn>(
+      column.Read(tskv::TimeRange(1, 7)));
+  read_column->ScaleBuckets(2);
+  expected = std::vector<double>{1, 15, 9, 1};
+  EXPECT_EQ(read_column->GetValues(), expected);
+  expected = std::vector<double>{1, 12, 3, 4, 5, 1};
+  EXPECT_EQ(column.GetValues(), expected);
+}
+
 TEST(SumColumn, Merge) {
   {
     tskv::SumColumn column1(std::vector<double>{1, 2, 3, 4, 5},
@@ -170,6 +204,17 @@ TEST(SumColumn, Merge) {
     EXPECT_EQ(column1.GetValues(), expected);
     EXPECT_EQ(column1.GetTimeRange(), tskv::TimeRange(3, 15));
   }
+  {
+    tskv::SumColumn column1(std::vector<double>{1, 2}, tskv::TimePoint(2), 1);
+    tskv::SumColumn column2(std::vector<double>{10, 20, 30},
+                            tskv::TimePoint(2), 1);
+    std::shared_ptr<tskv::IReadColumn> column2_read =
+        std::make_shared<tskv::SumColumn>(column2);
+    column1.Merge(column2_read);
+    auto expected = std::vector<double>{11, 22, 30};
+    EXPECT_EQ(column1.GetValues(), expected);
+    EXPECT_EQ(column1.GetTimeRange(), tskv::TimeRange(2, 5));
+  }
 }
 
 TEST(SumColumn, Extract) {
@@ -208,6 +253,31 @@ TEST(SumColumn, FromBytes) {
   EXPECT_EQ(sum_column->GetTimeRange(), tskv::TimeRange(45, 120));
 }
 
+TEST(SumColumn, FromSharedBytes) {
+  auto bytes = std::make_shared<const std::vector<uint8_t>>(
+      std::vector<uint8_t>{
+          15, 0, 0, 0, 0, 0, 0, 0,
+          45, 0, 0, 0, 0, 0, 0, 0,
+          0, 0, 0, 0, 0, 0, 240, 63,
+          0, 0, 0, 0, 0, 0, 0, 64,
+          0, 0, 0, 0, 0, 0, 8, 64,
+          0, 0, 0, 0, 0, 0, 16, 64,
+          0, 0, 0, 0, 0, 0, 20, 64});
+  auto sum_column = std::static_pointer_cast<tskv::SumColumn>(
+      std::static_pointer_cast<tskv::IReadColumn>(
+          tskv::FromBytes(*bytes, tskv::ColumnType::kSum, bytes)));
+  // column is a view over the bytes
+  EXPECT_EQ(bytes.use_count(), 2);
+  auto expected = std::vector<double>{1, 2, 3, 4, 5};
+  EXPECT_EQ(sum_column->GetValues(), expected);
+
+  sum_column->Write({{45, 1}});
+  expected = std::vector<double>{2, 2, 3, 4, 5};
+  EXPECT_EQ(sum_column->GetValues(), expected);
+  EXPECT_EQ(bytes.use_count(), 1);
+  EXPECT_EQ((*bytes)[22], 240);
+}
+
 TEST(SumColumn, ScaleBuckets) {
   {
     tskv::SumColumn column(std::vector<double>{1, 2, 3, 4, 5},
@@ -606,6 +676,16 @@ TEST(MinColumn, Merge) {
     EXPECT_EQ(column1.GetValues(), expected);
     EXPECT_EQ(column1.GetTimeRange(), tskv::TimeRange(3, 15));
   }
+  {
+    tskv::MinColumn column1(std::vector<double>{5}, tskv::TimePoint(1), 1);
+    tskv::MinColumn column2(std::vector<double>{7}, tskv::TimePoint(3), 1);
+    std::shared_ptr<tskv::IReadColumn> column2_read =
+        std::make_shared<tskv::MinColumn>(column2);
+    column1.Merge(column2_read);
+    auto expected =
+        std::vector<double>{5, std::numeric_limits<double>::max(), 7};
+    EXPECT_EQ(column1.GetValues(), expected);
+  }
 }
 
 TEST(MinColumn, Extract) {
@@ -1175,12 +1255,24 @@ TEST(RawTimestamps, Extract) {
 }
 
 TEST(RawTimestamps, ToBytes) {
-  tskv::RawTimestampsColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5});
-  auto bytes = column.ToBytes();
-  auto expected = std::vector<uint8_t>{1, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0,
-                                       0, 0, 3, 0, 0, 0, 0, 0, 0, 0, 4, 0, 0, 0,
-                                       0, 0, 0, 0, 5, 0, 0, 0, 0, 0, 0, 0};
-  EXPECT_EQ(bytes, expected);
+  {
+    tskv::RawTimestampsColumn column(std::vector<uint64_t>{1, 2, 3, 4, 5});
+    auto bytes = column.ToBytes();
+    EXPECT_EQ(tskv::GetPageFormat(bytes), tskv::PageFormat::kRegular);
+    auto column_from_bytes =
+        tskv::FromBytes(bytes, tskv::ColumnType::kRawTimestamps);
+    auto expected = std::vector<double>{1, 2, 3, 4, 5};
+    EXPECT_EQ(column_from_bytes->GetValues(), expected);
+  }
+  {
+    tskv::RawTimestampsColumn column(std::vector<uint64_t>{1, 2, 2, 4, 9});
+    auto bytes = column.ToBytes();
+    EXPECT_EQ(tskv::GetPageFormat(bytes), tskv::PageFormat::kDeltaOfDelta);
+    auto column_from_bytes =
+        tskv::FromBytes(bytes, tskv::ColumnType::kRawTimestamps);
+    auto expected = std::vector<double>{1, 2, 2, 4, 9};
+    EXPECT_EQ(column_from_bytes->GetValues(), expected);
+  }
 }
 
 TEST(RawTimestamps, FromBytes) {
@@ -1200,6 +1292,36 @@ TEST(RawTimestamps, GetTimeRange) {
   EXPECT_EQ(column.GetTimeRange(), tskv::TimeRange(1, 10));
 }
 
+TEST(RawTimestamps, LowerBound) {
+  {
+    tskv::RawTimestampsColumn column(std::vector<uint64_t>{1, 2, 4, 6, 8, 9});
+    EXPECT_EQ(column.LowerBound(0), 0);
+    EXPECT_EQ(column.LowerBound(3), 2);
+    EXPECT_EQ(column.LowerBound(9), 5);
+    EXPECT_EQ(column.LowerBound(10), 6);
+  }
+  {
+    tskv::RawTimestampsColumn column;
+    column.Write({{10, 1}, {20, 1}, {30, 1}});
+    column.Write({{40, 1}, {50, 1}});
+    EXPECT_EQ(column.LowerBound(0), 0);
+    EXPECT_EQ(column.LowerBound(10), 0);
+    EXPECT_EQ(column.LowerBound(11), 1);
+    EXPECT_EQ(column.LowerBound(40), 3);
+    EXPECT_EQ(column.LowerBound(50), 4);
+    EXPECT_EQ(column.LowerBound(51), 5);
+
+    column.Write({{55, 1}});
+    EXPECT_EQ(column.LowerBound(51), 5);
+    EXPECT_EQ(column.LowerBound(56), 6);
+  }
+  {
+    tskv::RawTimestampsColumn column(std::vector<uint64_t>{7, 7, 7});
+    EXPECT_EQ(column.LowerBound(7), 0);
+    EXPECT_EQ(column.LowerBound(8), 3);
+  }
+}
+
 TEST(RawValues, Basic) {
   tskv::RawValuesColumn column(std::vector<double>{1, 2, 3, 4, 5});
   EXPECT_EQ(column.GetType(), tskv::ColumnType::kRawValues);
@@ -1238,10 +1360,12 @@ TEST(RawValues, Extract) {
 TEST(RawValues, ToBytes) {
   tskv::RawValuesColumn column(std::vector<double>{1, 2, 3, 4, 5});
   auto bytes = column.ToBytes();
-  auto expected = std::vector<uint8_t>{
-      0, 0, 0, 0,  0, 0, 240, 63, 0, 0, 0,  0,  0, 0, 0, 64, 0, 0, 0,  0,
-      0, 0, 8, 64, 0, 0, 0,   0,  0, 0, 16, 64, 0, 0, 0, 0,  0, 0, 20, 64};
-  EXPECT_EQ(bytes, expected);
+  EXPECT_EQ(tskv::GetPageFormat(bytes), tskv::PageFormat::kGorilla);
+  EXPECT_LT(bytes.size(), 5 * sizeof(double));
+  auto column_from_bytes =
+      tskv::FromBytes(bytes, tskv::ColumnType::kRawValues);
+  auto expected = std::vector<double>{1, 2, 3, 4, 5};
+  EXPECT_EQ(column_from_bytes->GetValues(), expected);
 }
 
 TEST(RawValues, FromBytes) {
@@ -1453,3 +1577,38 @@ TEST(AvgColumn, Read) {
               tskv::ColumnType::kAvg);
   }
 }
+
+TEST(MultiAggregateColumn, Write) {
+  std::vector<tskv::ColumnType> types{
+      tskv::ColumnType::kSum, tskv::ColumnType::kCount, tskv::ColumnType::kMin,
+      tskv::ColumnType::kMax, tskv::ColumnType::kLast};
+  tskv::MultiAggregateColumn column(types, 3);
+  column.Write(tskv::InputTimeSeries{{4, 1}, {5, 5}, {7, 2}});
+  auto shared = column.GetColumn(tskv::ColumnType::kSum);
+  column.Write(tskv::InputTimeSeries{{8, -1}, {13, 4}});
+  EXPECT_EQ(column.GetTimeRange(), tskv::TimeRange(3, 15));
+  // column returned before the second write isn't changed
+  EXPECT_EQ(shared->GetValues(), (std::vector<double>{6, 2}));
+
+  std::vector<std::vector<double>> expected{
+      {6, 1, 0, 4},
+      {2, 2, 0, 1},
+      {1, -1, std::numeric_limits<double>::max(), 4},
+      {5, 2, std::numeric_limits<double>::lowest(), 4},
+      {5, -1, 0, 4},
+  };
+  for (size_t i = 0; i < types.size(); ++i) {
+    auto type_column = column.GetColumn(types[i]);
+    ASSERT_EQ(type_column->GetType(), types[i]);
+    EXPECT_EQ(type_column->GetValues(), expected[i]);
+  }
+
+  auto columns = column.ExtractColumns();
+  ASSERT_EQ(columns.size(), types.size());
+  for (size_t i = 0; i < types.size(); ++i) {
+    EXPECT_EQ(columns[i]->GetType(), types[i]);
+    EXPECT_EQ(columns[i]->GetValues(), expected[i]);
+  }
+  EXPECT_TRUE(column.Empty());
+  EXPECT_FALSE(column.GetColumn(tskv::ColumnType::kAvg));
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include "model/compression.h"
+
+TEST(BitWriter, ReadWrite) {
+  tskv::CompressedBytes bytes;
+  tskv::BitWriter writer(bytes);
+  writer.WriteBit(true);
+  writer.Write(5, 3);
+  writer.Write(0xdeadbeefcafebabe, 64);
+  writer.Write(0, 7);
+  writer.Write(1234567, 40);
+  writer.Flush();
+  EXPECT_EQ(bytes.size(), (1 + 3 + 64 + 7 + 40 + 7) / 8);
+
+  tskv::BitReader reader(bytes);
+  EXPECT_TRUE(reader.ReadBit());
+  EXPECT_EQ(reader.Read(3), 5);
+  EXPECT_EQ(reader.Read(64), 0xdeadbeefcafebabe);
+  EXPECT_EQ(reader.Read(7), 0);
+  EXPECT_EQ(reader.Read(40), 1234567);
+}
+
+TEST(Gorilla, Empty) {
+  tskv::CompressedBytes bytes;
+  tskv::EncodeGorilla(bytes, {});
+  EXPECT_TRUE(tskv::DecodeGorilla(bytes).empty());
+}
+
+TEST(Gorilla, RoundTrip) {
+  std::vector<double> values = {
+      1,    1,   1,    2,      -3.5,  0,      0.1,
+      0.2,  0.3, 1e10, 1e-300, -1e300, 42,    42,
+      std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest(),
+      std::numeric_limits<double>::infinity()};
+  tskv::CompressedBytes bytes;
+  tskv::EncodeGorilla(bytes, values);
+  EXPECT_EQ(tskv::DecodeGorilla(bytes), values);
+}
+
+TEST(Gorilla, RandomWalk) {
+  std::mt19937_64 gen(123);
+  std::uniform_int_distribution<int> step(-3, 3);
+  std::vector<double> values;
+  double value = 50;
+  for (int i = 0; i < 10000; ++i) {
+    value = std::clamp(value + step(gen), 0.0, 100.0);
+    values.push_back(value);
+  }
+  tskv::CompressedBytes bytes;
+  tskv::EncodeGorilla(bytes, values);
+  EXPECT_EQ(tskv::DecodeGorilla(bytes), values);
+  EXPECT_LT(bytes.size() * 3, values.size() * sizeof(double));
+}
+
+TEST(Gorilla, Nan) {
+  std::vector<double> values = {std::nan(""), 1, std::nan("")};
+  tskv::CompressedBytes bytes;
+  tskv::EncodeGorilla(bytes, values);
+  auto decoded = tskv::DecodeGorilla(bytes);
+  ASSERT_EQ(decoded.size(), 3);
+  EXPECT_TRUE(std::isnan(decoded[0]));
+  EXPECT_EQ(decoded[1], 1);
+  EXPECT_TRUE(std::isnan(decoded[2]));
+}
+
+TEST(DeltaOfDelta, RoundTrip) {
+  std::mt19937_64 gen(123);
+  std::uniform_int_distribution<int64_t> jitter(-2000, 2000);
+  std::vector<tskv::TimePoint> timestamps;
+  tskv::TimePoint timestamp = 1451606400000000;
+  for (int i = 0; i < 10000; ++i) {
+    timestamps.push_back(timestamp);
+    timestamp += 1000000 + jitter(gen);
+    if (i % 1000 == 0) {
+      timestamp += 3600000000ull;
+    }
+  }
+  timestamps.push_back(timestamps.back());
+  timestamps.push_back(std::numeric_limits<tskv::TimePoint>::max());
+
+  tskv::CompressedBytes bytes;
+  tskv::EncodeDeltaOfDelta(bytes, timestamps);
+  EXPECT_EQ(tskv::DecodeDeltaOfDelta(bytes), timestamps);
+  EXPECT_LT(bytes.size() * 3, timestamps.size() * sizeof(tskv::TimePoint));
+}
+
+TEST(PageHeader, Format) {
+  tskv::CompressedBytes bytes;
+  EXPECT_EQ(tskv::GetPageFormat(bytes), tskv::PageFormat::kPlain);
+  bytes = {0, 0, 0, 0, 0, 0, 240, 63};
+  EXPECT_EQ(tskv::GetPageFormat(bytes), tskv::PageFormat::kPlain);
+  bytes.clear();
+  tskv::AppendPageHeader(bytes, tskv::PageFormat::kGorilla);
+  EXPECT_EQ(bytes.size(), tskv::kPageHeaderSize);
+  EXPECT_EQ(tskv::GetPageFormat(bytes), tskv::PageFormat::kGorilla);
+}
@@ -0,0 +1,32 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <latch>
+#include <memory>
+
+#include "executor/background_task.h"
+#include "executor/executor.h"
+
+TEST(Executor, TasksScheduleBackgroundTasks) {
+  auto executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = 1, .max_queue_size = 1});
+  std::atomic<int> runs{0};
+  tskv::BackgroundTask background_task(executor, [&] { ++runs; });
+
+  std::latch started(1);
+  std::latch queue_full(1);
+  std::latch scheduled(1);
+  executor->Submit([&] {
+    started.count_down();
+    queue_full.wait();
+    // the only worker is busy with this task, so waiting for the queue would
+    // never end
+    background_task.Schedule();
+    scheduled.count_down();
+  });
+  started.wait();
+  executor->Submit([] {});
+  queue_full.count_down();
+  scheduled.wait();
+  background_task.Wait();
+  EXPECT_EQ(runs, 1);
+}
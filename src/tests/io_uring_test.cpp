@@ -0,0 +1,215 @@
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "persistent-storage/disk_storage.h"
+#include "persistent-storage/io_uring.h"
+#include "persistent-storage/segment_storage.h"
+#include "tests/temp_dir.h"
+
+namespace {
+
+class IoUringTest : public tskv::test::TempDirTest {
+ protected:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    try {
+      ring_ = std::make_unique<tskv::IoUring>(4);
+    } catch (const std::runtime_error&) {
+      GTEST_SKIP() << "io_uring isn't supported";
+    }
+  }
+
+  std::unique_ptr<tskv::IoUring> ring_;
+};
+
+}  // namespace
+
+TEST_F(IoUringTest, Batch) {
+  int fd = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+  ASSERT_GE(fd, 0);
+
+  // more requests than ring entries
+  std::vector<uint8_t> bytes(1000);
+  std::iota(bytes.begin(), bytes.end(), 0);
+  std::vector<iovec> iov;
+  std::vector<tskv::IoUring::Request> requests;
+  for (size_t i = 0; i < 10; ++i) {
+    iov.push_back({bytes.data() + i * 100, 100});
+  }
+  for (size_t i = 0; i < 10; ++i) {
+    requests.push_back({.op = tskv::IoUring::Op::kWrite,
+                        .fd = fd,
+                        .iov = &iov[i],
+                        .iov_num = 1,
+                        .offset = i * 100});
+  }
+  ring_->Submit(requests);
+  for (const auto& request : requests) {
+    EXPECT_EQ(request.result, 100);
+  }
+  tskv::IoUring::Request sync{.op = tskv::IoUring::Op::kSync, .fd = fd};
+  ring_->Submit({&sync, 1});
+  EXPECT_EQ(sync.result, 0);
+
+  std::vector<uint8_t> read(1000);
+  for (size_t i = 0; i < 10; ++i) {
+    // reversed order
+    iov[i] = {read.data() + (9 - i) * 100, 100};
+    requests[i] = {.op = tskv::IoUring::Op::kRead,
+                   .fd = fd,
+                   .iov = &iov[i],
+                   .iov_num = 1,
+                   .offset = (9 - i) * 100};
+  }
+  ring_->Submit(requests);
+  for (const auto& request : requests) {
+    EXPECT_EQ(request.result, 100);
+  }
+  EXPECT_EQ(read, bytes);
+
+  tskv::IoUring::Request bad_read{.op = tskv::IoUring::Op::kRead,
+                                  .fd = -1,
+                                  .iov = iov.data(),
+                                  .iov_num = 1};
+  ring_->Submit({&bad_read, 1});
+  EXPECT_EQ(bad_read.result, -EBADF);
+  ::close(fd);
+}
+
+TEST_F(IoUringTest, ConcurrentSubmits) {
+  int fd = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+  ASSERT_GE(fd, 0);
+  constexpr size_t kThreads = 4;
+  constexpr size_t kRequests = 10;
+  constexpr size_t kSize = 10;
+  std::vector<uint8_t> bytes(kThreads * kRequests * kSize);
+  std::iota(bytes.begin(), bytes.end(), 0);
+  ASSERT_EQ(::pwrite(fd, bytes.data(), bytes.size(), 0), bytes.size());
+
+  // completions of calls, that share the ring, get to their callers
+  std::vector<std::vector<uint8_t>> read(kThreads);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&, i] {
+      for (size_t round = 0; round < 100; ++round) {
+        read[i].assign(kRequests * kSize, 0);
+        std::vector<iovec> iov(kRequests);
+        std::vector<tskv::IoUring::Request> requests(kRequests);
+        for (size_t j = 0; j < kRequests; ++j) {
+          iov[j] = {read[i].data() + j * kSize, kSize};
+          requests[j] = {.op = tskv::IoUring::Op::kRead,
+                         .fd = fd,
+                         .iov = &iov[j],
+                         .iov_num = 1,
+                         .offset = (i * kRequests + j) * kSize};
+        }
+        ring_->Submit(requests);
+        for (const auto& request : requests) {
+          ASSERT_EQ(request.result, kSize);
+        }
+        ASSERT_TRUE(std::equal(read[i].begin(), read[i].end(),
+                               bytes.begin() + i * kRequests * kSize));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ::close(fd);
+}
+
+TEST_F(IoUringTest, ManySmallSubmits) {
+  int fd = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+  ASSERT_GE(fd, 0);
+  constexpr size_t kThreads = 64;
+  constexpr size_t kSize = 8;
+  std::vector<uint8_t> bytes(kThreads * kSize);
+  std::iota(bytes.begin(), bytes.end(), 0);
+  ASSERT_EQ(::pwrite(fd, bytes.data(), bytes.size(), 0), bytes.size());
+
+  // callers often find their requests completed by others, while one of them
+  // waits for completions in the kernel
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < kThreads; ++i) {
+    threads.emplace_back([&, i] {
+      for (size_t round = 0; round < 2000; ++round) {
+        std::vector<uint8_t> read(kSize);
+        iovec iov{read.data(), kSize};
+        tskv::IoUring::Request request{.op = tskv::IoUring::Op::kRead,
+                                       .fd = fd,
+                                       .iov = &iov,
+                                       .iov_num = 1,
+                                       .offset = i * kSize};
+        ring_->Submit({&request, 1});
+        ASSERT_EQ(request.result, kSize);
+        ASSERT_TRUE(std::equal(read.begin(), read.end(),
+                               bytes.begin() + i * kSize));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ::close(fd);
+}
+
+TEST_F(IoUringTest, SegmentStorage) {
+  tskv::SegmentStorage::Options options{
+      .path = path_.string(),
+      .max_segment_size = 1000,
+      .io_uring = true,
+  };
+  std::vector<tskv::PageId> pages;
+  {
+    tskv::SegmentStorage storage(options);
+    for (size_t i = 0; i < 30; ++i) {
+      pages.push_back(storage.CreatePage());
+      storage.Write(pages.back(), tskv::CompressedBytes(100, i));
+      if (i % 2 == 1) {
+        storage.DeletePage(pages.back());
+      }
+    }
+  }
+
+  tskv::SegmentStorage storage(options);
+  std::vector<tskv::PageId> kept;
+  for (size_t i = 0; i < pages.size(); ++i) {
+    if (i % 2 == 1) {
+      EXPECT_THROW(storage.Read(pages[i]), std::runtime_error);
+    } else {
+      EXPECT_EQ(storage.Read(pages[i]), tskv::CompressedBytes(100, i));
+      kept.push_back(pages[i]);
+    }
+  }
+  auto read = storage.ReadMany(kept);
+  for (size_t i = 0; i < kept.size(); ++i) {
+    EXPECT_EQ(tskv::CompressedBytes(read[i].bytes.begin(), read[i].bytes.end()),
+              tskv::CompressedBytes(100, 2 * i));
+  }
+}
+
+TEST_F(IoUringTest, DiskStorage) {
+  tskv::DiskStorage storage({.path = path_.string(), .io_uring = true});
+  std::vector<tskv::PageId> page_ids;
+  std::vector<tskv::CompressedBytes> pages;
+  for (size_t i = 0; i < 10; ++i) {
+    page_ids.push_back(storage.CreatePage());
+    pages.push_back(tskv::CompressedBytes(i * 10, i));
+  }
+  storage.WriteMany(page_ids, pages);
+  auto read = storage.ReadMany(page_ids);
+  for (size_t i = 0; i < pages.size(); ++i) {
+    EXPECT_EQ(tskv::CompressedBytes(read[i].bytes.begin(), read[i].bytes.end()),
+              pages[i]);
+    EXPECT_EQ(storage.Read(page_ids[i]), pages[i]);
+  }
+  storage.DeleteMany(page_ids);
+  EXPECT_THROW(storage.ReadMany(page_ids), std::runtime_error);
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "model/kernels.h"
+
+namespace {
+
+constexpr tskv::ReduceKind kKinds[] = {
+    tskv::ReduceKind::kSum,
+    tskv::ReduceKind::kMin,
+    tskv::ReduceKind::kMax,
+    tskv::ReduceKind::kLast,
+};
+
+std::vector<double> RandomValues(size_t size, std::mt19937& gen) {
+  // small integers, so that sums don't depend on the order of additions
+  std::uniform_int_distribution<int> dist(-1000, 1000);
+  std::vector<double> values(size);
+  for (auto& value : values) {
+    value = dist(gen);
+  }
+  return values;
+}
+
+}  // namespace
+
+TEST(Kernels, ReduceStrided) {
+  std::vector<double> in{1, 2, 3, 4, 5, 6, 7};
+  std::vector<double> out(3);
+  EXPECT_EQ(tskv::ReduceStrided(tskv::ReduceKind::kSum, in, 1, 3, out.data()),
+            3);
+  EXPECT_EQ(out, (std::vector<double>{1, 9, 18}));
+  EXPECT_EQ(tskv::ReduceStrided(tskv::ReduceKind::kMin, in, 1, 3, out.data()),
+            3);
+  EXPECT_EQ(out, (std::vector<double>{1, 2, 5}));
+  EXPECT_EQ(tskv::ReduceStrided(tskv::ReduceKind::kMax, in, 1, 3, out.data()),
+            3);
+  EXPECT_EQ(out, (std::vector<double>{1, 4, 7}));
+  EXPECT_EQ(tskv::ReduceStrided(tskv::ReduceKind::kLast, in, 1, 3, out.data()),
+            3);
+  EXPECT_EQ(out, (std::vector<double>{1, 4, 7}));
+}
+
+TEST(Kernels, SameAsScalar) {
+  std::mt19937 gen(42);
+  for (auto kind : kKinds) {
+    for (size_t size : {0, 1, 7, 8, 31, 100, 1000}) {
+      auto in = RandomValues(size, gen);
+      for (size_t stride : {1, 2, 3, 4, 5, 8, 13, 30, 64}) {
+        for (size_t head : {size_t{1}, stride / 2 + 1, stride}) {
+          std::vector<double> expected(size + 1);
+          std::vector<double> result(size + 1);
+          auto expected_size = tskv::ReduceStridedScalar(
+              kind, in, head, stride, expected.data());
+          auto result_size =
+              tskv::ReduceStrided(kind, in, head, stride, result.data());
+          ASSERT_EQ(result_size, expected_size);
+          ASSERT_EQ(result, expected);
+        }
+      }
+      auto dst = RandomValues(size, gen);
+      auto expected = dst;
+      tskv::CombineIntoScalar(kind, expected.data(), in);
+      tskv::CombineInto(kind, dst.data(), in);
+      ASSERT_EQ(dst, expected);
+    }
+  }
+}
@@ -1,6 +1,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <map>
 #include <memory>
 
 #include "gmock/gmock.h"
@@ -22,6 +23,7 @@ class MockPersistentStorage : public tskv::IPersistentStorage {
               (const tskv::PageId& page_id, const tskv::CompressedBytes& bytes),
               (override));
   MOCK_METHOD(void, DeletePage, (const tskv::PageId& page_id), (override));
+  MOCK_METHOD(void, Sync, (), (override));
 };
 
 TEST(Level, ReadWrite) {
@@ -54,4 +56,113 @@ TEST(Level, ReadWrite) {
   EXPECT_EQ(read_column->GetTimeRange(), tskv::TimeRange(45, 120));
 }
 
-// TODO: add MovePagesFrom test
+TEST(Level, ReadSeveral) {
+  auto mock_storage = std::make_shared<MockPersistentStorage>();
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 15,
+          .level_duration = tskv::Duration::Hours(20),
+      },
+      mock_storage);
+
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  EXPECT_CALL(*mock_storage, CreatePage)
+      .WillOnce(testing::Return("sum"))
+      .WillOnce(testing::Return("count"));
+  EXPECT_CALL(*mock_storage, Write)
+      .Times(2)
+      .WillRepeatedly([&](const tskv::PageId& page_id,
+                          const tskv::CompressedBytes& bytes) {
+        pages[page_id] = bytes;
+      });
+  level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{4, 6},
+                                                tskv::TimePoint(45), 15));
+  level.Write(std::make_shared<tskv::CountColumn>(std::vector<double>{2, 3},
+                                                  tskv::TimePoint(45), 15));
+
+  EXPECT_CALL(*mock_storage, Read)
+      .Times(2)
+      .WillRepeatedly(
+          [&](const tskv::PageId& page_id) { return pages.at(page_id); });
+  auto columns = level.Read(
+      tskv::TimeRange{0, 200},
+      {tskv::StoredAggregationType::kSum, tskv::StoredAggregationType::kCount});
+  ASSERT_EQ(columns.size(), 2);
+  EXPECT_EQ(columns[0]->GetType(), tskv::ColumnType::kSum);
+  EXPECT_EQ(columns[0]->GetValues(), (std::vector<double>{4, 6}));
+  EXPECT_EQ(columns[1]->GetType(), tskv::ColumnType::kCount);
+  EXPECT_EQ(columns[1]->GetValues(), (std::vector<double>{2, 3}));
+}
+
+TEST(Level, AppendsSegments) {
+  auto mock_storage = std::make_shared<MockPersistentStorage>();
+  tskv::Level level(
+      tskv::Level::Options{
+          .bucket_interval = 10,
+          .level_duration = tskv::Duration::Hours(20),
+      },
+      mock_storage);
+  tskv::Level next_level(
+      tskv::Level::Options{
+          .bucket_interval = 20,
+          .level_duration = tskv::Duration::Hours(20),
+      },
+      mock_storage);
+
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  int next_page_id = 0;
+  ON_CALL(*mock_storage, CreatePage).WillByDefault([&] {
+    return std::to_string(next_page_id++);
+  });
+  ON_CALL(*mock_storage, Write)
+      .WillByDefault([&](const tskv::PageId& page_id,
+                         const tskv::CompressedBytes& bytes) {
+        pages[page_id] = bytes;
+      });
+  ON_CALL(*mock_storage, Read).WillByDefault([&](const tskv::PageId& page_id) {
+    return pages.at(page_id);
+  });
+  ON_CALL(*mock_storage, DeletePage)
+      .WillByDefault([&](const tskv::PageId& page_id) { pages.erase(page_id); });
+
+  // flushes don't read existing segments
+  EXPECT_CALL(*mock_storage, Read).Times(0);
+  EXPECT_CALL(*mock_storage, CreatePage).Times(3);
+  EXPECT_CALL(*mock_storage, Write).Times(3);
+  level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{1, 2},
+                                                tskv::TimePoint(0), 10));
+  level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{3, 4},
+                                                tskv::TimePoint(10), 10));
+  level.Write(std::make_shared<tskv::SumColumn>(std::vector<double>{5},
+                                                tskv::TimePoint(30), 10));
+  testing::Mock::VerifyAndClearExpectations(mock_storage.get());
+
+  EXPECT_CALL(*mock_storage, Read).Times(3);
+  auto column =
+      level.Read(tskv::TimeRange{0, 40}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{1, 5, 4, 5}));
+  testing::Mock::VerifyAndClearExpectations(mock_storage.get());
+
+  // only overlapping segments are read
+  EXPECT_CALL(*mock_storage, Read).Times(1);
+  column =
+      level.Read(tskv::TimeRange{30, 40}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{5}));
+  testing::Mock::VerifyAndClearExpectations(mock_storage.get());
+
+  // segments are merged into one during compaction
+  EXPECT_CALL(*mock_storage, Read).Times(3);
+  EXPECT_CALL(*mock_storage, DeletePage).Times(3);
+  EXPECT_CALL(*mock_storage, CreatePage).Times(1);
+  EXPECT_CALL(*mock_storage, Write).Times(1);
+  next_level.MovePagesFrom(level);
+  testing::Mock::VerifyAndClearExpectations(mock_storage.get());
+  EXPECT_EQ(pages.size(), 1);
+
+  EXPECT_CALL(*mock_storage, Read).Times(1);
+  column = next_level.Read(tskv::TimeRange{0, 40},
+                           tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{6, 9}));
+  EXPECT_FALSE(
+      level.Read(tskv::TimeRange{0, 40}, tskv::StoredAggregationType::kSum));
+}
@@ -0,0 +1,285 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+#include "executor/executor.h"
+#include "manifest/manifest.h"
+#include "model/column.h"
+#include "model/model.h"
+#include "persistent-storage/persistent_storage_manager.h"
+#include "storage/storage.h"
+#include "tests/memory_storage.h"
+#include "tests/temp_dir.h"
+
+namespace {
+
+class ManifestTest : public tskv::test::TempDirTest {
+ protected:
+  void SetUp() override {
+    TempDirTest::SetUp();
+    std::filesystem::create_directories(path_);
+  }
+};
+
+double Sum(const tskv::Column& column) {
+  if (!column) {
+    return 0;
+  }
+  auto values = column->GetValues();
+  return std::accumulate(values.begin(), values.end(), 0.0);
+}
+
+// keeps synced pages apart, so that a crash loses the others. Calls on_sync_
+// during every sync
+class SyncedPagesStorage : public tskv::test::MemoryStorage {
+ public:
+  void Write(const tskv::PageId& page_id,
+             const tskv::CompressedBytes& bytes) override {
+    MemoryStorage::Write(page_id, bytes);
+    std::lock_guard lock(mutex_);
+    unsynced_[page_id] = bytes;
+  }
+
+  void DeletePage(const tskv::PageId& page_id) override {
+    MemoryStorage::DeletePage(page_id);
+    std::lock_guard lock(mutex_);
+    unsynced_.erase(page_id);
+    synced_.erase(page_id);
+  }
+
+  // pages written during the sync, e.g. while on_sync_ runs, aren't synced
+  void Sync() override {
+    std::map<tskv::PageId, tskv::CompressedBytes> pages;
+    {
+      std::lock_guard lock(mutex_);
+      pages.swap(unsynced_);
+    }
+    if (on_sync_) {
+      on_sync_();
+    }
+    {
+      std::lock_guard lock(mutex_);
+      for (auto& [page_id, bytes] : pages) {
+        synced_[page_id] = std::move(bytes);
+      }
+    }
+    MemoryStorage::Sync();
+  }
+
+  // storage after a crash, only with synced pages
+  std::shared_ptr<tskv::IPersistentStorage> Crash() {
+    auto storage = std::make_shared<tskv::test::MemoryStorage>();
+    std::lock_guard lock(mutex_);
+    for (const auto& [page_id, bytes] : synced_) {
+      storage->Write(page_id, bytes);
+    }
+    return storage;
+  }
+
+  std::function<void()> on_sync_;
+
+ private:
+  std::mutex mutex_;
+  std::map<tskv::PageId, tskv::CompressedBytes> synced_;
+  std::map<tskv::PageId, tskv::CompressedBytes> unsynced_;
+};
+
+}  // namespace
+
+TEST_F(ManifestTest, WriteRead) {
+  auto path = path_ / "test.manifest";
+  EXPECT_FALSE(tskv::ReadManifest(path));
+
+  tskv::CompressedBytes payload{1, 2, 3};
+  tskv::WriteManifest(path, payload);
+  EXPECT_EQ(*tskv::ReadManifest(path), payload);
+  payload = {4, 5};
+  tskv::WriteManifest(path, payload);
+  EXPECT_EQ(*tskv::ReadManifest(path), payload);
+
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-1, std::ios::end);
+    file.put(6);
+  }
+  EXPECT_THROW(tskv::ReadManifest(path), std::runtime_error);
+}
+
+TEST_F(ManifestTest, Journal) {
+  auto path = path_ / "test.journal";
+  {
+    tskv::Journal journal(path);
+    EXPECT_TRUE(journal.Recover().empty());
+    journal.Append({1, 2, 3});
+    journal.Append({});
+    journal.Sync();
+    journal.Append({4});
+    journal.Sync();
+  }
+  {
+    tskv::Journal journal(path);
+    EXPECT_EQ(journal.Recover(),
+              (std::vector<tskv::CompressedBytes>{{1, 2, 3}, {}, {4}}));
+  }
+
+  // torn append of the last record
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+  {
+    tskv::Journal journal(path);
+    EXPECT_EQ(journal.Recover(),
+              (std::vector<tskv::CompressedBytes>{{1, 2, 3}, {}}));
+    journal.Append({5, 6});
+    journal.Sync();
+  }
+  tskv::Journal journal(path);
+  EXPECT_EQ(journal.Recover(),
+            (std::vector<tskv::CompressedBytes>{{1, 2, 3}, {}, {5, 6}}));
+}
+
+TEST_F(ManifestTest, PersistentStorageManager) {
+  auto storage = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::PersistentStorageManager::Options options{
+      .levels = {{.bucket_interval = 10, .level_duration = 20},
+                 {.bucket_interval = 20, .level_duration = 1000}},
+      .storage = storage,
+      .manifest_path = (path_ / "metric.manifest").string(),
+  };
+  {
+    tskv::PersistentStorageManager manager(options);
+    for (uint64_t i = 0; i < 5; ++i) {
+      auto prepared = manager.PrepareWrite({std::make_shared<tskv::SumColumn>(
+          std::vector<double>{1}, 10 * i, 10)});
+      manager.CommitWrite(prepared, i + 1);
+      manager.AfterCommit();
+    }
+  }
+
+  auto pages_num = storage->PagesNum();
+  storage->reads_ = 0;
+  tskv::PersistentStorageManager manager(options);
+  // pages aren't read on start
+  EXPECT_EQ(storage->reads_, 0);
+  EXPECT_EQ(manager.GetFlushedLsn(), 5);
+  EXPECT_EQ(Sum(manager.Read({0, 50}, tskv::StoredAggregationType::kSum)), 5);
+  EXPECT_EQ(Sum(manager.Read({40, 50}, tskv::StoredAggregationType::kSum)), 1);
+  EXPECT_EQ(storage->PagesNum(), pages_num);
+}
+
+TEST_F(ManifestTest, MergeCommittedDuringSync) {
+  auto storage = std::make_shared<SyncedPagesStorage>();
+  auto executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = 1});
+  tskv::PersistentStorageManager::Options options{
+      .levels = {{.bucket_interval = 10, .level_duration = 40},
+                 {.bucket_interval = 10, .level_duration = 4000}},
+      .storage = storage,
+      .executor = executor,
+      .manifest_path = (path_ / "metric.manifest").string(),
+  };
+  tskv::PersistentStorageManager manager(options);
+  // the merge can't start, until the only thread of the executor is released
+  std::promise<void> release;
+  executor->Submit(
+      [future = release.get_future().share()] { future.wait(); });
+  // the first level needs the merge since the 4th write
+  for (uint64_t i = 0; i < 4; ++i) {
+    manager.Write({std::make_shared<tskv::SumColumn>(std::vector<double>{1},
+                                                     10 * i, 10)});
+  }
+
+  std::atomic<int> syncs{0};
+  std::promise<void> merge_syncing;
+  auto merge_syncing_future = merge_syncing.get_future();
+  std::promise<void> written;
+  auto written_future = written.get_future();
+  double restored_sum = 0;
+  storage->on_sync_ = [&] {
+    auto sync = syncs++;
+    if (sync == 0) {
+      // the write is saving its manifest, the merge commits its pages now
+      release.set_value();
+      merge_syncing_future.wait_for(std::chrono::milliseconds(100));
+    } else if (sync == 1) {
+      // pages of the merge aren't synced yet, so the saved manifest must not
+      // point to them
+      merge_syncing.set_value();
+      written_future.wait();
+      auto crashed_options = options;
+      crashed_options.storage = storage->Crash();
+      crashed_options.executor = nullptr;
+      try {
+        tskv::PersistentStorageManager crashed(crashed_options);
+        restored_sum = Sum(
+            crashed.Read({0, 50}, tskv::StoredAggregationType::kSum));
+      } catch (const std::exception&) {
+        restored_sum = -1;
+      }
+    }
+  };
+  manager.Write(
+      {std::make_shared<tskv::SumColumn>(std::vector<double>{1}, 40, 10)});
+  written.set_value();
+  manager.WaitForCompaction();
+  storage->on_sync_ = nullptr;
+
+  EXPECT_EQ(syncs, 2);
+  EXPECT_EQ(restored_sum, 5);
+  EXPECT_EQ(Sum(manager.Read({0, 50}, tskv::StoredAggregationType::kSum)), 5);
+}
+
+TEST_F(ManifestTest, StorageRestart) {
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::Storage::Options options{
+      .wal = tskv::Wal::Options{.path = (path_ / "wal").string(),
+                                .sync_policy = tskv::Wal::SyncPolicy::kNone},
+      .manifest_path = (path_ / "manifest").string(),
+      .persistent_storage = pages,
+  };
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 30},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 60},
+                         {.bucket_interval = 20, .level_duration = 10000}},
+              .storage = pages,
+          },
+  };
+
+  {
+    tskv::Storage storage(options);
+    EXPECT_EQ(storage.InitMetric(metric_options), 0);
+    EXPECT_EQ(storage.InitMetric(metric_options), 1);
+    storage.ReplayWal();
+    // some records are flushed, the others are only in WAL
+    for (uint64_t i = 0; i < 10; ++i) {
+      storage.Write(0, {{10 * i, 1}});
+    }
+    storage.Write(1, {{10, 5}});
+  }
+
+  {
+    tskv::Storage storage(options);
+    storage.ReplayWal();
+    EXPECT_EQ(Sum(storage.Read(0, {0, 100}, tskv::AggregationType::kSum)), 10);
+    EXPECT_EQ(Sum(storage.Read(1, {0, 100}, tskv::AggregationType::kSum)), 5);
+    EXPECT_EQ(storage.InitMetric(metric_options), 2);
+    storage.Flush();
+  }
+
+  tskv::Storage storage(options);
+  storage.ReplayWal();
+  EXPECT_EQ(Sum(storage.Read(0, {0, 100}, tskv::AggregationType::kSum)), 10);
+  EXPECT_EQ(Sum(storage.Read(1, {0, 100}, tskv::AggregationType::kSum)), 5);
+  EXPECT_FALSE(storage.Read(2, {0, 100}, tskv::AggregationType::kSum));
+}
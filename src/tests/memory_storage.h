@@ -0,0 +1,79 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "persistent-storage/persistent_storage.h"
+
+namespace tskv::test {
+
+// thread safe storage, that keeps pages in memory
+class MemoryStorage : public IPersistentStorage {
+ public:
+  Metadata GetMetadata() const override { return {}; }
+
+  PageId CreatePage() override {
+    std::lock_guard lock(mutex_);
+    auto page_id = std::to_string(next_page_id_++);
+    pages_[page_id] = {};
+    return page_id;
+  }
+
+  CompressedBytes Read(const PageId& page_id) override {
+    std::lock_guard lock(mutex_);
+    ++reads_;
+    return pages_.at(page_id);
+  }
+
+  void Write(const PageId& page_id,
+             const CompressedBytes& bytes) override {
+    std::lock_guard lock(mutex_);
+    pages_[page_id] = bytes;
+  }
+
+  std::vector<PageBytes> ReadMany(std::span<const PageId> page_ids) override {
+    {
+      std::lock_guard lock(mutex_);
+      ++read_batches_;
+    }
+    return IPersistentStorage::ReadMany(page_ids);
+  }
+
+  void WriteMany(std::span<const PageId> page_ids,
+                 std::span<const CompressedBytes> pages) override {
+    {
+      std::lock_guard lock(mutex_);
+      ++write_batches_;
+    }
+    IPersistentStorage::WriteMany(page_ids, pages);
+  }
+
+  void DeletePage(const PageId& page_id) override {
+    std::lock_guard lock(mutex_);
+    pages_.erase(page_id);
+  }
+
+  void Sync() override {
+    std::lock_guard lock(mutex_);
+    ++syncs_;
+  }
+
+  size_t PagesNum() {
+    std::lock_guard lock(mutex_);
+    return pages_.size();
+  }
+
+  size_t reads_{0};
+  size_t read_batches_{0};
+  size_t write_batches_{0};
+  size_t syncs_{0};
+
+ private:
+  std::mutex mutex_;
+  std::map<PageId, CompressedBytes> pages_;
+  size_t next_page_id_{0};
+};
+
+}  // namespace tskv::test
@@ -97,3 +97,64 @@ TEST(Memtable, ExtractColumns) {
     }
   }
 }
+
+TEST(Memtable, RawOnlyNeedFlush) {
+  tskv::Memtable::Options options{
+      .bucket_interval = 2,
+      .max_bytes_size = 4 * (sizeof(tskv::TimePoint) + sizeof(double)),
+      .max_age = 10,
+      .store_raw = true,
+  };
+  // no aggregates, so only raw values are counted
+  tskv::Memtable memtable(options, tskv::MetricOptions{});
+  EXPECT_TRUE(memtable.Empty());
+  memtable.Write(tskv::InputTimeSeries{{3, 10}, {4, 1}});
+  memtable.Write(tskv::InputTimeSeries{{5, 2}});
+  EXPECT_EQ(memtable.GetBytesSize(),
+            3 * (sizeof(tskv::TimePoint) + sizeof(double)));
+  EXPECT_FALSE(memtable.NeedFlush());
+  // the age is from the first timestamp to the last one
+  memtable.Write(tskv::InputTimeSeries{{12, 3}});
+  EXPECT_TRUE(memtable.NeedFlush());
+
+  tskv::Memtable small_memtable(options, tskv::MetricOptions{});
+  for (tskv::TimePoint timestamp = 0; timestamp < 5; ++timestamp) {
+    EXPECT_FALSE(small_memtable.NeedFlush());
+    small_memtable.Write(tskv::InputTimeSeries{{timestamp, 1}});
+  }
+  EXPECT_TRUE(small_memtable.NeedFlush());
+  small_memtable.ExtractColumns();
+  EXPECT_TRUE(small_memtable.Empty());
+  EXPECT_FALSE(small_memtable.NeedFlush());
+}
+
+TEST(Memtable, InterleavedReadsAndWrites) {
+  tskv::Memtable memtable(
+      tskv::Memtable::Options{
+          .bucket_interval = 2,
+          .max_bytes_size = 100000,
+          .store_raw = true,
+      },
+      tskv::MetricOptions{{tskv::StoredAggregationType::kSum}});
+  // readers keep results of the last reads, while writes update the same
+  // buckets, so results must not change after them
+  tskv::Memtable::ReadResult sum_res;
+  tskv::Memtable::ReadResult raw_res;
+  for (tskv::TimePoint timestamp = 0; timestamp < 100; ++timestamp) {
+    memtable.Write(tskv::InputTimeSeries{{timestamp, 1}});
+    if (timestamp > 0) {
+      // the bucket of the previous timestamp was read before this write
+      EXPECT_EQ(sum_res.found->GetValues(),
+                (std::vector<double>{timestamp % 2 == 1 ? 1.0 : 2.0}));
+      EXPECT_EQ(raw_res.found->GetValues(), (std::vector<double>{1}));
+    }
+    sum_res = memtable.Read({timestamp, timestamp + 1},
+                            tskv::StoredAggregationType::kSum);
+    raw_res = memtable.Read({timestamp, timestamp + 1},
+                            tskv::StoredAggregationType::kNone);
+    // results have only the read buckets and records
+    EXPECT_EQ(sum_res.found->GetBytesSize(), sizeof(double));
+    EXPECT_EQ(raw_res.found->GetBytesSize(),
+              sizeof(tskv::TimePoint) + sizeof(double));
+  }
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <numeric>
+
+#include "executor/executor.h"
+#include "metric-storage/metric_storage.h"
+#include "model/aggregations.h"
+#include "model/model.h"
+#include "tests/memory_storage.h"
+#include "tests/temp_dir.h"
+
+namespace {
+
+tskv::MetricStorage::Options MakeOptions(
+    std::shared_ptr<tskv::IPersistentStorage> storage,
+    std::shared_ptr<tskv::Executor> flush_executor,
+    size_t max_immutable_memtables) {
+  return {
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 30},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 100},
+                         {.bucket_interval = 20, .level_duration = 10000}},
+              .storage = std::move(storage),
+          },
+      .flush_executor = std::move(flush_executor),
+      .max_immutable_memtables = max_immutable_memtables,
+  };
+}
+
+// the first sync waits until it's released
+class BlockingSyncStorage : public tskv::test::MemoryStorage {
+ public:
+  void Sync() override {
+    if (!blocked_.exchange(true)) {
+      entered_.set_value();
+      release_.get_future().wait();
+    }
+    MemoryStorage::Sync();
+  }
+
+  std::atomic<bool> blocked_{false};
+  std::promise<void> entered_;
+  std::promise<void> release_;
+};
+
+using MetricStorageTest = tskv::test::TempDirTest;
+
+double ReadSum(const tskv::MetricStorage& metric_storage,
+               const tskv::TimeRange& time_range) {
+  auto column = metric_storage.Read(time_range, tskv::AggregationType::kSum);
+  if (!column) {
+    return 0;
+  }
+  auto values = column->GetValues();
+  return std::accumulate(values.begin(), values.end(), 0.0);
+}
+
+}  // namespace
+
+TEST(MetricStorage, ReadsImmutableMemtables) {
+  auto storage = std::make_shared<tskv::test::MemoryStorage>();
+  auto executor = std::make_shared<tskv::Executor>(tskv::Executor::Options{});
+  // flushes wait until the executor is released
+  std::promise<void> release;
+  executor->Submit(
+      [future = release.get_future().share()] { future.wait(); });
+
+  tskv::MetricStorage metric_storage(MakeOptions(storage, executor, 3));
+  for (uint64_t i = 0; i < 10; ++i) {
+    metric_storage.Write({{10 * i, 1}});
+  }
+  EXPECT_EQ(storage->PagesNum(), 0);
+  EXPECT_EQ(ReadSum(metric_storage, {0, 100}), 10);
+  EXPECT_EQ(ReadSum(metric_storage, {25, 55}), 4);
+
+  release.set_value();
+  metric_storage.Flush();
+  EXPECT_GT(storage->PagesNum(), 0);
+  EXPECT_EQ(ReadSum(metric_storage, {0, 100}), 10);
+  EXPECT_EQ(ReadSum(metric_storage, {25, 55}), 4);
+}
+
+TEST(MetricStorage, BackgroundFlush) {
+  auto storage = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::MetricStorage metric_storage(
+      MakeOptions(storage, std::make_shared<tskv::Executor>(
+                               tskv::Executor::Options{.threads_num = 2}),
+                  1));
+
+  // every record is 1, so the sum is the number of records, no matter if
+  // they're flushed yet or not
+  constexpr int kWrites = 500;
+  for (uint64_t i = 0; i < kWrites; ++i) {
+    metric_storage.Write({{10 * i, 1}});
+    ASSERT_EQ(ReadSum(metric_storage, {0, 10 * kWrites}), i + 1);
+  }
+
+  metric_storage.Flush();
+  EXPECT_EQ(ReadSum(metric_storage, {0, 10 * kWrites}), kWrites);
+}
+
+TEST_F(MetricStorageTest, ReadsDontWaitForManifest) {
+  auto storage = std::make_shared<BlockingSyncStorage>();
+  auto options = MakeOptions(
+      storage, std::make_shared<tskv::Executor>(tskv::Executor::Options{}), 3);
+  options.persistent_storage_manager_options.manifest_path =
+      path_.string();
+  tskv::MetricStorage metric_storage(options);
+  metric_storage.Write({{0, 1}});
+  auto flushed = std::async(std::launch::async,
+                            [&metric_storage] { metric_storage.Flush(); });
+
+  // the flush has committed pages and is saving the manifest
+  storage->entered_.get_future().wait();
+  EXPECT_EQ(ReadSum(metric_storage, {0, 100}), 1);
+  metric_storage.Write({{10, 1}});
+  EXPECT_EQ(ReadSum(metric_storage, {0, 100}), 2);
+
+  storage->release_.set_value();
+  flushed.get();
+  metric_storage.Flush();
+  EXPECT_EQ(ReadSum(metric_storage, {0, 100}), 2);
+}
+
+TEST_F(MetricStorageTest, KeepsUnflushedLsnUntilManifestIsSaved) {
+  auto storage = std::make_shared<BlockingSyncStorage>();
+  auto options = MakeOptions(
+      storage, std::make_shared<tskv::Executor>(tskv::Executor::Options{}), 3);
+  options.persistent_storage_manager_options.manifest_path =
+      path_.string();
+  tskv::MetricStorage metric_storage(options);
+  metric_storage.Write({{0, 1}}, 1);
+  metric_storage.Write({{10, 1}}, 2);
+  auto flushed = std::async(std::launch::async,
+                            [&metric_storage] { metric_storage.Flush(); });
+
+  // the memtable is already in levels, but its pages aren't synced, so its
+  // WAL records must stay
+  storage->entered_.get_future().wait();
+  EXPECT_EQ(metric_storage.GetUnflushedLsn(), 1);
+  EXPECT_EQ(metric_storage.GetFlushedLsn(), 2);
+
+  storage->release_.set_value();
+  flushed.get();
+  EXPECT_EQ(metric_storage.GetUnflushedLsn(), std::nullopt);
+}
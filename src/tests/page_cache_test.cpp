@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+#include "cache/page_cache.h"
+#include "level/level.h"
+#include "model/column.h"
+#include "persistent-storage/persistent_storage_manager.h"
+#include "storage/storage.h"
+#include "tests/memory_storage.h"
+
+namespace {
+
+tskv::Column MakeSum(std::vector<double> buckets) {
+  return std::static_pointer_cast<tskv::IReadColumn>(
+      std::make_shared<tskv::SumColumn>(std::move(buckets), 0, 10));
+}
+
+// returns pages as views, like mapped segments
+class SharedOwnerStorage : public tskv::test::MemoryStorage {
+ public:
+  tskv::PageBytes ReadShared(const tskv::PageId& page_id) override {
+    auto owner = std::make_shared<const tskv::CompressedBytes>(Read(page_id));
+    owner_ = owner;
+    return {owner, *owner, true};
+  }
+
+  std::weak_ptr<const void> owner_;
+};
+
+}  // namespace
+
+TEST(PageCache, Lru) {
+  tskv::PageCache cache({.max_bytes_size = 30, .shards_num = 1});
+  tskv::test::MemoryStorage storage;
+  tskv::test::MemoryStorage other_storage;
+
+  EXPECT_FALSE(cache.Get(&storage, "0"));
+  cache.Put(&storage, "0", MakeSum({0}), 10);
+  cache.Put(&storage, "1", MakeSum({1}), 10);
+  cache.Put(&storage, "2", MakeSum({2}), 10);
+  EXPECT_EQ(cache.GetBytesSize(), 30);
+  // pages of different storages don't collide
+  EXPECT_FALSE(cache.Get(&other_storage, "0"));
+
+  // "0" becomes the most recently used, so "1" is evicted
+  EXPECT_EQ(cache.Get(&storage, "0")->GetValues(), std::vector<double>{0});
+  cache.Put(&storage, "3", MakeSum({3}), 10);
+  EXPECT_EQ(cache.GetBytesSize(), 30);
+  EXPECT_FALSE(cache.Get(&storage, "1"));
+  EXPECT_TRUE(cache.Get(&storage, "0"));
+  EXPECT_TRUE(cache.Get(&storage, "2"));
+  EXPECT_TRUE(cache.Get(&storage, "3"));
+
+  // bigger than the whole budget
+  cache.Put(&storage, "4", MakeSum({4}), 40);
+  EXPECT_FALSE(cache.Get(&storage, "4"));
+
+  std::vector<tskv::PageId> erased{"0", "2"};
+  cache.Erase(&storage, erased);
+  EXPECT_FALSE(cache.Get(&storage, "0"));
+  EXPECT_EQ(cache.GetBytesSize(), 10);
+
+  auto stats = cache.GetStats();
+  EXPECT_EQ(stats.hits, 4);
+  EXPECT_EQ(stats.misses, 5);
+}
+
+TEST(PageCache, PersistentStorageManager) {
+  auto storage = std::make_shared<tskv::test::MemoryStorage>();
+  auto cache = std::make_shared<tskv::PageCache>(tskv::PageCache::Options{});
+  tskv::PersistentStorageManager manager(
+      tskv::PersistentStorageManager::Options{
+          .levels = {{.bucket_interval = 10, .level_duration = 40},
+                     {.bucket_interval = 10, .level_duration = 1000}},
+          .storage = storage,
+          .page_cache = cache,
+      });
+  manager.Write({std::make_shared<tskv::SumColumn>(
+      std::vector<double>{1, 2}, 0, 10)});
+
+  auto column = manager.Read({0, 20}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{1, 2}));
+  EXPECT_EQ(storage->reads_, 1);
+  // merging read columns doesn't change the cached ones
+  column->Merge(MakeSum({3, 3}));
+  column = manager.Read({0, 20}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{1, 2}));
+  EXPECT_EQ(storage->reads_, 1);
+  EXPECT_EQ(cache->GetStats().hits, 1);
+
+  // the merge moves pages to the second level, old ones are erased
+  manager.Write({std::make_shared<tskv::SumColumn>(
+      std::vector<double>{3, 4}, 20, 10)});
+  EXPECT_EQ(cache->GetBytesSize(), 0);
+  column = manager.Read({0, 40}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{1, 2, 3, 4}));
+  // the merge reads both pages of the first level past the cache
+  EXPECT_EQ(storage->reads_, 4);
+  EXPECT_EQ(storage->PagesNum(), 1);
+}
+
+TEST(PageCache, ChargesDecodedPages) {
+  constexpr size_t kBudget = 4096;
+  constexpr size_t kPoints = 200;
+  tskv::PageCache cache({.max_bytes_size = kBudget, .shards_num = 1});
+  tskv::test::MemoryStorage storage;
+  std::vector<tskv::PageId> page_ids;
+  std::vector<tskv::ColumnType> page_types;
+  for (size_t i = 0; i < 5; ++i) {
+    std::vector<tskv::TimePoint> timestamps(kPoints);
+    for (size_t j = 0; j < kPoints; ++j) {
+      timestamps[j] = (i * kPoints + j) * 10;
+    }
+    // regular timestamps and equal values are encoded into a few bytes
+    tskv::RawTimestampsColumn timestamps_column(std::move(timestamps), 10);
+    tskv::RawValuesColumn values_column(std::vector<tskv::Value>(kPoints, 1));
+    for (const tskv::ISerializableColumn* column :
+         {static_cast<const tskv::ISerializableColumn*>(&timestamps_column),
+          static_cast<const tskv::ISerializableColumn*>(&values_column)}) {
+      auto bytes = column->ToBytes();
+      ASSERT_LT(bytes.size(), kPoints);
+      page_ids.push_back(storage.CreatePage());
+      page_types.push_back(column->GetType());
+      storage.Write(page_ids.back(), bytes);
+    }
+  }
+
+  for (size_t i = 0; i < page_ids.size(); ++i) {
+    tskv::Level::LoadPages(storage, &cache, {&page_ids[i], 1},
+                           {&page_types[i], 1});
+    EXPECT_LE(cache.GetBytesSize(), kBudget);
+  }
+  // decoded pages are charged, so only a few of them stay
+  EXPECT_EQ(cache.GetBytesSize(), kBudget / (kPoints * 8) * kPoints * 8);
+}
+
+TEST(PageCache, DoesntKeepSharedOwners) {
+  auto storage = std::make_shared<SharedOwnerStorage>();
+  auto cache = std::make_shared<tskv::PageCache>(tskv::PageCache::Options{});
+  tskv::PersistentStorageManager manager(
+      tskv::PersistentStorageManager::Options{
+          .levels = {{.bucket_interval = 10, .level_duration = 1000}},
+          .storage = storage,
+          .page_cache = cache,
+      });
+  manager.Write({std::make_shared<tskv::SumColumn>(
+      std::vector<double>{1, 2}, 0, 10)});
+
+  EXPECT_EQ(manager.Read({0, 20}, tskv::StoredAggregationType::kSum)
+                ->GetValues(),
+            (std::vector<double>{1, 2}));
+  // the cached page is a copy, so the owner isn't kept with only the page
+  // size charged
+  EXPECT_GT(cache->GetBytesSize(), 0);
+  EXPECT_TRUE(storage->owner_.expired());
+  EXPECT_EQ(manager.Read({0, 20}, tskv::StoredAggregationType::kSum)
+                ->GetValues(),
+            (std::vector<double>{1, 2}));
+  EXPECT_EQ(cache->GetStats().hits, 1);
+}
+
+TEST(PageCache, SharedByMetrics) {
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::Storage storage(
+      tskv::Storage::Options{.page_cache = tskv::PageCache::Options{}});
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 1000},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 1000}},
+              .storage = pages,
+          },
+  };
+  auto first = storage.InitMetric(metric_options);
+  auto second = storage.InitMetric(metric_options);
+  for (uint64_t i = 0; i < 4; ++i) {
+    storage.Write(first, {{10 * i, 1}});
+    storage.Write(second, {{10 * i, 2}});
+  }
+  storage.Flush();
+
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(storage.Read(first, {0, 20}, tskv::AggregationType::kSum));
+    EXPECT_TRUE(storage.Read(second, {0, 20}, tskv::AggregationType::kSum));
+  }
+  auto stats = storage.GetPageCacheStats();
+  EXPECT_EQ(stats.misses, 2);
+  EXPECT_EQ(stats.hits, 2);
+  EXPECT_EQ(pages->reads_, 2);
+}
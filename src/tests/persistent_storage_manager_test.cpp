@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <thread>
+
+#include "executor/executor.h"
+#include "model/column.h"
+#include "model/model.h"
+#include "persistent-storage/persistent_storage.h"
+#include "persistent-storage/persistent_storage_manager.h"
+#include "tests/memory_storage.h"
+
+namespace {
+
+tskv::SerializableColumns MakeSum(std::vector<double> buckets,
+                                  tskv::TimePoint start) {
+  return {std::make_shared<tskv::SumColumn>(std::move(buckets), start, 10)};
+}
+
+}  // namespace
+
+TEST(PersistentStorageManager, SkipsLevels) {
+  auto storage = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::PersistentStorageManager manager(
+      tskv::PersistentStorageManager::Options{
+          .levels = {{.bucket_interval = 10, .level_duration = 40},
+                     {.bucket_interval = 10, .level_duration = 1000}},
+          .storage = storage,
+      });
+  // goes to the second level
+  manager.Write(MakeSum({1, 2, 3, 4}, 0));
+  manager.Write(MakeSum({5, 6}, 40));
+
+  storage->reads_ = 0;
+  auto column = manager.Read({40, 60}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{5, 6}));
+  EXPECT_EQ(storage->reads_, 1);
+
+  storage->reads_ = 0;
+  column = manager.Read({0, 20}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{1, 2}));
+  EXPECT_EQ(storage->reads_, 1);
+
+  storage->reads_ = 0;
+  storage->read_batches_ = 0;
+  column = manager.Read({20, 60}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{3, 4, 5, 6}));
+  EXPECT_EQ(storage->reads_, 2);
+  // pages of both levels are read with one batch
+  EXPECT_EQ(storage->read_batches_, 1);
+
+  storage->reads_ = 0;
+  column = manager.Read({100, 200}, tskv::StoredAggregationType::kSum);
+  EXPECT_FALSE(column);
+  EXPECT_EQ(storage->reads_, 0);
+}
+
+TEST(PersistentStorageManager, BackgroundCompaction) {
+  auto storage = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::PersistentStorageManager manager(
+      tskv::PersistentStorageManager::Options{
+          .levels = {{.bucket_interval = 10, .level_duration = 40},
+                     {.bucket_interval = 20, .level_duration = 400},
+                     {.bucket_interval = 40, .level_duration = 4000}},
+          .storage = storage,
+          .executor = std::make_shared<tskv::Executor>(
+              tskv::Executor::Options{.threads_num = 2}),
+          // writes aren't slowed down, so merges run concurrently with all of
+          // them and merge large batches
+          .max_pending_segments = 1000,
+      });
+
+  // every bucket is 1, so the sum of everything is the number of buckets
+  constexpr int kWrites = 500;
+  std::atomic<int> started{0};
+  std::atomic<int> done{0};
+  std::atomic<bool> failed{false};
+  std::thread reader([&] {
+    while (done < kWrites) {
+      int min_sum = done;
+      auto column =
+          manager.Read({0, 10 * kWrites}, tskv::StoredAggregationType::kSum);
+      int max_sum = started;
+      if (!column) {
+        failed = failed || min_sum != 0;
+        continue;
+      }
+      auto values = column->GetValues();
+      auto sum = std::accumulate(values.begin(), values.end(), 0.0);
+      failed = failed || sum < min_sum || sum > max_sum;
+    }
+  });
+  for (int i = 0; i < kWrites; ++i) {
+    ++started;
+    manager.Write(MakeSum({1}, 10 * i));
+    ++done;
+  }
+  reader.join();
+  manager.WaitForCompaction();
+  EXPECT_FALSE(failed);
+
+  auto column =
+      manager.Read({0, 10 * kWrites}, tskv::StoredAggregationType::kSum);
+  auto values = column->GetValues();
+  EXPECT_EQ(std::accumulate(values.begin(), values.end(), 0.0), kWrites);
+  // everything except the newest records is merged into a few pages
+  EXPECT_LT(storage->PagesNum(), 10);
+}
+
+TEST(PersistentStorageManager, WritesWaitForPendingMerges) {
+  auto storage = std::make_shared<tskv::test::MemoryStorage>();
+  auto executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = 1});
+  tskv::PersistentStorageManager manager(
+      tskv::PersistentStorageManager::Options{
+          .levels = {{.bucket_interval = 10, .level_duration = 40},
+                     {.bucket_interval = 10, .level_duration = 4000}},
+          .storage = storage,
+          .executor = executor,
+          .max_pending_segments = 2,
+      });
+  // merges can't start, until the only thread of the executor is released
+  std::promise<void> release;
+  executor->Submit(
+      [future = release.get_future().share()] { future.wait(); });
+
+  // the first level needs the merge since the 4th write, so segments of the
+  // 4th, 5th and 6th writes are pending
+  for (int i = 0; i < 6; ++i) {
+    manager.Write(MakeSum({1}, 10 * i));
+  }
+  auto write = std::async(std::launch::async,
+                          [&] { manager.Write(MakeSum({1}, 60)); });
+  EXPECT_EQ(write.wait_for(std::chrono::milliseconds(100)),
+            std::future_status::timeout);
+
+  release.set_value();
+  write.get();
+  manager.WaitForCompaction();
+  auto column = manager.Read({0, 70}, tskv::StoredAggregationType::kSum);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>(7, 1)));
+}
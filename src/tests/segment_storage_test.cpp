@@ -0,0 +1,365 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+
+#include "executor/executor.h"
+#include "persistent-storage/segment_storage.h"
+#include "tests/temp_dir.h"
+
+namespace {
+
+class SegmentStorageTest : public tskv::test::TempDirTest {
+ protected:
+  size_t FilesNum() const {
+    return std::distance(std::filesystem::directory_iterator(path_),
+                         std::filesystem::directory_iterator());
+  }
+};
+
+tskv::CompressedBytes MakePage(size_t size, uint8_t value) {
+  return tskv::CompressedBytes(size, value);
+}
+
+}  // namespace
+
+TEST_F(SegmentStorageTest, ReadWrite) {
+  tskv::SegmentStorage storage({.path = path_.string()});
+  auto first = storage.CreatePage();
+  auto second = storage.CreatePage();
+  EXPECT_NE(first, second);
+  EXPECT_TRUE(storage.Read(first).empty());
+
+  storage.Write(first, MakePage(10, 1));
+  storage.Write(second, MakePage(20, 2));
+  EXPECT_EQ(storage.Read(first), MakePage(10, 1));
+  EXPECT_EQ(storage.Read(second), MakePage(20, 2));
+  storage.Write(first, MakePage(5, 3));
+  EXPECT_EQ(storage.Read(first), MakePage(5, 3));
+
+  storage.DeletePage(first);
+  EXPECT_THROW(storage.Read(first), std::runtime_error);
+  EXPECT_THROW(storage.Write(first, MakePage(1, 1)), std::runtime_error);
+  EXPECT_EQ(FilesNum(), 1);
+}
+
+TEST_F(SegmentStorageTest, Restart) {
+  tskv::PageId rewritten;
+  tskv::PageId deleted;
+  tskv::PageId kept;
+  {
+    tskv::SegmentStorage storage({.path = path_.string()});
+    rewritten = storage.CreatePage();
+    deleted = storage.CreatePage();
+    kept = storage.CreatePage();
+    storage.Write(rewritten, MakePage(10, 1));
+    storage.Write(deleted, MakePage(10, 2));
+    storage.Write(kept, MakePage(10, 3));
+    storage.Write(rewritten, MakePage(20, 4));
+    storage.DeletePage(deleted);
+  }
+
+  tskv::SegmentStorage storage({.path = path_.string()});
+  EXPECT_EQ(storage.Read(rewritten), MakePage(20, 4));
+  EXPECT_EQ(storage.Read(kept), MakePage(10, 3));
+  EXPECT_THROW(storage.Read(deleted), std::runtime_error);
+  // ids aren't reused
+  auto page = storage.CreatePage();
+  EXPECT_NE(page, rewritten);
+  EXPECT_NE(page, deleted);
+  EXPECT_NE(page, kept);
+}
+
+TEST_F(SegmentStorageTest, TornTail) {
+  tskv::PageId first;
+  tskv::PageId second;
+  {
+    tskv::SegmentStorage storage({.path = path_.string()});
+    first = storage.CreatePage();
+    second = storage.CreatePage();
+    storage.Write(first, MakePage(10, 1));
+    storage.Write(second, MakePage(10, 2));
+  }
+  auto segment = std::filesystem::directory_iterator(path_)->path();
+  std::filesystem::resize_file(segment,
+                               std::filesystem::file_size(segment) - 3);
+
+  tskv::SegmentStorage storage({.path = path_.string()});
+  EXPECT_EQ(storage.Read(first), MakePage(10, 1));
+  EXPECT_THROW(storage.Read(second), std::runtime_error);
+  auto page = storage.CreatePage();
+  storage.Write(page, MakePage(10, 3));
+  EXPECT_EQ(storage.Read(page), MakePage(10, 3));
+}
+
+TEST_F(SegmentStorageTest, Batch) {
+  tskv::SegmentStorage storage({.path = path_.string()});
+  std::vector<tskv::PageId> page_ids;
+  std::vector<tskv::CompressedBytes> pages;
+  for (size_t i = 0; i < 1000; ++i) {
+    page_ids.push_back(storage.CreatePage());
+    pages.push_back(MakePage(i % 20, i % 256));
+  }
+  // more records, than writev takes at once
+  storage.WriteMany(page_ids, pages);
+  auto read = storage.ReadMany(page_ids);
+  ASSERT_EQ(read.size(), pages.size());
+  for (size_t i = 0; i < pages.size(); ++i) {
+    EXPECT_EQ(tskv::CompressedBytes(read[i].bytes.begin(), read[i].bytes.end()),
+              pages[i]);
+  }
+
+  storage.DeleteMany(std::span(page_ids).first(500));
+  EXPECT_THROW(storage.ReadMany(page_ids), std::runtime_error);
+  read = storage.ReadMany(std::span(page_ids).subspan(500));
+  EXPECT_EQ(tskv::CompressedBytes(read[0].bytes.begin(), read[0].bytes.end()),
+            pages[500]);
+}
+
+TEST_F(SegmentStorageTest, GarbageCollection) {
+  tskv::SegmentStorage::Options options{
+      .path = path_.string(),
+      .max_segment_size = 1000,
+  };
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  {
+    tskv::SegmentStorage storage(options);
+    for (size_t i = 0; i < 1000; ++i) {
+      auto page = storage.CreatePage();
+      auto bytes = MakePage(100, i % 256);
+      storage.Write(page, bytes);
+      pages[page] = bytes;
+      // keeps only every tenth page
+      if (i % 10 != 0) {
+        storage.DeletePage(page);
+        pages.erase(page);
+      }
+    }
+    // 100 pages of ~120 bytes, with at most half of garbage
+    EXPECT_LE(storage.GetSegmentsNum(), 30);
+    EXPECT_EQ(FilesNum(), storage.GetSegmentsNum());
+    for (const auto& [page, bytes] : pages) {
+      EXPECT_EQ(storage.Read(page), bytes);
+    }
+  }
+
+  // deleted pages aren't restored from not collected segments
+  tskv::SegmentStorage storage(options);
+  for (const auto& [page, bytes] : pages) {
+    EXPECT_EQ(storage.Read(page), bytes);
+  }
+  for (size_t i = 1; i < 1000; ++i) {
+    if (i % 10 != 0) {
+      EXPECT_THROW(storage.Read(std::to_string(i)), std::runtime_error);
+    }
+  }
+}
+
+TEST_F(SegmentStorageTest, CollectionFillsCurrentSegment) {
+  tskv::SegmentStorage::Options options{
+      .path = path_.string(),
+      .max_segment_size = 1000,
+      // records are bigger, so every chunk is one record moved with its own
+      // write
+      .gc_chunk_size = 100,
+  };
+  std::map<tskv::PageId, tskv::CompressedBytes> pages;
+  std::vector<tskv::PageId> deleted;
+  {
+    tskv::SegmentStorage storage(options);
+    // records take 128 bytes, so the first segment is sealed after 8 pages
+    // and the second one gets 6 pages
+    for (size_t i = 0; i < 14; ++i) {
+      auto page = storage.CreatePage();
+      auto bytes = MakePage(100, i);
+      storage.Write(page, bytes);
+      pages[page] = bytes;
+      if (i < 5) {
+        deleted.push_back(page);
+      }
+    }
+    EXPECT_EQ(storage.GetSegmentsNum(), 2);
+    for (const auto& page : deleted) {
+      pages.erase(page);
+    }
+    // 5 tombstones take 120 bytes of the second segment, so the second of 3
+    // moved pages doesn't fit there and goes to a new segment
+    storage.DeleteMany(deleted);
+    EXPECT_EQ(storage.GetSegmentsNum(), 2);
+    EXPECT_EQ(FilesNum(), 2);
+    for (const auto& [page, bytes] : pages) {
+      EXPECT_EQ(storage.Read(page), bytes);
+    }
+  }
+
+  tskv::SegmentStorage storage(options);
+  for (const auto& [page, bytes] : pages) {
+    EXPECT_EQ(storage.Read(page), bytes);
+  }
+  for (const auto& page : deleted) {
+    EXPECT_THROW(storage.Read(page), std::runtime_error);
+  }
+}
+
+TEST_F(SegmentStorageTest, FailedCollection) {
+  tskv::SegmentStorage::Options options{
+      .path = path_.string(),
+      .max_segment_size = 1000,
+  };
+  std::vector<tskv::PageId> pages;
+  {
+    tskv::SegmentStorage storage(options);
+    // the first segment is sealed after 8 pages of 128 bytes records
+    for (size_t i = 0; i < 9; ++i) {
+      pages.push_back(storage.CreatePage());
+      storage.Write(pages.back(), MakePage(100, i));
+    }
+    auto first_segment =
+        std::ranges::min(std::filesystem::directory_iterator(path_), {},
+                         [](const auto& entry) { return entry.path(); })
+            .path();
+    {
+      std::fstream file(first_segment,
+                        std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(6 * 128 + 40);
+      file.put(-1);
+    }
+
+    // the collection fails on the 7th page, after the 6th one is moved
+    EXPECT_NO_THROW(storage.DeleteMany(std::span(pages).first(5)));
+    EXPECT_THROW(storage.WaitForCollection(), std::runtime_error);
+    EXPECT_EQ(storage.GetSegmentsNum(), 2);
+    EXPECT_EQ(storage.Read(pages[5]), MakePage(100, 5));
+    EXPECT_THROW(storage.Read(pages[6]), std::runtime_error);
+    EXPECT_EQ(storage.Read(pages[7]), MakePage(100, 7));
+    EXPECT_EQ(storage.Read(pages[8]), MakePage(100, 8));
+
+    // the corrupted page isn't moved anymore, so the segment is collected
+    storage.DeletePage(pages[6]);
+    EXPECT_NO_THROW(storage.WaitForCollection());
+    EXPECT_EQ(storage.GetSegmentsNum(), 1);
+  }
+
+  tskv::SegmentStorage storage(options);
+  for (size_t i = 0; i < pages.size(); ++i) {
+    if (i < 5 || i == 6) {
+      EXPECT_THROW(storage.Read(pages[i]), std::runtime_error);
+    } else {
+      EXPECT_EQ(storage.Read(pages[i]), MakePage(100, i));
+    }
+  }
+}
+
+TEST_F(SegmentStorageTest, BackgroundCollection) {
+  tskv::SegmentStorage::Options options{
+      .path = path_.string(),
+      .max_segment_size = 1000,
+      .gc_chunk_size = 300,
+      .executor = std::make_shared<tskv::Executor>(
+          tskv::Executor::Options{.threads_num = 2}),
+  };
+  std::vector<tskv::PageId> kept;
+  {
+    tskv::SegmentStorage storage(options);
+    std::vector<tskv::PageId> pages;
+    for (size_t i = 0; i < 10; ++i) {
+      pages.push_back(storage.CreatePage());
+      storage.Write(pages.back(), MakePage(100, i));
+    }
+    kept = pages;
+
+    // pages are moved by collections, while they're read
+    std::atomic<bool> done{false};
+    std::atomic<bool> failed{false};
+    std::thread reader([&] {
+      while (!done) {
+        for (size_t i = 0; i < kept.size(); ++i) {
+          failed = failed || storage.Read(kept[i]) != MakePage(100, i);
+        }
+      }
+    });
+    for (size_t i = 0; i < 1000; ++i) {
+      auto page = storage.CreatePage();
+      storage.Write(page, MakePage(100, i % 256));
+      storage.DeletePage(page);
+    }
+    done = true;
+    reader.join();
+    EXPECT_FALSE(failed);
+    EXPECT_NO_THROW(storage.WaitForCollection());
+    // only the kept pages and tombstones of the last deleted ones are left
+    EXPECT_LE(storage.GetSegmentsNum(), 10);
+    EXPECT_EQ(FilesNum(), storage.GetSegmentsNum());
+  }
+
+  tskv::SegmentStorage storage(options);
+  for (size_t i = 0; i < kept.size(); ++i) {
+    EXPECT_EQ(storage.Read(kept[i]), MakePage(100, i));
+  }
+  for (size_t i = kept.size(); i < 1010; ++i) {
+    EXPECT_THROW(storage.Read(std::to_string(i)), std::runtime_error);
+  }
+}
+
+TEST_F(SegmentStorageTest, MmapReads) {
+  tskv::SegmentStorage storage({
+      .path = path_.string(),
+      .max_segment_size = 1000,
+      .mmap_reads = true,
+  });
+  auto first = storage.CreatePage();
+  storage.Write(first, MakePage(101, 1));
+  auto page = storage.ReadShared(first);
+  EXPECT_EQ(tskv::CompressedBytes(page.bytes.begin(), page.bytes.end()),
+            MakePage(101, 1));
+  // pages are aligned to be used in place
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(page.bytes.data()) % alignof(double),
+            0);
+  EXPECT_EQ(storage.ReadShared(first).bytes.data(), page.bytes.data());
+
+  // appends don't invalidate views
+  std::vector<tskv::PageId> pages;
+  for (size_t i = 0; i < 20; ++i) {
+    pages.push_back(storage.CreatePage());
+    storage.Write(pages.back(), MakePage(100, i));
+  }
+  for (size_t i = 0; i < pages.size(); ++i) {
+    auto bytes = storage.ReadShared(pages[i]).bytes;
+    EXPECT_EQ(tskv::CompressedBytes(bytes.begin(), bytes.end()),
+              MakePage(100, i));
+  }
+
+  // view outlives the collected segment
+  storage.DeletePage(first);
+  for (const auto& page_id : pages) {
+    storage.DeletePage(page_id);
+  }
+  EXPECT_EQ(storage.GetSegmentsNum(), 1);
+  EXPECT_EQ(tskv::CompressedBytes(page.bytes.begin(), page.bytes.end()),
+            MakePage(101, 1));
+}
+
+TEST_F(SegmentStorageTest, Sync) {
+  tskv::SegmentStorage storage({
+      .path = path_.string(),
+      .max_segment_size = 1000,
+  });
+  std::vector<tskv::PageId> pages;
+  for (size_t i = 0; i < 20; ++i) {
+    pages.push_back(storage.CreatePage());
+    storage.Write(pages.back(), MakePage(100, i));
+  }
+  storage.Sync();
+  // segments, collected after the writes, are skipped
+  for (size_t i = 0; i + 1 < pages.size(); ++i) {
+    storage.Write(pages[i], MakePage(10, i));
+    storage.DeletePage(pages[i]);
+  }
+  storage.Sync();
+  storage.Sync();
+  EXPECT_EQ(storage.Read(pages.back()), MakePage(100, 19));
+}
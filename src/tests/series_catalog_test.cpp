@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "catalog/series_catalog.h"
+
+namespace {
+
+tskv::Labels MakeLabels(const std::string& name, const std::string& host,
+                        const std::string& region) {
+  return {{std::string(tskv::kMetricNameLabel), name},
+          {"region", region},
+          {"hostname", host}};
+}
+
+std::vector<tskv::MetricId> Select(const tskv::SeriesCatalog& catalog,
+                                   const std::string& selector) {
+  return catalog.Select(tskv::ParseSelector(selector));
+}
+
+}  // namespace
+
+TEST(SeriesCatalog, AddFind) {
+  tskv::SeriesCatalog catalog;
+  EXPECT_TRUE(catalog.Add(MakeLabels("cpu", "host_0", "eu"), 0));
+  EXPECT_TRUE(catalog.Add(MakeLabels("cpu", "host_1", "eu"), 1));
+  EXPECT_FALSE(catalog.Add(MakeLabels("cpu", "host_0", "eu"), 2));
+  EXPECT_EQ(catalog.GetSeriesNum(), 2);
+
+  // labels are found in any order
+  EXPECT_EQ(catalog.Find({{"hostname", "host_1"},
+                          {"region", "eu"},
+                          {std::string(tskv::kMetricNameLabel), "cpu"}}),
+            1);
+  EXPECT_FALSE(catalog.Find(MakeLabels("cpu", "host_2", "eu")));
+  EXPECT_EQ(catalog.GetLabels(0).size(), 3);
+  EXPECT_TRUE(catalog.GetLabels(2).empty());
+  EXPECT_THROW(catalog.Add({{"a", "1"}, {"a", "2"}}, 3), std::runtime_error);
+}
+
+TEST(SeriesCatalog, Select) {
+  tskv::SeriesCatalog catalog;
+  tskv::MetricId id = 0;
+  // ids are added out of order, posting lists stay sorted
+  for (int host = 9; host >= 0; --host) {
+    auto region = host < 5 ? "eu" : "us";
+    for (auto name : {"cpu", "mem"}) {
+      catalog.Add(MakeLabels(name, "host_" + std::to_string(host), region),
+                  id++);
+    }
+  }
+  catalog.Add({{std::string(tskv::kMetricNameLabel), "cpu"}}, id++);
+
+  EXPECT_EQ(Select(catalog, "cpu{hostname=host_3}"),
+            (std::vector<tskv::MetricId>{12}));
+  EXPECT_EQ(Select(catalog, "cpu{hostname=~host_[0-2]}"),
+            (std::vector<tskv::MetricId>{14, 16, 18}));
+  EXPECT_EQ(Select(catalog, R"(cpu{hostname=~"host_1|host_[23]"})"),
+            (std::vector<tskv::MetricId>{12, 14, 16}));
+  // isn't expanded to values, so values are matched one by one
+  EXPECT_EQ(Select(catalog, "cpu{hostname=~host_(1|3)}"),
+            (std::vector<tskv::MetricId>{12, 16}));
+  // the regex must match the whole value
+  EXPECT_TRUE(Select(catalog, "cpu{hostname=~host_}").empty());
+  EXPECT_EQ(Select(catalog, "cpu{hostname=~host_.}").size(), 10);
+  EXPECT_EQ(Select(catalog, R"({__name__="mem", region="us",
+                                hostname!~"host_[5-7]"})"),
+            (std::vector<tskv::MetricId>{1, 3}));
+  // series without the label match negative matchers
+  EXPECT_EQ(Select(catalog, "cpu{region!=eu}"),
+            (std::vector<tskv::MetricId>{0, 2, 4, 6, 8, 20}));
+  EXPECT_EQ(Select(catalog, "{hostname!~.*}"),
+            (std::vector<tskv::MetricId>{20}));
+  EXPECT_TRUE(Select(catalog, "disk").empty());
+  EXPECT_TRUE(Select(catalog, "cpu{hostname=host_3,region=us}").empty());
+}
+
+TEST(SeriesCatalog, ParseSelector) {
+  auto matchers = tskv::ParseSelector(
+      R"( cpu.usage_user{ hostname =~ "host_[0-9]{1,2}" ,region!=eu} )");
+  ASSERT_EQ(matchers.size(), 3);
+  EXPECT_EQ(matchers[0].name, tskv::kMetricNameLabel);
+  EXPECT_EQ(matchers[0].value, "cpu.usage_user");
+  EXPECT_EQ(matchers[1].name, "hostname");
+  EXPECT_EQ(matchers[1].type, tskv::LabelMatcher::Type::kRegex);
+  EXPECT_EQ(matchers[1].value, "host_[0-9]{1,2}");
+  EXPECT_EQ(matchers[2].name, "region");
+  EXPECT_EQ(matchers[2].type, tskv::LabelMatcher::Type::kNotEqual);
+  EXPECT_EQ(matchers[2].value, "eu");
+
+  EXPECT_THROW(tskv::ParseSelector(""), std::runtime_error);
+  EXPECT_THROW(tskv::ParseSelector("{}"), std::runtime_error);
+  EXPECT_THROW(tskv::ParseSelector("cpu{hostname}"), std::runtime_error);
+  EXPECT_THROW(tskv::ParseSelector("cpu{hostname=\"host}"),
+               std::runtime_error);
+  EXPECT_THROW(tskv::ParseSelector("cpu{hostname=host"), std::runtime_error);
+}
@@ -0,0 +1,380 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "executor/executor.h"
+#include "model/model.h"
+#include "storage/storage.h"
+#include "tests/memory_storage.h"
+#include "tests/temp_dir.h"
+
+namespace {
+
+double ReadSum(const tskv::Storage& storage, tskv::MetricId id) {
+  auto column = storage.Read(id, {0, 100000}, tskv::AggregationType::kSum);
+  if (!column) {
+    return 0;
+  }
+  auto values = column->GetValues();
+  return std::accumulate(values.begin(), values.end(), 0.0);
+}
+
+}  // namespace
+
+using StorageTest = tskv::test::TempDirTest;
+
+TEST_F(StorageTest, ConcurrentWritesAndReads) {
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  auto compaction_executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = 2});
+  auto flush_executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = 2});
+  tskv::Storage::Options options{
+      // small segments, so WAL is truncated during writes
+      .wal = tskv::Wal::Options{.path = (path_ / "wal").string(),
+                                .sync_policy = tskv::Wal::SyncPolicy::kNone,
+                                .max_segment_size = 1024},
+      .manifest_path = (path_ / "manifest").string(),
+      .persistent_storage = pages,
+      .compaction_executor = compaction_executor,
+      .flush_executor = flush_executor,
+      .page_cache = tskv::PageCache::Options{},
+      // small, so memtables are flushed by the budget too
+      .max_memtables_bytes_size = 256,
+  };
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 100},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 300},
+                         {.bucket_interval = 10, .level_duration = 100000}},
+              .storage = pages,
+              .executor = compaction_executor,
+          },
+      .flush_executor = flush_executor,
+  };
+
+  constexpr size_t kWriters = 4;
+  constexpr size_t kMetricsPerWriter = 2;
+  constexpr int kRecords = 300;
+  {
+    tskv::Storage storage(options);
+    storage.ReplayWal();
+    std::vector<std::vector<tskv::MetricId>> writer_metrics(kWriters);
+    std::vector<std::atomic<int>> started(kWriters * kMetricsPerWriter);
+    std::vector<std::atomic<int>> done(kWriters * kMetricsPerWriter);
+    std::atomic<size_t> writers_done{0};
+    std::atomic<bool> failed{false};
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kWriters; ++i) {
+      threads.emplace_back([&, i] {
+        // metrics are initialized concurrently too
+        for (size_t j = 0; j < kMetricsPerWriter; ++j) {
+          writer_metrics[i].push_back(storage.InitMetric(metric_options));
+        }
+        for (int record = 0; record < kRecords; ++record) {
+          for (auto id : writer_metrics[i]) {
+            ++started[id];
+            storage.Write(id, {{static_cast<uint64_t>(10 * record), 1}});
+            ++done[id];
+          }
+        }
+        ++writers_done;
+      });
+    }
+    for (size_t i = 0; i < 2; ++i) {
+      threads.emplace_back([&] {
+        while (writers_done < kWriters) {
+          for (tskv::MetricId id = 0; id < done.size(); ++id) {
+            int min_sum = done[id];
+            double sum = 0;
+            try {
+              sum = ReadSum(storage, id);
+            } catch (const std::runtime_error&) {
+              // not initialized yet
+              continue;
+            }
+            int max_sum = started[id];
+            failed = failed || sum < min_sum || sum > max_sum;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    EXPECT_FALSE(failed);
+  }
+
+  // records, that weren't flushed, are replayed from WAL
+  tskv::Storage storage(options);
+  storage.ReplayWal();
+  for (tskv::MetricId id = 0; id < kWriters * kMetricsPerWriter; ++id) {
+    EXPECT_EQ(ReadSum(storage, id), kRecords);
+  }
+}
+
+TEST(Storage, ReadGroup) {
+  tskv::Storage storage(tskv::Storage::Options{
+      .executor = std::make_shared<tskv::Executor>(
+          tskv::Executor::Options{.threads_num = 2}),
+  });
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum,
+                          tskv::StoredAggregationType::kCount,
+                          tskv::StoredAggregationType::kMax}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 100},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 100000}},
+              .storage = std::make_shared<tskv::test::MemoryStorage>(),
+          },
+  };
+
+  // metrics start at different times, so they are merged out of id order
+  constexpr size_t kMetrics = 10;
+  constexpr uint64_t kWindow = 40;
+  std::vector<tskv::MetricId> ids;
+  std::vector<double> sums(8);
+  std::vector<double> counts(8);
+  std::vector<double> maxes(8, 0);
+  for (size_t i = 0; i < kMetrics; ++i) {
+    ids.push_back(storage.InitMetric(metric_options));
+    for (uint64_t j = 0; j < 20; ++j) {
+      tskv::TimePoint timestamp = 10 * (kMetrics - i + j);
+      double value = 100 * i + j;
+      storage.Write(ids.back(), {{timestamp, value}});
+      sums[timestamp / kWindow] += value;
+      ++counts[timestamp / kWindow];
+      maxes[timestamp / kWindow] = std::max(maxes[timestamp / kWindow], value);
+    }
+  }
+  // memtables are sealed every 100, so metrics are read both from levels and
+  // memtables
+
+  auto read = [&](tskv::AggregationType aggregation_type) {
+    return storage.ReadGroup(ids, {0, 1000}, aggregation_type, kWindow)
+        ->GetValues();
+  };
+  EXPECT_EQ(read(tskv::AggregationType::kSum), sums);
+  EXPECT_EQ(read(tskv::AggregationType::kMax), maxes);
+  std::vector<double> avgs;
+  for (size_t i = 0; i < sums.size(); ++i) {
+    avgs.push_back(sums[i] / counts[i]);
+  }
+  EXPECT_EQ(read(tskv::AggregationType::kAvg), avgs);
+
+  EXPECT_FALSE(storage.ReadGroup({}, {0, 1000}, tskv::AggregationType::kSum,
+                                 kWindow));
+}
+
+TEST(Storage, ReadGroupBatch) {
+  // without the executor all metrics are read by one part
+  tskv::Storage storage(tskv::Storage::Options{});
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 100},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 100000}},
+              .storage = pages,
+          },
+  };
+  std::vector<tskv::MetricId> ids;
+  for (size_t i = 0; i < 5; ++i) {
+    ids.push_back(storage.InitMetric(metric_options));
+    storage.Write(ids.back(), {{0, 1}, {10, 2}});
+  }
+  storage.Flush();
+
+  pages->read_batches_ = 0;
+  auto column =
+      storage.ReadGroup(ids, {0, 1000}, tskv::AggregationType::kSum, 10);
+  EXPECT_EQ(column->GetValues(), (std::vector<double>{5, 10}));
+  // pages of all metrics are read with one batch
+  EXPECT_EQ(pages->read_batches_, 1);
+}
+
+TEST(Storage, MemtablesBudget) {
+  constexpr size_t kBudget = 800;
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::Storage storage(tskv::Storage::Options{
+      .persistent_storage = pages,
+      .max_memtables_bytes_size = kBudget,
+  });
+  // memtables of metrics are never full, only the budget flushes them
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 1000000},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 1000000}},
+              .storage = pages,
+          },
+  };
+
+  constexpr size_t kMetrics = 20;
+  constexpr uint64_t kRecords = 10;
+  for (size_t i = 0; i < kMetrics; ++i) {
+    storage.InitMetric(metric_options);
+  }
+  // every record takes a new bucket of 8 bytes
+  for (uint64_t j = 0; j < kRecords; ++j) {
+    for (tskv::MetricId id = 0; id < kMetrics; ++id) {
+      storage.Write(id, {{10 * j, 1}});
+      EXPECT_LE(storage.GetMemtablesBytesSize(), kBudget);
+    }
+  }
+  EXPECT_GT(storage.GetMemtablesBytesSize(), 0);
+  // memtables of many metrics are written with one batch
+  ASSERT_GT(pages->write_batches_, 0);
+  EXPECT_GE(pages->PagesNum(), 5 * pages->write_batches_);
+
+  for (tskv::MetricId id = 0; id < kMetrics; ++id) {
+    EXPECT_EQ(ReadSum(storage, id), kRecords);
+  }
+  storage.Flush();
+  EXPECT_EQ(storage.GetMemtablesBytesSize(), 0);
+}
+
+TEST_F(StorageTest, MemtablesBudgetManifests) {
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::Storage::Options options{
+      .manifest_path = path_.string(),
+      .persistent_storage = pages,
+      .max_memtables_bytes_size = 800,
+  };
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 1000000},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 1000000}},
+              .storage = pages,
+          },
+  };
+
+  constexpr size_t kMetrics = 20;
+  constexpr uint64_t kRecords = 10;
+  size_t unflushed_records = 0;
+  {
+    tskv::Storage storage(options);
+    for (size_t i = 0; i < kMetrics; ++i) {
+      storage.InitMetric(metric_options);
+    }
+    for (uint64_t j = 0; j < kRecords; ++j) {
+      for (tskv::MetricId id = 0; id < kMetrics; ++id) {
+        storage.Write(id, {{10 * j, 1}});
+      }
+    }
+    // every record takes a new bucket of 8 bytes
+    unflushed_records = storage.GetMemtablesBytesSize() / 8;
+  }
+  // one sync of pages for every flush, manifests of all its metrics are in
+  // the journal
+  ASSERT_GT(pages->write_batches_, 0);
+  EXPECT_EQ(pages->syncs_, pages->write_batches_);
+  EXPECT_FALSE(std::filesystem::exists(path_ / "metric-0.manifest"));
+
+  // flushed records are restored from the journal
+  tskv::Storage storage(options);
+  double sum = 0;
+  for (tskv::MetricId id = 0; id < kMetrics; ++id) {
+    sum += ReadSum(storage, id);
+  }
+  EXPECT_EQ(sum, kMetrics * kRecords - unflushed_records);
+}
+
+TEST(Storage, WritesWaitForMemtablesBudget) {
+  constexpr size_t kBudget = 800;
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  auto flush_executor = std::make_shared<tskv::Executor>(
+      tskv::Executor::Options{.threads_num = 1});
+  tskv::Storage storage(tskv::Storage::Options{
+      .persistent_storage = pages,
+      .flush_executor = flush_executor,
+      .max_memtables_bytes_size = kBudget,
+  });
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 1000000},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 1000000}},
+              .storage = pages,
+          },
+  };
+  auto id = storage.InitMetric(metric_options);
+  // flushes can't start, until the only thread of the executor is released
+  std::promise<void> release;
+  flush_executor->Submit(
+      [future = release.get_future().share()] { future.wait(); });
+
+  // every record takes a new bucket of 8 bytes, writes don't wait up to twice
+  // the budget
+  constexpr uint64_t kRecords = 2 * kBudget / 8;
+  for (uint64_t j = 0; j < kRecords; ++j) {
+    storage.Write(id, {{10 * j, 1}});
+  }
+  EXPECT_EQ(storage.GetMemtablesBytesSize(), 2 * kBudget);
+  auto write = std::async(std::launch::async,
+                          [&] { storage.Write(id, {{10 * kRecords, 1}}); });
+  EXPECT_EQ(write.wait_for(std::chrono::milliseconds(100)),
+            std::future_status::timeout);
+
+  release.set_value();
+  write.get();
+  EXPECT_LE(storage.GetMemtablesBytesSize(), kBudget);
+  EXPECT_EQ(ReadSum(storage, id), kRecords + 1);
+}
+
+TEST_F(StorageTest, Labels) {
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::Storage::Options options{
+      .manifest_path = (path_ / "manifest").string(),
+      .persistent_storage = pages,
+  };
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 100},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 100000}},
+              .storage = pages,
+          },
+  };
+  auto labels = [](const std::string& host) {
+    return tskv::Labels{{std::string(tskv::kMetricNameLabel), "cpu"},
+                        {"hostname", host}};
+  };
+
+  {
+    tskv::Storage storage(options);
+    EXPECT_EQ(storage.InitMetric(labels("host_0"), metric_options), 0);
+    EXPECT_EQ(storage.InitMetric(metric_options), 1);
+    EXPECT_EQ(storage.InitMetric(labels("host_1"), metric_options), 2);
+    // the same series gets the same metric
+    EXPECT_EQ(storage.InitMetric(labels("host_0"), metric_options), 0);
+    EXPECT_THROW(storage.InitMetric({}, metric_options), std::runtime_error);
+  }
+
+  // labels are restored from the manifest
+  tskv::Storage storage(options);
+  EXPECT_EQ(storage.FindMetric(labels("host_1")), 2);
+  EXPECT_EQ(storage.InitMetric(labels("host_1"), metric_options), 2);
+  EXPECT_EQ(storage.InitMetric(labels("host_2"), metric_options), 3);
+  EXPECT_EQ(storage.SelectMetrics("cpu{hostname=~host_[0-1]}"),
+            (std::vector<tskv::MetricId>{0, 2}));
+  EXPECT_EQ(storage.SelectMetrics("cpu"),
+            (std::vector<tskv::MetricId>{0, 2, 3}));
+}
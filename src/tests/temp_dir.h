@@ -0,0 +1,29 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+
+namespace tskv::test {
+
+// fixture with a path in the temp directory, unique for the test suite and
+// the process. Nothing is there before the test and after it, tests create a
+// file or a directory there themselves
+class TempDirTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    std::string suite_name =
+        testing::UnitTest::GetInstance()->current_test_suite()->name();
+    path_ = std::filesystem::temp_directory_path() /
+            ("tskv-" + suite_name + "-" + std::to_string(::getpid()));
+    std::filesystem::remove_all(path_);
+  }
+
+  void TearDown() override { std::filesystem::remove_all(path_); }
+
+  std::filesystem::path path_;
+};
+
+}  // namespace tskv::test
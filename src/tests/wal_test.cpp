@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "executor/executor.h"
+#include "model/model.h"
+#include "storage/storage.h"
+#include "tests/memory_storage.h"
+#include "tests/temp_dir.h"
+#include "wal/wal.h"
+
+namespace {
+
+class WalTest : public tskv::test::TempDirTest {
+ protected:
+  tskv::Wal::Options GetOptions() const {
+    return {.path = path_.string(),
+            .sync_policy = tskv::Wal::SyncPolicy::kNone};
+  }
+};
+
+}  // namespace
+
+namespace tskv {
+
+bool operator==(const tskv::Record& lhs, const tskv::Record& rhs) {
+  return lhs.timestamp == rhs.timestamp && lhs.value == rhs.value;
+}
+
+}  // namespace tskv
+
+TEST_F(WalTest, Recover) {
+  {
+    tskv::Wal wal(GetOptions());
+    EXPECT_TRUE(wal.Recover().empty());
+    EXPECT_EQ(wal.Append(3, {{1, 1.5}, {2, 2.5}}), 1);
+    EXPECT_EQ(wal.Append(5, {{3, 3.5}}), 2);
+  }
+
+  tskv::Wal wal(GetOptions());
+  auto records = wal.Recover();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_EQ(records[0].lsn, 1);
+  EXPECT_EQ(records[0].metric_id, 3);
+  EXPECT_TRUE(records[0].time_series ==
+              (tskv::InputTimeSeries{{1, 1.5}, {2, 2.5}}));
+  EXPECT_EQ(records[1].lsn, 2);
+  EXPECT_EQ(records[1].metric_id, 5);
+  EXPECT_EQ(wal.Append(3, {{4, 4.5}}), 3);
+}
+
+TEST_F(WalTest, TornTail) {
+  {
+    tskv::Wal wal(GetOptions());
+    wal.Recover();
+    wal.Append(1, {{1, 1}});
+    wal.Append(1, {{2, 2}});
+  }
+  // cut the last record in the middle
+  auto segment = std::filesystem::directory_iterator(path_)->path();
+  std::filesystem::resize_file(segment,
+                               std::filesystem::file_size(segment) - 3);
+
+  {
+    tskv::Wal wal(GetOptions());
+    auto records = wal.Recover();
+    ASSERT_EQ(records.size(), 1);
+    EXPECT_EQ(records[0].lsn, 1);
+    EXPECT_EQ(wal.Append(1, {{3, 3}}), 2);
+  }
+
+  tskv::Wal wal(GetOptions());
+  auto records = wal.Recover();
+  ASSERT_EQ(records.size(), 2);
+  EXPECT_TRUE(records[1].time_series == (tskv::InputTimeSeries{{3, 3}}));
+}
+
+TEST_F(WalTest, GroupCommit) {
+  constexpr int kThreads = 4;
+  constexpr int kAppends = 200;
+  {
+    auto options = GetOptions();
+    options.sync_policy = tskv::Wal::SyncPolicy::kAlways;
+    tskv::Wal wal(options);
+    wal.Recover();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+      threads.emplace_back([&wal, i] {
+        for (uint64_t j = 0; j < kAppends; ++j) {
+          wal.Append(i, {{j, 1}});
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  tskv::Wal wal(GetOptions());
+  auto records = wal.Recover();
+  ASSERT_EQ(records.size(), kThreads * kAppends);
+  std::vector<uint64_t> next_timestamp(kThreads);
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i].lsn, i + 1);
+    // appends of one writer keep their order
+    auto& timestamp = next_timestamp[records[i].metric_id];
+    EXPECT_EQ(records[i].time_series.front().timestamp, timestamp++);
+  }
+}
+
+TEST_F(WalTest, PeriodicSync) {
+  auto options = GetOptions();
+  options.sync_policy = tskv::Wal::SyncPolicy::kPeriodic;
+  options.sync_interval = std::chrono::hours(1);
+  {
+    // the sync thread doesn't delay the close
+    tskv::Wal wal(options);
+    wal.Recover();
+    EXPECT_EQ(wal.Append(1, {{1, 1}}), 1);
+    EXPECT_EQ(wal.GetSyncedLsn(), 0);
+  }
+
+  options.sync_interval = std::chrono::milliseconds(10);
+  tskv::Wal wal(options);
+  EXPECT_EQ(wal.Recover().size(), 1);
+  EXPECT_EQ(wal.Append(1, {{2, 1}}), 2);
+  // synced without the next appends
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (wal.GetSyncedLsn() < 2 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(wal.GetSyncedLsn(), 2);
+}
+
+TEST_F(WalTest, Truncate) {
+  auto options = GetOptions();
+  options.max_segment_size = 1;
+  {
+    tskv::Wal wal(options);
+    wal.Recover();
+    for (uint64_t i = 0; i < 5; ++i) {
+      wal.Append(1, {{i, 1}});
+    }
+    // every append starts a new segment
+    EXPECT_EQ(wal.GetSegmentsNum(), 6);
+    wal.Truncate(4);
+    EXPECT_EQ(wal.GetSegmentsNum(), 3);
+  }
+
+  {
+    tskv::Wal wal(options);
+    auto records = wal.Recover();
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].lsn, 4);
+    wal.Truncate(100);
+    EXPECT_EQ(wal.GetSegmentsNum(), 1);
+  }
+
+  tskv::Wal wal(options);
+  EXPECT_TRUE(wal.Recover().empty());
+  EXPECT_EQ(wal.Append(1, {{10, 1}}), 6);
+}
+
+TEST_F(WalTest, StorageReplay) {
+  auto pages = std::make_shared<tskv::test::MemoryStorage>();
+  tskv::MetricStorage::Options metric_options{
+      .metric_options = {{tskv::StoredAggregationType::kSum}},
+      .memtable_options = {.bucket_interval = 10, .max_age = 1000},
+      .persistent_storage_manager_options =
+          {
+              .levels = {{.bucket_interval = 10, .level_duration = 10000}},
+              .storage = pages,
+          },
+  };
+  tskv::Storage::Options options{
+      .wal = GetOptions(),
+      .executor = std::make_shared<tskv::Executor>(
+          tskv::Executor::Options{.threads_num = 2}),
+  };
+  auto read_sum = [](const tskv::Storage& storage, tskv::MetricId id) {
+    auto column = storage.Read(id, {0, 1000}, tskv::AggregationType::kSum);
+    if (!column) {
+      return 0.0;
+    }
+    auto values = column->GetValues();
+    return std::accumulate(values.begin(), values.end(), 0.0);
+  };
+
+  {
+    tskv::Storage storage(options);
+    storage.InitMetric(metric_options);
+    storage.InitMetric(metric_options);
+    storage.ReplayWal();
+    storage.Write(0, {{10, 1}, {20, 2}});
+    storage.Write(1, {{10, 5}});
+    storage.Write(0, {{30, 3}});
+  }
+
+  {
+    tskv::Storage storage(options);
+    storage.InitMetric(metric_options);
+    storage.InitMetric(metric_options);
+    storage.ReplayWal();
+    EXPECT_EQ(read_sum(storage, 0), 6);
+    EXPECT_EQ(read_sum(storage, 1), 5);
+
+    // flushed records aren't in WAL anymore
+    storage.Flush();
+  }
+
+  tskv::Storage storage(options);
+  storage.InitMetric(metric_options);
+  storage.InitMetric(metric_options);
+  storage.ReplayWal();
+  EXPECT_EQ(read_sum(storage, 0), 0);
+}
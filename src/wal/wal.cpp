@@ -0,0 +1,312 @@
+#include "wal.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include "manifest/manifest.h"
+#include "model/column.h"
+#include "model/compression.h"
+
+namespace tskv {
+
+namespace {
+
+// record is [payload size][crc32 of payload][payload], where payload is
+// [lsn][metric id][records...]
+constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+constexpr size_t kPayloadPrefixSize = sizeof(Lsn) + sizeof(MetricId);
+constexpr std::string_view kSegmentExtension = ".wal";
+
+void EncodeRecord(std::vector<uint8_t>& bytes, Lsn lsn, MetricId metric_id,
+                  const InputTimeSeries& time_series) {
+  auto header_offset = bytes.size();
+  bytes.resize(bytes.size() + kHeaderSize);
+  auto payload_offset = bytes.size();
+  Append(bytes, lsn);
+  Append(bytes, metric_id);
+  Append(bytes, time_series.data(), time_series.size());
+
+  auto payload_size = static_cast<uint32_t>(bytes.size() - payload_offset);
+  auto crc = Crc32({bytes.data() + payload_offset, payload_size});
+  std::memcpy(bytes.data() + header_offset, &payload_size, sizeof(uint32_t));
+  std::memcpy(bytes.data() + header_offset + sizeof(uint32_t), &crc,
+              sizeof(uint32_t));
+}
+
+// returns size of the valid prefix, the rest is torn or corrupted
+size_t DecodeRecords(const std::vector<uint8_t>& bytes,
+                     std::vector<Wal::Record>& records) {
+  size_t offset = 0;
+  while (offset < bytes.size()) {
+    if (bytes.size() - offset < kHeaderSize) {
+      return offset;
+    }
+    uint32_t payload_size;
+    uint32_t crc;
+    std::memcpy(&payload_size, bytes.data() + offset, sizeof(uint32_t));
+    std::memcpy(&crc, bytes.data() + offset + sizeof(uint32_t),
+                sizeof(uint32_t));
+    auto payload_offset = offset + kHeaderSize;
+    if (bytes.size() - payload_offset < payload_size ||
+        payload_size < kPayloadPrefixSize ||
+        (payload_size - kPayloadPrefixSize) % sizeof(tskv::Record) != 0 ||
+        Crc32({bytes.data() + payload_offset, payload_size}) != crc) {
+      return offset;
+    }
+
+    Wal::Record record;
+    std::memcpy(&record.lsn, bytes.data() + payload_offset, sizeof(Lsn));
+    std::memcpy(&record.metric_id, bytes.data() + payload_offset + sizeof(Lsn),
+                sizeof(MetricId));
+    record.time_series.resize((payload_size - kPayloadPrefixSize) /
+                              sizeof(tskv::Record));
+    std::memcpy(record.time_series.data(),
+                bytes.data() + payload_offset + kPayloadPrefixSize,
+                payload_size - kPayloadPrefixSize);
+    offset = payload_offset + payload_size;
+    records.push_back(std::move(record));
+  }
+  return offset;
+}
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path& path) {
+  // whole segment is read at once, they aren't big
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw std::runtime_error("can't open WAL segment " + path.string());
+  }
+  std::vector<uint8_t> bytes(std::filesystem::file_size(path));
+  in.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+  bytes.resize(in.gcount());
+  return bytes;
+}
+
+}  // namespace
+
+Wal::Wal(const Options& options) : options_(options), path_(options.path) {
+  std::filesystem::create_directories(path_);
+  for (const auto& entry : std::filesystem::directory_iterator(path_)) {
+    if (entry.path().extension() != kSegmentExtension) {
+      continue;
+    }
+    segments_[std::stoull(entry.path().stem().string())] = entry.path();
+  }
+}
+
+Wal::~Wal() {
+  if (sync_thread_.joinable()) {
+    {
+      std::lock_guard lock(mutex_);
+      stopped_ = true;
+    }
+    stop_.notify_all();
+    written_.notify_all();
+    sync_thread_.join();
+  }
+  CloseSegment();
+}
+
+std::vector<Wal::Record> Wal::Recover() {
+  std::lock_guard lock(mutex_);
+  if (recovered_) {
+    throw std::runtime_error("WAL is already recovered");
+  }
+  std::vector<Record> records;
+  for (const auto& [first_lsn, path] : segments_) {
+    next_lsn_ = std::max(next_lsn_, first_lsn);
+    auto records_num = records.size();
+    auto bytes = ReadFile(path);
+    auto valid_size = DecodeRecords(bytes, records);
+    if (valid_size < bytes.size()) {
+      // torn write of the crashed run, it's the last segment of that run, so
+      // it's cut to keep the next runs segments readable
+      std::filesystem::resize_file(path, valid_size);
+    }
+    for (size_t i = records_num; i < records.size(); ++i) {
+      if (records[i].lsn != next_lsn_) {
+        throw std::runtime_error("WAL segment " + path.string() +
+                                 " has unexpected lsn");
+      }
+      ++next_lsn_;
+    }
+  }
+
+  recovered_ = true;
+  written_lsn_ = next_lsn_ - 1;
+  synced_lsn_ = written_lsn_;
+  last_sync_ = std::chrono::steady_clock::now();
+  OpenSegment(next_lsn_);
+  if (options_.sync_policy == SyncPolicy::kPeriodic) {
+    sync_thread_ = std::thread([this] { SyncPeriodically(); });
+  }
+  return records;
+}
+
+Lsn Wal::Append(MetricId metric_id, const InputTimeSeries& time_series) {
+  std::unique_lock lock(mutex_);
+  if (!recovered_) {
+    throw std::runtime_error("WAL must be recovered before appends");
+  }
+  Lsn lsn = next_lsn_++;
+  EncodeRecord(pending_, lsn, metric_id, time_series);
+
+  bool wait_sync = options_.sync_policy == SyncPolicy::kAlways;
+  while (true) {
+    if (failed_) {
+      throw std::runtime_error("WAL write failed");
+    }
+    if (written_lsn_ >= lsn && (!wait_sync || synced_lsn_ >= lsn)) {
+      return lsn;
+    }
+    if (writing_) {
+      written_.wait(lock);
+      continue;
+    }
+
+    bool sync = options_.sync_policy == SyncPolicy::kAlways ||
+                (options_.sync_policy == SyncPolicy::kPeriodic &&
+                 std::chrono::steady_clock::now() - last_sync_ >=
+                     options_.sync_interval);
+    WriteGroup(lock, sync);
+  }
+}
+
+void Wal::Truncate(Lsn lsn) {
+  std::lock_guard lock(mutex_);
+  if (lsn >= next_lsn_ && !writing_ && segment_size_ > 0) {
+    // everything is flushed, so the current segment isn't needed too
+    CloseSegment();
+    OpenSegment(next_lsn_);
+  }
+  // the last segment is the one being written
+  while (segments_.size() > 1 && std::next(segments_.begin())->first <= lsn) {
+    std::filesystem::remove(segments_.begin()->second);
+    segments_.erase(segments_.begin());
+  }
+}
+
+size_t Wal::GetSegmentsNum() const {
+  std::lock_guard lock(mutex_);
+  return segments_.size();
+}
+
+Lsn Wal::GetNextLsn() const {
+  std::lock_guard lock(mutex_);
+  return next_lsn_;
+}
+
+Lsn Wal::GetSyncedLsn() const {
+  std::lock_guard lock(mutex_);
+  return synced_lsn_;
+}
+
+void Wal::WriteGroup(std::unique_lock<std::mutex>& lock, bool sync) {
+  writing_ = true;
+  auto bytes = std::exchange(pending_, {});
+  Lsn last_lsn = next_lsn_ - 1;
+  auto now = std::chrono::steady_clock::now();
+  lock.unlock();
+  try {
+    WritePending(bytes, sync);
+  } catch (...) {
+    lock.lock();
+    failed_ = true;
+    writing_ = false;
+    written_.notify_all();
+    throw;
+  }
+  lock.lock();
+  writing_ = false;
+  written_lsn_ = last_lsn;
+  if (sync) {
+    synced_lsn_ = last_lsn;
+    last_sync_ = now;
+  }
+  if (segment_size_ >= options_.max_segment_size) {
+    CloseSegment();
+    OpenSegment(last_lsn + 1);
+  }
+  written_.notify_all();
+}
+
+void Wal::WritePending(const std::vector<uint8_t>& bytes, bool sync) {
+  size_t offset = 0;
+  while (offset < bytes.size()) {
+    auto written = ::write(fd_, bytes.data() + offset, bytes.size() - offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("WAL write failed: ") +
+                               std::strerror(errno));
+    }
+    offset += written;
+  }
+  segment_size_ += bytes.size();
+  if (sync && ::fdatasync(fd_) != 0) {
+    throw std::runtime_error(std::string("WAL sync failed: ") +
+                             std::strerror(errno));
+  }
+}
+
+void Wal::SyncPeriodically() {
+  std::unique_lock lock(mutex_);
+  while (!stopped_ && !failed_) {
+    if (writing_) {
+      written_.wait(lock);
+      continue;
+    }
+    auto deadline = last_sync_ + options_.sync_interval;
+    if (std::chrono::steady_clock::now() < deadline) {
+      stop_.wait_until(lock, deadline);
+      continue;
+    }
+    if (synced_lsn_ == written_lsn_) {
+      // nothing is written since the last sync
+      last_sync_ = std::chrono::steady_clock::now();
+      continue;
+    }
+    try {
+      WriteGroup(lock, true);
+    } catch (...) {
+      // the next appends report the failure
+      return;
+    }
+  }
+}
+
+void Wal::OpenSegment(Lsn first_lsn) {
+  auto name = std::to_string(first_lsn);
+  name.insert(0, 20 - name.size(), '0');
+  auto path = path_ / (name + std::string(kSegmentExtension));
+  // segment with the same name can only have torn records
+  fd_ = ::open(path.c_str(),
+               O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    throw std::runtime_error("can't open WAL segment " + path.string());
+  }
+  if (options_.sync_policy != SyncPolicy::kNone) {
+    SyncDirectory(path_);
+  }
+  segments_[first_lsn] = std::move(path);
+  segment_size_ = 0;
+}
+
+void Wal::CloseSegment() {
+  if (fd_ < 0) {
+    return;
+  }
+  if (options_.sync_policy != SyncPolicy::kNone) {
+    ::fdatasync(fd_);
+  }
+  ::close(fd_);
+  fd_ = -1;
+}
+
+}  // namespace tskv
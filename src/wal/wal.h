@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../model/model.h"
+
+namespace tskv {
+
+// Write-ahead log of input batches. It's split into segment files named by the
+// first lsn, so segments with already flushed records are just deleted.
+//
+// Concurrent appends are written (and synced) together by one of the writers
+// (group commit), the others only wait for it. With the periodic sync policy
+// a background thread syncs the written records every sync_interval.
+class Wal {
+ public:
+  enum class SyncPolicy {
+    // records survive the process crash, but not the OS one
+    kNone,
+    // Append returns after records are synced
+    kAlways,
+    // synced every sync_interval by the background thread (or by a write, that
+    // finds the interval passed), so at most the last interval can be lost
+    kPeriodic,
+  };
+
+  struct Options {
+    std::string path;
+    SyncPolicy sync_policy{SyncPolicy::kAlways};
+    std::chrono::milliseconds sync_interval{100};
+    size_t max_segment_size{64 * 1024 * 1024};
+  };
+
+  struct Record {
+    Lsn lsn;
+    MetricId metric_id;
+    InputTimeSeries time_series;
+  };
+
+ public:
+  explicit Wal(const Options& options);
+  Wal(const Wal&) = delete;
+  Wal& operator=(const Wal&) = delete;
+  ~Wal();
+
+  // reads records left by the previous run in lsn order, skipping torn tail.
+  // Must be called once before appends
+  std::vector<Record> Recover();
+  Lsn Append(MetricId metric_id, const InputTimeSeries& time_series);
+  // deletes segments, that have only records with lsn < lsn
+  void Truncate(Lsn lsn);
+  size_t GetSegmentsNum() const;
+  // lsn of the next appended record
+  Lsn GetNextLsn() const;
+  // records with lsn <= the returned one survive the OS crash
+  Lsn GetSyncedLsn() const;
+
+ private:
+  // writes records of all waiting writers, called when no one else is writing
+  void WriteGroup(std::unique_lock<std::mutex>& lock, bool sync);
+  // writes pending records, called without the lock by one writer at a time
+  void WritePending(const std::vector<uint8_t>& bytes, bool sync);
+  void SyncPeriodically();
+  void OpenSegment(Lsn first_lsn);
+  void CloseSegment();
+
+ private:
+  Options options_;
+  std::filesystem::path path_;
+  // first lsn -> segment file
+  std::map<Lsn, std::filesystem::path> segments_;
+  int fd_{-1};
+  size_t segment_size_{0};
+  bool recovered_{false};
+
+  mutable std::mutex mutex_;
+  std::condition_variable written_;
+  Lsn next_lsn_{1};
+  // encoded records, that aren't written yet
+  std::vector<uint8_t> pending_;
+  bool writing_{false};
+  bool failed_{false};
+  Lsn written_lsn_{0};
+  Lsn synced_lsn_{0};
+  std::chrono::steady_clock::time_point last_sync_;
+  bool stopped_{false};
+  std::condition_variable stop_;
+  std::thread sync_thread_;
+};
+
+}  // namespace tskv